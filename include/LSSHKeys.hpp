@@ -30,6 +30,33 @@ extern "C"
 #	include <syslog.h>
 #	include <unistd.h>
 #	include <libgen.h>
+#	include <limits.h>
+#	include <netdb.h>
+#	include <dirent.h>
+#	include <fcntl.h>
+#	include <paths.h>
+#	include <poll.h>
+#	include <pthread.h>
+#	include <pwd.h>
+#	include <netinet/in.h>
+#	include <arpa/nameser.h>
+#	include <resolv.h>
+#	include <utmp.h>
+#	include <sys/file.h>
+#	include <sys/mman.h>
+#	include <sys/socket.h>
+#	include <sys/stat.h>
+#	include <sys/un.h>
+#	include <sys/wait.h>
+#	include <signal.h>
+#	if defined( __linux__ )
+#		include <linux/keyctl.h>
+#		include <sys/epoll.h>
+#		include <sys/eventfd.h>
+#		include <sys/prctl.h>
+#		include <sys/signalfd.h>
+#		include <sys/syscall.h>
+#	endif
 }
 
 #include <cerrno>
@@ -37,21 +64,38 @@ extern "C"
 #include <cstring>
 #include <ctime>
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
 #include <fstream>
+#include <functional>
 #include <iomanip>
 #include <iostream>
+#include <list>
 #include <locale>
 #include <map>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
 #include <queue>
+#include <random>
 #include <regex>
+#include <set>
 #include <sstream>
 #include <stdexcept>
 #include <streambuf>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
-#include "../build/Config.hpp"
+#include "Config.hpp"
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Static Macros
@@ -80,619 +124,1176 @@ namespace Utility
 {
 	// Member Methods.
 
-		std::string ErrnoToString()
+		std::string ErrnoToString();
+		std::string ErrnoToString( int ErrorNumber );
+		bool IsValidUsername( const std::string_view Username );
+		std::string ExpandFilter( const std::string& Template, const std::string& Username );
+		std::string JSONEscape( const std::string_view Value );
+		std::string EscapeFilterValue( const std::string_view Value );
+		uint64_t Hash( const std::string& Value );
+		void WriteFileAtomically( const std::string& Directory, const std::string& Name, const std::string& Contents, const mode_t Mode );
+		bool WriteAll( const int Descriptor, const std::string_view Contents );
+		bool IsAttribute( const struct berval& Name, const std::string& AttributeName );
+		bool WildcardMatch( const std::string_view Pattern, const std::string_view Text );
+
+		template< typename Visitor >
+		int DecodeEntry( LDAP* Interface, LDAPMessage* Entry, struct berval& DN, Visitor OnAttribute )
 		{
+			// Create local variables.
+
+				int ReturnValue;
+				BerElement* Element = nullptr;
+				struct berval Name;
+				BerVarray Values = nullptr;
+
+			// Walk the entry in place. The DN, attribute names and values point into the response buffer, are not NUL-terminated and stay
+			// valid until the response is freed; only the array holding each attribute's values is allocated.
+
+				if( ( ReturnValue = ldap_get_dn_ber( Interface, Entry, &Element, &DN ) ) != LDAP_SUCCESS )
+					return ReturnValue;
+
+				while( ( ( ReturnValue = ldap_get_attribute_ber( Interface, Entry, Element, &Name, &Values ) ) == LDAP_SUCCESS ) &&
+				       ( Name.bv_val != nullptr ) )
+				{
+					OnAttribute( Name, Values );
+
+					if( Values != nullptr )
+					{
+						ber_memfree( Values );
+						Values = nullptr;
+					}
+				}
+
+				ber_free( Element, 0 );
+
 			// Return ReturnValue.
 
-				return std::string( strerror( errno ) );
-		}
+				return ReturnValue;
+		}
+
+		LDAP* CloneConnection( LDAP* Template, const std::string& URI, const bool StartTLS, const std::string& Mechanism,
+		                       const std::string& BindDN, const std::string& BindPassword );
+		void PreLogCritical( std::string Message );
+		void LDAPClose( LDAP*& Object );
+		void LDAPMemFree( char*& Object );
+		void LDAPMsgFree( LDAPMessage*& Object );
+		void LDAPValueFreeLen( BerValue**& Object );
+		void BerFree( BerElement*& Object );
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The 'Config' Class
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class Config 
+{
+
+public:
+
+	// Public Methods
+		void Init();
+		void Init( std::ifstream& File );
+		bool Exists( const std::string_view Key );
+		const std::string& GetValue( const std::string_view Key );
+		void Merge( Config& Defaults );
+		int Size();
+		const std::map< std::string, std::string, std::less<> >& GetConfigurationMap();
+
+private:
+
+	// Private Fields
+
+		std::map< std::string, std::string, std::less<> > ConfigurationMap;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The 'Output' Class
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class Output : public std::ostream, std::streambuf
+{
+
+public:
+
+	// Public Data Types
+
+		enum Level
+		{
+			Emergency = LOG_EMERG,
+			Alert = LOG_ALERT,
+			Critical = LOG_CRIT,
+			Error = LOG_ERR,
+			Warning = LOG_WARNING,
+			Notice = LOG_NOTICE,
+			Information = LOG_INFO,
+			Debug = LOG_DEBUG
+		};
+
+		enum Method
+		{
+			Syslog,
+			Stdio,
+			File
+		};
+
+	// Destructor
+
+		~Output();
+
+	// Public Methods
+
+		void Init( const Method LogMethod, const Level OutputLevel );
+		void Init( std::ofstream& File, const Level OutputLevel );
+		void Init( Output& Parent );
+
+	// Public Overloaded Operators
+
+		Output& operator<<( const Level LogLevel );
+		Output& operator<<( const std::string& s );
+		Output& operator<<( const std::string_view s );
+		Output& operator<<( const std::pmr::string& s );
+		Output& operator<<( const char* s );
+		Output& operator<<( const char& c );
+
+		template < typename T, typename = typename std::enable_if< std::is_arithmetic< T >::value, T >::type >
+		Output& operator<<( const T& NumericValue )
+		{
+			// Create local stringstream.
+
+				std::stringstream ValueStream;
+
+			// Skip the formatting entirely if the message will not be logged.
+
+				if( IsSuppressed() )
+					return *this;
+
+			// Unset floatfield flag for stringstream (is this necessary?)
+
+				// ValueStream.unsetf( ios_base::floatfield );
+
+			// Stream numeric value to local stringstream with precision based on its type.
+
+				ValueStream << std::setprecision( std::numeric_limits< T >::digits10 ) << NumericValue;
+
+			// Append stringstream to Buffer.
+
+				Buffer.append( ValueStream.str() );
+
+			// Return pointer to this object.
+
+				return *this;
+		}
+
+		typedef std::ostream& ( *OStreamManipulator )( std::ostream& );
+		Output& operator<<( OStreamManipulator Object );
+
+private:
+
+	// Private Fields
+
+		bool Active;
+		std::ofstream* LogFile;
+		std::string Buffer;
+		Level CurrentLevel;
+		Level MinimumLevel;
+		Method Facility;
+
+	// Private Methods
+
+		bool IsSuppressed();
+		int sync();
+		void SafeExit( int ExitCode );
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The 'Cache' Class
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class Cache
+{
+
+public:
+
+	// Public Data Types
+
+		struct Record
+		{
+			std::string DN;
+			std::string CSN;
+			uint64_t Rules;
+			std::string Block;
+		};
+
+	// Constructor
+
+		Cache();
+
+	// Public Methods
+
+		void Init( const std::string& Path, const time_t Lifetime );
+		void InitKeyring( const std::string& Name, const time_t Lifetime );
+		bool IsActive();
+		bool IsKeyring();
+		const std::string& GetDirectory();
+		bool Load( const std::string& Username, Record& Entry );
+		void Store( const std::string& Username, const Record& Entry );
+		bool LoadCSN( std::string& CSN, const time_t MaximumAge );
+		void StoreCSN( const std::string& CSN );
+		bool LoadHost( std::string& FQDN, const time_t MaximumAge );
+		void StoreHost( const std::string& FQDN );
+		bool LoadAddresses( const std::string& Host, std::vector< std::string >& Addresses, bool& Stale );
+		void StoreAddresses( const std::string& Host, const std::vector< std::string >& Addresses, const time_t Expires );
+		bool LoadServices( const std::string& Domain, std::vector< std::string >& Services, bool& Stale );
+		void StoreServices( const std::string& Domain, const std::vector< std::string >& Services, const time_t Expires );
+		void Remove( const std::string& Username );
+
+private:
+
+	// Private Fields
+
+		bool Active;
+		bool Keyring;
+		time_t Lifetime;
+		long KeyringID;
+		std::string Directory;
+
+	// Private Methods
+
+		bool LoadExpiring( const std::string& Name, const std::string& Field, std::vector< std::string >& Values, bool& Stale );
+		void StoreExpiring( const std::string& Name, const std::string& Field, const std::vector< std::string >& Values, const time_t Expires );
+		bool ReadFile( const std::string& Name, std::string& Contents, time_t& Stored );
+		void WriteFile( const std::string& Name, const std::string& Contents );
+		void RemoveFile( const std::string& Name );
+
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The 'CachePolicy' Class
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class CachePolicy
+{
+
+public:
+
+	// Public Data Types
+
+		enum Segment
+		{
+			None,
+			Window,
+			Probation,
+			Protected
+		};
+
+	// Constructor
+
+		CachePolicy();
+
+	// Destructor
+
+		~CachePolicy();
+
+	// Public Methods
+
+		void Open( const std::string& Directory, const size_t Capacity );
+		void Close();
+		Segment Access( const std::string& Username );
+		void Predict( const std::string& Username );
+		void Admit( const std::string& Username );
+		std::vector< std::string > TakeEvictions();
+		std::vector< std::pair< std::string, unsigned long long > > GetStatistics();
+
+private:
+
+	// Private Fields
+
+		int Descriptor;
+		size_t Capacity;
+		size_t WindowCapacity;
+		size_t MainCapacity;
+		size_t ProtectedCapacity;
+		size_t Width;
+		unsigned long long Additions;
+		std::vector< uint8_t > Sketch;
+		std::list< std::string > WindowList;
+		std::list< std::string > ProbationList;
+		std::list< std::string > ProtectedList;
+		std::unordered_map< std::string, Segment > Index;
+		std::map< std::string, unsigned long long > Statistics;
+		std::vector< std::string > Evictions;
+
+		static constexpr const char* StatisticNames[] = { "window_hits", "probation_hits", "protected_hits", "misses", "admitted",
+		                                                  "rejected", "evicted" };
+		static const int SketchDepth = 4;
+
+	// Private Methods
+
+		void MoveToFront( std::list< std::string >& List, const std::string& Username );
+		void Evict( const std::string& Username );
+		size_t Slot( const std::string& Username, const int Row );
+		unsigned Counter( const size_t Position );
+		unsigned Frequency( const std::string& Username );
+		void Increment( const std::string& Username );
+		void Reset();
+		void Import( const std::string& Directory );
+		bool Load();
+		void Save();
+
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The 'LoginHistory' Class
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class LoginHistory
+{
+
+public:
+
+	// Public Methods
+
+		void ReadWtmp( const std::string& Path = _PATH_WTMP );
+		void ReadLastlog( const std::string& Path = _PATH_LASTLOG );
+		void ReadList( std::istream& Stream );
+		std::vector< std::string > Rank( const size_t Count );
+
+private:
+
+	// Private Fields
+
+		std::map< std::string, double > Scores;
+		std::map< std::string, bool > Seen;
+
+	// Private Methods
+
+		void Add( const std::string& Username, const time_t Now, const time_t LoginTime );
+
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The 'Arena' Class
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class Arena : public std::pmr::memory_resource
+{
+
+public:
+
+	// Constructor
+
+		Arena();
+
+	// Public Methods
+
+		void Release();
+		size_t GetAllocations();
+		size_t GetHeapAllocations();
+
+private:
+
+	// Private Data Types
+
+		class HeapResource : public std::pmr::memory_resource
+		{
+
+		public:
+
+			// Public Fields
+
+				size_t Allocations = 0;
+
+		private:
+
+			// Private Methods
+
+				void* do_allocate( size_t Bytes, size_t Alignment ) override
+				{
+					// Count the allocation and forward it to the heap.
+
+						Allocations++;
+
+						return std::pmr::new_delete_resource()->allocate( Bytes, Alignment );
+				}
+
+				void do_deallocate( void* Pointer, size_t Bytes, size_t Alignment ) override
+				{
+					// Return the memory to the heap.
+
+						std::pmr::new_delete_resource()->deallocate( Pointer, Bytes, Alignment );
+				}
+
+				bool do_is_equal( const std::pmr::memory_resource& Other ) const noexcept override
+				{
+					// Only this resource can free its own memory.
+
+						return ( this == &Other );
+				}
+
+		};
+
+	// Private Fields
+
+		alignas( std::max_align_t ) char Initial[ 4096 ];
+		size_t Allocations;
+		HeapResource Heap;
+		std::pmr::monotonic_buffer_resource Monotonic;
+
+	// Private Methods
+
+		void* do_allocate( size_t Bytes, size_t Alignment ) override;
+		void do_deallocate( void* Pointer, size_t Bytes, size_t Alignment ) override;
+		bool do_is_equal( const std::pmr::memory_resource& Other ) const noexcept override;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The 'AccountPolicy' Class
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class AccountPolicy
+{
+
+public:
+
+	// Public Data Types
+
+		enum Finding : unsigned
+		{
+			Locked = 1,
+			Expired = 2,
+			Member = 4,
+			Expiring = 8
+		};
+
+	// Constructor
+
+		AccountPolicy( Config& Configuration, Output& Log );
+
+	// Public Methods
+
+		std::vector< std::string >& GetAttributes();
+		unsigned Inspect( const struct berval& Name, BerVarray Values );
+		const char* Deny( const unsigned Findings );
+		uint64_t GetFingerprint();
+
+private:
+
+	// Private Fields
+
+		bool AccountLock;
+		bool PasswordLock;
+		bool ShadowExpire;
+		std::string GroupAttribute;
+		std::vector< std::string > Groups;
+		std::vector< std::string > Attributes;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The 'HostScope' Class
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class HostScope
+{
+
+public:
+
+	// Constructor
+
+		HostScope();
+
+	// Public Methods
+
+		void Init( Config& Configuration, Cache& KeyCache, Output& Log );
+		std::vector< std::string > Expand( const std::string& Pattern );
+		std::string ExpandFilter( const std::string& Filter );
+		std::vector< std::string >& GetScopes();
+
+private:
+
+	// Private Fields
+
+		bool Resolved;
+		std::string Name;
+		std::string FQDN;
+		std::string Domain;
+		std::vector< std::string > Groups;
+		std::vector< std::string > Scopes;
+		Cache* KeyCache;
+		Output* Log;
+
+	// Private Methods
+
+		void Resolve();
+		void Replace( std::string& Pattern, const bool Escape );
+
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The 'AddressCache' Class
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class AddressCache
+{
+
+public:
+
+	// Constructor
+
+		AddressCache();
+
+	// Destructor
+
+		~AddressCache();
+
+	// Public Methods
+
+		static void UseThreads();
+		void Init( Config& Configuration, Cache& KeyCache, Output& Log );
+		LDAP* Open( const std::vector< std::string >& URIs, bool& InstallTLS );
+		std::vector< std::string > Discover( const std::string& Domain );
+
+private:
+
+	// Private Data Types
+
+		struct Service
+		{
+			std::string Scheme;
+			unsigned Priority;
+			unsigned Weight;
+			unsigned Port;
+			std::string Target;
+		};
+
+	// Private Fields
+
+		static std::atomic< bool > Threaded;
+		int Lifetime;
+		int Timeout;
+		Cache* KeyCache;
+		Output* Log;
+		std::thread Worker;
+
+	// Private Methods
+
+		std::vector< std::string > Resolve( const std::string& Host );
+		void Store( const std::string& Host, const std::vector< std::string >& Addresses );
+		void Refresh( const std::string& Host, const std::vector< std::string >& Addresses );
+		time_t Query( const std::string& Domain, std::vector< std::string >& Services );
+		std::vector< std::string > Order( const std::vector< std::string >& Services );
+		void Detach( const std::function< void() >& Work );
+		int Dial( const std::string& Address, const int Port );
+
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The 'CallerWatch' Class
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class CallerWatch
+{
+
+public:
 
-		std::string ErrnoToString( int ErrorNumber )
-		{
-			// return ReturnValue.
+	// Constructor
 
-				return std::string( strerror( ErrorNumber ) );
-		}
+		CallerWatch();
+		CallerWatch( const CallerWatch& ) = delete;
+		CallerWatch& operator=( const CallerWatch& ) = delete;
 
-		void PreLogCritical( std::string Message )
-		{
-			// Open syslog, log critical message, then close syslog.
+	// Destructor
 
-				openlog( NAME, LOG_ODELAY, LOG_AUTH );
-				syslog( LOG_CRIT, "%s. Aborting.", Message.c_str());
-				closelog();
+		~CallerWatch();
 
-			// Log critical message to stderr.
+	// Public Methods
 
-				std::cerr << "[ Critical ] : " << Message << ". Aborting." << std::endl;
+		void Start( Output& Log );
+		int Wait( LDAP* Interface, const int MessageID, const int All, LDAPMessage*& Message );
 
-			// Call exit() with failure status.
+private:
 
-				exit( EXIT_FAILURE );
-		}
+	// Private Fields
 
-		void LDAPClose( LDAP*& Object )
-		{
-			// Unbind LDAP interface and free memory.
+		bool Active;
+		int Descriptor;
+		pid_t Parent;
+		Output* Log;
 
-				ldap_unbind_ext_s( Object, nullptr, nullptr );
+	// Private Methods
 
-			// Set pointer to null.
+		void Abandon( LDAP* Interface, const int MessageID, const char* Reason );
 
-				Object = nullptr;
-		}
+};
 
-		void LDAPMemFree( char*& Object )
-		{
-			// Free memory allocated by LDAP.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The 'ConnectionLimit' Class
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-				ldap_memfree( Object );
+class ConnectionLimit
+{
 
-			// Set pointer to null.
+public:
 
-				Object = nullptr;
-		}
+	// Public Data Types
 
-		void LDAPMsgFree( LDAPMessage*& Object )
+		class Turn
 		{
-			// Free LDAP message.
 
-				ldap_msgfree( Object );
+		public:
 
-			// Set pointer to null.
+			// Constructor
 
-				Object = nullptr;
-		}
+				Turn( ConnectionLimit& Limit ) : Limit( Limit ), Taken( !Limit.Held )
+				{
+				}
 
-		void LDAPValueFreeLen( BerValue**& Object )
-		{
-			// Free memory allocated by LDAP.
+			// Destructor
 
-				ldap_value_free_len( Object );
+				~Turn()
+				{
+					// Give back the slot taken since this turn started.
 
-			// Set pointer to null.
+						if( Taken )
+							Limit.Release();
+				}
 
-				Object = nullptr;
-		}
+		private:
 
-		void BerFree( BerElement*& Object )
-		{
-			// Free BerElement memory.
+			// Private Fields
 
-				ber_free( Object, 0 );
+				ConnectionLimit& Limit;
+				bool Taken;
 
-			// Set pointer to null.
+		};
 
-				Object = nullptr;
-		}
+	// Constructor
 
-		void BerValueFree( BerValue*& Object )
-		{
-			// Free BerValue memory.
+		ConnectionLimit();
+		ConnectionLimit( const ConnectionLimit& ) = delete;
+		ConnectionLimit& operator=( const ConnectionLimit& ) = delete;
 
-				ber_bvfree( Object );
+	// Destructor
 
-			// Set pointer to null.
+		~ConnectionLimit();
 
-				Object = nullptr;
-		}
+	// Public Methods
 
-		void CStringFree( char*& Object )
-		{
-			// Free cstring memory.
+		void Init( Config& Configuration, Output& Log );
+		void Init( const ConnectionLimit& Parent, Output& Log );
+		void Acquire();
+		void Release();
+
+private:
 
-				delete[] Object;
+	// Private Constants
 
-			// Set pointer to null.
+		static const size_t HolderCapacity = 256;
+		static const size_t QueueCapacity = 4096;
 
-				Object = nullptr;
-		}
+	// Private Data Types
 
-		void CStringArrayFree( char**& Object, size_t ObjectSize )
+		struct Ticket
 		{
-			// Free cstring array element memory.
+			pid_t Process;
+			uint32_t Token;
+		};
+
+		struct SharedTable
+		{
+			pthread_mutex_t Mutex;
+			pthread_cond_t Changed;
+			size_t Count;
+			Ticket Holders[ HolderCapacity ];
+			Ticket Queue[ QueueCapacity ];
+		};
 
-				for( size_t Index = 0; Index < ObjectSize; Index++ )
-					delete[] Object[ Index ];
+	// Private Fields
 
-			// Free cstring array memory.
+		size_t Maximum;
+		int Wait;
+		bool Held;
+		Ticket Self;
+		SharedTable* Table;
+		Output* Log;
 
-				delete[] Object;
+	// Private Methods
 
-			// Set pointer to null.
+		bool Map();
+		void Lock();
+		void Unlock();
+		void Reap();
+		void Dequeue( const Ticket& Waiter );
+		size_t Holders();
+		bool IsSelf( const Ticket& Other );
 
-				Object = nullptr;
-		}
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// The 'Config' Class
+// The 'ValueFilter' Class
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-class Config 
+class ValueFilter
 {
 
 public:
 
-	// Public Methods
-		void Init()
-		{
-			// Initialize using default configuration file.
-
-				std::ifstream File( CONFIG );
-				Init( File );
-		}
+	// Constructor
 
-		void Init( std::ifstream& File )
-		{
-			// Create local variables.
+		ValueFilter();
+		ValueFilter( const ValueFilter& ) = delete;
+		ValueFilter& operator=( const ValueFilter& ) = delete;
 
-				char CurrentSymbol;
-				bool Comment = false;
-				std::string Buffer;
-				std::string Key;
-				std::string Value;
+	// Destructor
 
-			// Ensure our file is open.
+		~ValueFilter();
 
-				if( !File.is_open() )
-				{
-					throw std::ios_base::failure( "Cannot open configuration file" );
-				}
+	// Public Methods
 
-			// Parse contents of configuration file and store in configuration map.
+		void Init( Config& Configuration, const std::string& AttributeName, const std::vector< std::string >& Scopes, Output& Log );
+		LDAPControl** GetControls();
+		bool Allows( const std::string_view Value );
+		bool Select( std::string_view& Value );
+		uint64_t GetFingerprint();
 
-				while( File.good() )
-				{
-					CurrentSymbol = File.get();
+private:
 
-					if( CurrentSymbol == '#' )
-					{
-						Comment = true;
-					}
-					else if( ( ( CurrentSymbol == '\t' ) || ( CurrentSymbol == ' ') ) && ( !Comment ))
-					{
-						Key = Buffer;
-						Buffer.clear();
-					}
-					else if( CurrentSymbol == '\n' )
-					{
-						if( !Comment )
-						{
-							if ( !Buffer.empty() )
-							{
-								Value = Buffer;
-								Buffer.clear();
-								ConfigurationMap.insert( make_pair( Key, Value ) );
-							}
-						}
-						else
-							Comment = false;
-					}
-					else
-					{
-						if( !Comment )
-							Buffer.push_back( CurrentSymbol );
-					}
+	// Private Fields
 
-				}
-		}
+		std::vector< std::string > Patterns;
+		std::vector< std::string > Scopes;
+		LDAPControl* Control;
+		LDAPControl* Controls[ 2 ];
 
-		bool Exists( const std::string Key )
-		{
+};
 
-			// Create local variables.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The 'SearchPipeline' Class
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-				bool ReturnValue;
-				std::map< std::string, std::string >::iterator Iterator;
+class SearchPipeline
+{
 
-			// Search for 'key' in the configuration map.
+public:
 
-				Iterator = ConfigurationMap.find( Key );
+	// Public Data Types
 
-			// Return true if 'key' is found.
+		struct Result
+		{
+			Result( std::pmr::memory_resource* Memory ) : Username( Memory ), DN( Memory ), Values( Memory )
+			{
+				// Set field values.
+
+					ErrorCode = LDAP_SUCCESS;
+					EntryCount = 0;
+					Findings = 0;
+					Denied = nullptr;
+			}
+
+			std::pmr::string Username;
+			int ErrorCode;
+			int EntryCount;
+			unsigned Findings;
+			const char* Denied;
+			std::pmr::string DN;
+			std::pmr::vector< std::pmr::string > Values;
+		};
 
-				if( Iterator != ConfigurationMap.end() )
-					ReturnValue = true;
-				else
-					ReturnValue = false;
+		typedef std::function< bool( std::string& ) > Source;
+		typedef std::function< void( Result& ) > Sink;
 
-			// Return ReturnValue.
+	// Constructor
 
-				return ReturnValue;
-		}
+		SearchPipeline( LDAP* Interface,
+		                const std::string& Base,
+		                const int Scope,
+		                const std::string& FilterTemplate,
+		                const std::string& AttributeName,
+		                AccountPolicy& Account,
+		                ValueFilter& ValueRules,
+		                const size_t Depth );
 
-		std::string GetValue( const std::string Key )
-		{
-			// Return the value denoted by 'Key' from the configuration map.
+	// Public Methods
 
-				return ConfigurationMap[ Key ];
-		}
+		void Run( Source NextUsername, Sink OnResult );
+		size_t GetAllocations();
+		size_t GetHeapAllocations();
 
-		int Size()
-		{
-			// Return the size of the configuration map.
+private:
 
-				return ConfigurationMap.size();
-		}
+	// Private Data Types
 
-		std::map< std::string, std::string > GetConfigurationMap()
+		struct Slot
 		{
-			// Return the entire configuration map (for debugging).
+			Arena Memory;
+			std::optional< Result > Pending;
+		};
 
-				return ConfigurationMap;
-		}
+	// Private Fields
 
-private:
+		LDAP* Interface;
+		int Scope;
+		size_t Depth;
+		size_t Allocations;
+		size_t HeapAllocations;
+		std::string Base;
+		std::string FilterTemplate;
+		std::string AttributeName;
+		AccountPolicy* Account;
+		ValueFilter* ValueRules;
 
-	// Private Fields
+	// Private Methods
 
-		std::map< std::string, std::string > ConfigurationMap;
+		void Recycle( Slot* Current, std::vector< Slot* >& Idle );
+		bool Decode( LDAPMessage* Message, Result& Current );
 
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// The 'Output' Class
+// The 'DirectoryScan' Class
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-class Output : public std::ostream, std::streambuf
+class DirectoryScan
 {
 
 public:
 
 	// Public Data Types
 
-		enum Level
+		struct Entry
 		{
-			Emergency = LOG_EMERG,
-			Alert = LOG_ALERT,
-			Critical = LOG_CRIT,
-			Error = LOG_ERR,
-			Warning = LOG_WARNING,
-			Notice = LOG_NOTICE,
-			Information = LOG_INFO,
-			Debug = LOG_DEBUG
-		};
+			Entry( std::pmr::memory_resource* Memory ) : DN( Memory ), Names( Memory ), Values( Memory )
+			{
+				// Set field values.
 
-		enum Method
-		{
-			Syslog,
-			Stdio,
-			File
+					Denied = nullptr;
+			}
+
+			const char* Denied;
+			std::pmr::string DN;
+			std::pmr::vector< std::pmr::string > Names;
+			std::pmr::vector< std::pmr::string > Values;
 		};
 
-	// Destructor
+		typedef std::function< void( Entry& ) > Sink;
 
-		~Output()
-		{
-			// Perform necessary cleanup.
+	// Constructor
 
-				if( Active )
-				{
-					if( Facility == Method::Syslog )
-					{
-						closelog();
-					} 
-					else if( Facility == Method::File )
-					{
-						if( LogFile->is_open() )
-							LogFile->close();
-					}
-					Active = false;
-				}
-		}
+		DirectoryScan( LDAP* Interface, const std::string& Base, const int Scope, const std::string& Filter, const std::string& NameAttribute,
+		               const std::string& AttributeName, AccountPolicy& Account, ValueFilter& ValueRules, const int PageSize );
 
 	// Public Methods
 
-		void Init( const Method LogMethod, const Level OutputLevel )
-		{
-			// Set field values.
+		int Run( Sink Consume );
+		size_t GetAllocations();
+		size_t GetHeapAllocations();
 
-				CurrentLevel = Level::Notice;
-				MinimumLevel = OutputLevel;
+private:
 
-			// Select Facility; error to syslog and cerr then exit if invalid.
+	// Private Fields
 
-				switch( LogMethod )
-				{
-					case Method::Syslog:
-					{
-						Facility = Method::Syslog;
-						openlog( NAME, LOG_ODELAY, LOG_AUTH );
-						break;
-					}
-					case Method::Stdio:
-					{
-						Facility = Method::Stdio;
-						break;
-					}
-					default:
-					{
-						throw std::out_of_range( "Invalid log type." );
-					}
-				}
+		LDAP* Interface;
+		int Scope;
+		int PageSize;
+		std::string Base;
+		std::string Filter;
+		std::string NameAttribute;
+		std::string AttributeName;
+		AccountPolicy* Account;
+		ValueFilter* ValueRules;
+		Arena Memory;
 
-			// Set the Active field value to true.
+	// Private Methods
 
-				Active = true;
-		}
+		void Decode( LDAPMessage* Message, Entry& Current );
 
-		void Init( std::ofstream& File, const Level OutputLevel )
-		{
-			// Set field values.
+};
 
-				CurrentLevel = Level::Notice;
-				MinimumLevel = OutputLevel;
-				Facility = Method::File;
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The 'ExportWriter' Class
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-			// Ensure log filestream is open; error to syslog and cerr then exit if it is not.
+class ExportWriter
+{
 
-				if( !File.is_open() )
-				{
-					throw std::ios_base::failure( "Cannot open log file for writing" );
-				}
+public:
 
-			// Initialize the pointer to the filestream and set the active field value to true.
+	// Constructor
 
-				LogFile = &File;
-				Active = true;
-		}
+		ExportWriter( const std::string& Directory, const size_t ThreadCount );
 
-	// Public Overloaded Operators
+	// Destructor
 
-		Output& operator<<( const Level LogLevel )
-		{
-			// Set CurrentLevel to incoming LogLevel.
+		~ExportWriter();
 
-				CurrentLevel = LogLevel;
+	// Public Methods
 
-			// Return pointer to this object.
+		void Submit( const std::string& Username, std::string&& Contents );
+		void Finish();
+		size_t Prune( const std::set< std::string >& Keep, const std::function< bool( const std::string& ) >& IsGone );
+		size_t GetWritten();
+		size_t GetUnchanged();
+		size_t GetFailed();
 
-				return *this;
-		}
+private:
 
-		Output& operator<<( const std::string& s )
-		{
-			// Append incoming string to Buffer.
+	// Private Fields
 
-				Buffer.append(s);
+		bool Stopping;
+		std::string Directory;
+		std::atomic< size_t > Written;
+		std::atomic< size_t > Unchanged;
+		std::atomic< size_t > Failed;
+		std::mutex Mutex;
+		std::condition_variable Available;
+		std::condition_variable Space;
+		std::queue< std::pair< std::string, std::string > > Jobs;
+		std::vector< std::thread > Workers;
+		std::map< std::string, uint64_t > Previous;
+		std::map< std::string, uint64_t > Current;
+
+		static const size_t QueueLimit = 1024;
 
-			// Return pointer to this object.
+	// Private Methods
 
-				return *this;
-		}
+		void Work();
+		void LoadManifest();
+		void SaveManifest();
 
-		Output& operator<<( const char* s )
-		{
-			// Append incoming cstring to Buffer.
+};
 
-				Buffer.append(s);
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The 'KeyLookup' Class
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-			// Return pointer to this object.
+class KeyLookup
+{
 
-				return *this;
-		}
+public:
 
-		Output& operator<<( const char& c )
-		{
-			// Push incoming char onto Buffer.
+	// Public Data Types
 
-				Buffer.push_back(c);
+		struct Result
+		{
+			std::string DN;
+			std::vector< std::string > Keys;
+			std::string Block;
+			bool Cached;
+		};
 
-			// Return pointer to this object.
+		struct ExportResult
+		{
+			size_t Users;
+			size_t Entries;
+			size_t Written;
+			size_t Unchanged;
+			size_t Removed;
+			size_t Failed;
+		};
 
-				return *this;
-		}
+	// Constructor
 
-		template < typename T, typename = typename std::enable_if< std::is_arithmetic< T >::value, T >::type >
-		Output& operator<<( const T& NumericValue )
-		{
-			// Create local stringstream.
+		KeyLookup( const Config& Configuration, Output& Log, const std::string& Profile = "" );
+		KeyLookup( const KeyLookup& ) = delete;
+		KeyLookup& operator=( const KeyLookup& ) = delete;
 
-				std::stringstream ValueStream;
+	// Destructor
 
-			// Unset floatfield flag for stringstream (is this necessary?)
+		~KeyLookup();
 
-				// ValueStream.unsetf( ios_base::floatfield );
+	// Public Methods
 
-			// Stream numeric value to local stringstream with precision based on its type.
+		void WatchCaller();
+		bool Lookup( const std::string& Username, Result& Keys );
+		void LookupMany( SearchPipeline::Source NextUsername, SearchPipeline::Sink OnResult );
+		size_t Prefetch( const std::vector< std::string >& Usernames );
+		ExportResult Export( const std::string& Directory );
+		std::vector< std::pair< std::string, unsigned long long > > GetCacheStatistics();
 
-				ValueStream << std::setprecision( std::numeric_limits< T >::digits10 ) << NumericValue;
+private:
 
-			// Append stringstream to Buffer.
+	// Private Fields
 
-				Buffer.append( ValueStream.str() );
+		bool CSNValidation;
+		bool StartTLS;
+		bool InstallTLS;
+		bool Bound;
+		int CSNLifetime;
+		int Scope;
+		size_t CacheSize;
+		size_t CacheLifetime;
+		size_t PipelineDepth;
+		size_t MemberChunkSize;
+		uint64_t RulesFingerprint;
+		std::string AttributeName;
+		std::string BindMechanism;
+		std::string BindDN;
+		std::string BindPassword;
+		std::string CurrentCSN;
+		std::string FilterTemplate;
+		std::string MemberAttribute;
+		std::string MemberDNAttribute;
+		std::vector< std::string > URIs;
+		std::map< std::string, std::string > SharedAccounts;
+		Config Cfg;
+		Cache KeyCache;
+		CachePolicy Policy;
+		AccountPolicy Account;
+		HostScope Host;
+		AddressCache Addresses;
+		ValueFilter ValueRules;
+		CallerWatch Caller;
+		ConnectionLimit Limit;
+		Output& Log;
+		LDAP* Interface;
 
-			// Return pointer to this object.
+	// Private Methods
 
-				return *this;
-		}
+		void Open();
+		void Connect();
+		void Disconnect();
+		void ConnectAsync();
+		int Bind( const char* DN, const char* Mechanism, BerValue* Credentials );
+		int Await( const int MessageID, LDAPMessage*& Response );
+		int Search( const std::string& Base, const int SearchScope, const std::string& Filter, char** Attributes, const int SizeLimit,
+		            LDAPMessage*& Response );
+		void ReadCSN();
+		bool LookupMembers( const std::string& GroupDN, Result& Keys, unsigned& Findings );
+		uint64_t GetFingerprint( const std::string& Username );
+		void Admit( const std::vector< std::string >& Usernames, const bool Predicted );
 
-		typedef std::ostream& ( *OStreamManipulator )( std::ostream& );
-		Output& operator<<( OStreamManipulator Object )
-		{
-			// Push newline character onto buffer.
+};
 
-				Buffer.push_back( '\n' );
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The 'RouteTable' Class
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-			// Call sync().
+class RouteTable
+{
 
-				sync();
+public:
 
-			// Set current level back to its default value.
+	// Constructor
 
-				CurrentLevel = Level::Notice;
+		RouteTable( Config& Configuration, Output& Log );
 
-			// Return pointer to this object.
+	// Public Methods
 
-				return *this;
-		}
+		KeyLookup& Select( const std::string& Username );
+		KeyLookup& GetDefault();
+		size_t Size();
 
 private:
 
+	// Private Data Types
+
+		enum class Match
+		{
+			Exact,
+			Prefix,
+			Suffix,
+			Glob
+		};
+
+		struct Route
+		{
+			Match Type;
+			std::string Pattern;
+			size_t Profile;
+		};
+
 	// Private Fields
 
-		bool Active;
-		std::ofstream* LogFile;
-		std::string Buffer;
-		Level CurrentLevel;
-		Level MinimumLevel;
-		Method Facility;
+		Output& Log;
+		std::vector< Route > Routes;
+		std::unordered_map< std::string, size_t > ExactRoutes;
+		std::vector< std::string > ProfileNames;
+		std::vector< std::unique_ptr< KeyLookup > > Profiles;
 
-	// Private Methods
+};
 
-		int sync()
-		{
-			// Create local variables
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The 'KeyServer' Class
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-				std::string LogLevelLabel;
-				time_t CurrentTime = std::chrono::system_clock::to_time_t( std::chrono::system_clock::now() );
-				tm CurrentTimeLocal = *std::localtime( &CurrentTime );
+class KeyServer
+{
 
-			// Perform output logic. Add level token to output for stdout and time + level token for filestream.
-			// On a critical level or above, exit. Also error and exit if level or facility are invalid.
+public:
 
-				if( ( !Buffer.empty() ) && ( !( Buffer == "\n" ) ) )
-				{
-					switch( CurrentLevel )
-					{
-						case Level::Emergency:
-						{
-							LogLevelLabel = "[ Emergency ] : ";
-							break;
-						}
-
-						case Level::Alert:
-						{
-							LogLevelLabel = "[ Alert ] : ";
-							break;
-						}
-
-						case Level::Critical:
-						{
-							LogLevelLabel = "[ Critical ] : ";
-							break;
-						}
-
-						case Level::Error:
-						{
-							LogLevelLabel = "[ Error ] : ";
-							break;
-						}
-
-						case Level::Warning:
-						{
-							LogLevelLabel = "[ Warning ] : ";
-							break;
-						}
-
-						case Level::Notice:
-						{
-							LogLevelLabel = "[ Notice ] : ";
-							break;
-						}
-
-						case Level::Information:
-						{
-							LogLevelLabel = "[ Information ] : ";
-							break;
-						}
-
-						case Level::Debug:
-						{
-							LogLevelLabel = "[ Debug ] : ";
-							break;
-						}
-
-						default:
-						{
-							throw std::out_of_range( "Internal error: Previously qualified log level value is invalid at line 607"
-							                         " of 'LSSHKeys.hpp'. Please file a bug report");
-						}
-						
-					}
+	// Constructor
 
-					if( CurrentLevel <= MinimumLevel )
-					{
-						switch( Facility )
-						{
-							case Method::Syslog:
-							{
-								if ( CurrentLevel <= Level::Warning )
-									std::cerr << LogLevelLabel << Buffer;
-
-								syslog( CurrentLevel, "%s", Buffer.c_str() );
-
-								break;
-							}
-
-							case Method::Stdio:
-							{
-								std::cerr << LogLevelLabel << Buffer;
-
-								break;
-							}
-
-							case Method::File:
-							{
-								if ( CurrentLevel <= Level::Warning )
-									std::cerr << LogLevelLabel << Buffer;
-
-								*LogFile << "[ " 
-								         << std::put_time( &CurrentTimeLocal, "%Y-%m-%d %H:%M:%S %z" ) 
-								         << " ] " 
-								         << LogLevelLabel 
-								         << Buffer;
-
-								break;
-							}
-
-							default:
-							{
-								throw std::out_of_range( "Internal error: Previously qualified log type value is invalid at "
-								                         "line 650 of 'LSSHKeys.hpp'. Please file a bug report.");
-							}
-						}
-					}
+		KeyServer( Config& Configuration, Output& Log );
+		KeyServer( const KeyServer& ) = delete;
+		KeyServer& operator=( const KeyServer& ) = delete;
 
-					Buffer.clear();
+	// Destructor
 
-					if( CurrentLevel <= Level::Critical )
-						SafeExit( EXIT_FAILURE );
-				}
-				else
-				{
-					if ( Buffer == "\n" )
-						Buffer.clear();
-				}
-			
-			// Return on success.
+		~KeyServer();
 
-				return 0;
-		}
+	// Public Methods
+
+		bool IsConfigured();
+		bool Ask( const std::string& Username, std::string& Reply );
+		void Run();
+
+private:
+
+	// Private Data Types
 
-		void SafeExit( int ExitCode )
+		struct Client
 		{
-			// Perform necessary cleanup.
+			std::string Request;
+			std::string Reply;
+			size_t Written = 0;
+			bool Busy = false;
+			bool Ready = false;
+			bool Gone = false;
+		};
 
-				if( Active )
-				{
-					if( Facility == Method::Syslog )
-					{
-						closelog();
-					} 
-					else if( Facility == Method::File )
-					{
-						if( LogFile->is_open() )
-							LogFile->close();
-					}
-					Active = false;
-				}
+		struct Job
+		{
+			int Descriptor;
+			std::string Username;
+			std::string Reply;
+		};
 
-			// Call exit() with given exit code.
+	// Private Fields
+
+		Config& Cfg;
+		Output& Log;
+		std::string SocketPath;
+		size_t ThreadCount;
+		int ReplyTimeout;
+		int Listener;
+		int Events;
+		int Completions;
+		int Signals;
+		uid_t ServerUser;
+		std::atomic< bool > Stopping;
+		std::unordered_map< int, Client > Clients;
+		std::vector< std::thread > Workers;
+		std::mutex PendingLock;
+		std::condition_variable PendingReady;
+		std::deque< Job > Pending;
+		std::mutex FinishedLock;
+		std::vector< Job > Finished;
+
+	// Private Methods
+
+		bool IsTrusted( const uid_t User );
+		void Listen();
+		void Stop();
+		void Accept();
+		void Receive( const int Descriptor );
+		void Send( const int Descriptor );
+		void Hangup( const int Descriptor );
+		void Complete();
+		void Close( const int Descriptor );
+		void Work();
 
-				exit( ExitCode );
-		}
 };
 
 #endif // __QMX_LSSHKEYS_HPP_
@@ -0,0 +1,233 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// AccountPolicy.cpp
+// Matthew J. Schultz | Created : 31OCT17 | Last Modified : 31OCT17 by Matthew J. Schultz
+// Version : 0.0.1
+// This is the source file for the 'AccountPolicy' class of 'LSSHKeys', which decides from a user's entry whether the keys may be used.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2017 QuantuMatriX Software, a QuantuMatriX Technologies Cooperative Partnership.
+//
+// This file is part of 'LSSHKeys'.
+//
+// 'LSSHKeys' is free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any later version.
+//
+// 'LSSHKeys' is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License along with 'LSSHKeys'.  If not, see <http://www.gnu.org/licenses/>.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Header Files
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "../include/LSSHKeys.hpp"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The 'AccountPolicy' Class
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Constructor
+
+AccountPolicy::AccountPolicy( Config& Configuration, Output& Log )
+{
+	// Create local variables.
+
+		std::string Entry;
+
+	// Set field values.
+
+		AccountLock = false;
+		PasswordLock = false;
+		ShadowExpire = false;
+		GroupAttribute = "memberOf";
+
+	// Enable the account status checks listed in the 'account_check' configuration parameter, separated by '|'. Each names the
+	// attribute it reads, which is then requested in the same search as the keys.
+
+		Log << DEBUG << "Checking if 'account_check' parameter exists... ";
+
+		if( Configuration.Exists( "account_check" ) )
+		{
+			Log << "Yes." << std::endl;
+			Log << DEBUG << "The value of 'account_check' is: '" << Configuration.GetValue( "account_check" ) << "'" << std::endl;
+
+			std::istringstream CheckStream( Configuration.GetValue( "account_check" ) );
+
+			while( std::getline( CheckStream, Entry, '|' ) )
+			{
+				if( Entry.empty() )
+					continue;
+
+				if( strcasecmp( Entry.c_str(), "nsAccountLock" ) == 0 )
+					AccountLock = true;
+				else if( strcasecmp( Entry.c_str(), "pwdAccountLockedTime" ) == 0 )
+					PasswordLock = true;
+				else if( strcasecmp( Entry.c_str(), "shadowExpire" ) == 0 )
+					ShadowExpire = true;
+				else
+					throw std::invalid_argument( "Value of 'account_check' parameter invalid: '" + Entry + "'" );
+			}
+
+			if( AccountLock )
+				Attributes.push_back( "nsAccountLock" );
+
+			if( PasswordLock )
+				Attributes.push_back( "pwdAccountLockedTime" );
+
+			if( ShadowExpire )
+				Attributes.push_back( "shadowExpire" );
+		}
+		else
+		{
+			Log << "No." << std::endl;
+		}
+
+	// Require membership of one of the groups listed in the 'require_group' configuration parameter, separated by '|', as read
+	// from the user's 'group_attribute' (default 'memberOf').
+
+		Log << DEBUG << "Checking if 'require_group' parameter exists... ";
+
+		if( Configuration.Exists( "require_group" ) )
+		{
+			Log << "Yes." << std::endl;
+			Log << DEBUG << "The value of 'require_group' is: '" << Configuration.GetValue( "require_group" ) << "'" << std::endl;
+
+			std::istringstream GroupStream( Configuration.GetValue( "require_group" ) );
+
+			while( std::getline( GroupStream, Entry, '|' ) )
+			{
+				if( !Entry.empty() )
+					Groups.push_back( Entry );
+			}
+
+			Log << DEBUG << "Checking if 'group_attribute' parameter exists... ";
+
+			if( Configuration.Exists( "group_attribute" ) && ( !Configuration.GetValue( "group_attribute" ).empty() ) )
+			{
+				Log << "Yes." << std::endl;
+				Log << DEBUG << "The value of 'group_attribute' is: '" << Configuration.GetValue( "group_attribute" ) << "'" << std::endl;
+
+				GroupAttribute = Configuration.GetValue( "group_attribute" );
+			}
+			else
+			{
+				Log << "No." << std::endl;
+				Log << DEBUG << "Defaulting to 'group_attribute' = 'memberOf'." << std::endl;
+			}
+
+			if( !Groups.empty() )
+				Attributes.push_back( GroupAttribute );
+		}
+		else
+		{
+			Log << "No." << std::endl;
+		}
+}
+
+// Public Methods
+
+std::vector< std::string >& AccountPolicy::GetAttributes()
+{
+	// Return the attributes the checks read, to be requested along with the keys.
+
+		return Attributes;
+}
+
+unsigned AccountPolicy::Inspect( const struct berval& Name, BerVarray Values )
+{
+	// Create local variables.
+
+		unsigned Findings = 0;
+		long long Days;
+
+	// Read one attribute of an entry in place and return what it shows. A lock is 'nsAccountLock' set to 'TRUE' or any value of
+	// 'pwdAccountLockedTime'; 'shadowExpire' counts days since the epoch, and the account has expired from that day on. An
+	// account that will expire is reported as expiring, so its keys are not kept in the cache past the day.
+
+		if( Values == nullptr )
+			return 0;
+
+		for( ; Values->bv_val != nullptr; Values++ )
+		{
+			if( AccountLock && Utility::IsAttribute( Name, "nsAccountLock" ) )
+			{
+				if( ( Values->bv_len == 4 ) && ( strncasecmp( Values->bv_val, "TRUE", 4 ) == 0 ) )
+					Findings |= Locked;
+			}
+			else if( PasswordLock && Utility::IsAttribute( Name, "pwdAccountLockedTime" ) )
+			{
+				Findings |= Locked;
+			}
+			else if( ShadowExpire && Utility::IsAttribute( Name, "shadowExpire" ) )
+			{
+				try
+				{
+					Days = std::stoll( std::string( Values->bv_val, Values->bv_len ) );
+				}
+				catch( std::exception& )
+				{
+					Days = 0;
+				}
+
+				if( Days < 0 )
+					continue;
+
+				if( ( time( nullptr ) / 86400 ) >= Days )
+					Findings |= Expired;
+				else
+					Findings |= Expiring;
+			}
+			else if( ( !Groups.empty() ) && Utility::IsAttribute( Name, GroupAttribute ) )
+			{
+				for( const std::string& Group : Groups )
+				{
+					if( ( Values->bv_len == Group.length() ) && ( strncasecmp( Values->bv_val, Group.c_str(), Group.length() ) == 0 ) )
+						Findings |= Member;
+				}
+			}
+		}
+
+	// Return Findings.
+
+		return Findings;
+}
+
+const char* AccountPolicy::Deny( const unsigned Findings )
+{
+	// Return why the keys of an entry with these findings may not be used, or nullptr if they may.
+
+		if( Findings & Locked )
+			return "account locked";
+
+		if( Findings & Expired )
+			return "account expired";
+
+		if( ( !Groups.empty() ) && ( !( Findings & Member ) ) )
+			return "not a member of a required group";
+
+		return nullptr;
+}
+
+uint64_t AccountPolicy::GetFingerprint()
+{
+	// Create local variables.
+
+		std::string Checks;
+
+	// Return a hash of the checks, so keys cached under other checks can be told apart.
+
+		Checks += std::string( "account_lock " ) + ( AccountLock ? "1" : "0" ) + '\n';
+		Checks += std::string( "password_lock " ) + ( PasswordLock ? "1" : "0" ) + '\n';
+		Checks += std::string( "shadow_expire " ) + ( ShadowExpire ? "1" : "0" ) + '\n';
+		Checks += "group_attribute " + GroupAttribute + '\n';
+
+		for( const std::string& Group : Groups )
+			Checks += "group " + Group + '\n';
+
+		return Utility::Hash( Checks );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// End of 'AccountPolicy.cpp'
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
\ No newline at end of file
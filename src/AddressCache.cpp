@@ -0,0 +1,592 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// AddressCache.cpp
+// Matthew J. Schultz | Created : 31OCT17 | Last Modified : 31OCT17 by Matthew J. Schultz
+// Version : 0.0.1
+// This is the source file for the 'AddressCache' class of 'LSSHKeys', which finds the directory servers and the addresses to connect to them at.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2017 QuantuMatriX Software, a QuantuMatriX Technologies Cooperative Partnership.
+//
+// This file is part of 'LSSHKeys'.
+//
+// 'LSSHKeys' is free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any later version.
+//
+// 'LSSHKeys' is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License along with 'LSSHKeys'.  If not, see <http://www.gnu.org/licenses/>.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Header Files
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "../include/LSSHKeys.hpp"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The 'AddressCache' Class
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Static Fields
+
+std::atomic< bool > AddressCache::Threaded( false );
+
+// Constructor
+
+AddressCache::AddressCache()
+{
+	// Set field values.
+
+		Lifetime = 300;
+		Timeout = 5;
+		KeyCache = nullptr;
+		Log = nullptr;
+}
+
+// Destructor
+
+AddressCache::~AddressCache()
+{
+	// Wait for a background refresh still running on a thread, since it uses the cache.
+
+		if( Worker.joinable() )
+			Worker.join();
+}
+
+// Public Methods
+
+void AddressCache::UseThreads()
+{
+	// Refresh in the background on a thread of this process from now on, rather than in a detached process. Server mode calls this
+	// before it starts its workers, as it outlives any refresh and forking a process that runs other threads is not safe.
+
+		Threaded = true;
+}
+
+void AddressCache::Init( Config& Configuration, Cache& KeyCache, Output& Log )
+{
+	// Set field values.
+
+		this->KeyCache = &KeyCache;
+		this->Log = &Log;
+
+	// Read how many seconds resolved addresses are used before they are resolved again from the 'dns_cache_ttl' configuration
+	// parameter, where 0 turns the address cache off. Connecting to a cached address waits for 'bind_timelimit' seconds, or 5.
+
+		Log << DEBUG << "Checking if 'dns_cache_ttl' parameter exists... ";
+
+		if( Configuration.Exists( "dns_cache_ttl" ) )
+		{
+			Log << "Yes." << std::endl;
+			Log << DEBUG << "The value of 'dns_cache_ttl' is: '" << Configuration.GetValue( "dns_cache_ttl" ) << "'" << std::endl;
+
+			try
+			{
+				Lifetime = std::stoi( Configuration.GetValue( "dns_cache_ttl" ) );
+			}
+			catch( std::exception& )
+			{
+				Lifetime = -1;
+			}
+
+			if( Lifetime < 0 )
+				throw std::invalid_argument( "Value of 'dns_cache_ttl' parameter invalid" );
+		}
+		else
+		{
+			Log << "No." << std::endl;
+			Log << DEBUG << "Defaulting to 'dns_cache_ttl' = '300'." << std::endl;
+		}
+
+		if( Configuration.Exists( "bind_timelimit" ) )
+		{
+			try
+			{
+				Timeout = std::max( std::stoi( Configuration.GetValue( "bind_timelimit" ) ), 1 );
+			}
+			catch( std::exception& )
+			{
+				Timeout = 5;
+			}
+		}
+}
+
+LDAP* AddressCache::Open( const std::vector< std::string >& URIs, bool& InstallTLS )
+{
+	// Create local variables.
+
+		int Descriptor = -1;
+		int Port;
+		bool Stale;
+		std::string Host;
+		std::vector< std::string > Addresses;
+		LDAPURLDesc* Description = nullptr;
+		LDAP* ReturnValue = nullptr;
+
+	// Without the cache, libldap resolves the URIs itself.
+
+		if( ( Lifetime == 0 ) || ( KeyCache == nullptr ) || ( !KeyCache->IsActive() ) )
+			return nullptr;
+
+	// Try the URIs in order, each at its cached addresses, and hand the first socket that connects to libldap along with its URI. The
+	// URI keeps the host name, which TLS sends to the server and checks its certificate against. Addresses that have outlived
+	// 'dns_cache_ttl' are still used while a child process resolves them again, so a slow or failing resolver delays no lookup. Any
+	// URI that is not TCP, or cannot be connected to, leaves the connection to libldap.
+
+		for( const std::string& URI : URIs )
+		{
+			if( ldap_url_parse( URI.c_str(), &Description ) != LDAP_URL_SUCCESS )
+				return nullptr;
+
+			Host = ( Description->lud_host != nullptr ) ? Description->lud_host : "";
+			InstallTLS = ( strcasecmp( Description->lud_scheme, "ldaps" ) == 0 );
+			Port = ( Description->lud_port != 0 ) ? Description->lud_port : ( InstallTLS ? 636 : 389 );
+
+			if( ( !InstallTLS ) && ( strcasecmp( Description->lud_scheme, "ldap" ) != 0 ) )
+				Host.clear();
+
+			ldap_free_urldesc( Description );
+
+			if( Host.empty() )
+				return nullptr;
+
+			transform( Host.begin(), Host.end(), Host.begin(), ::tolower );
+
+			Addresses.clear();
+
+			if( KeyCache->LoadAddresses( Host, Addresses, Stale ) )
+			{
+				if( Stale )
+					Refresh( Host, Addresses );
+			}
+			else if( !( Addresses = Resolve( Host ) ).empty() )
+			{
+				Store( Host, Addresses );
+			}
+
+			for( const std::string& Address : Addresses )
+			{
+				*Log << DEBUG << "Connecting to: '" << URI << "' at cached address: '" << Address << "'... ";
+
+				if( ( Descriptor = Dial( Address, Port ) ) == -1 )
+				{
+					*Log << "Failed." << std::endl;
+
+					continue;
+				}
+
+				*Log << "Connected." << std::endl;
+
+				if( ldap_init_fd( Descriptor, LDAP_PROTO_TCP, URI.c_str(), &ReturnValue ) != LDAP_SUCCESS )
+				{
+					close( Descriptor );
+
+					return nullptr;
+				}
+
+				return ReturnValue;
+			}
+		}
+
+	// Return nullptr if no cached address could be connected to.
+
+		return nullptr;
+}
+
+std::vector< std::string > AddressCache::Discover( const std::string& Domain )
+{
+	// Create local variables.
+
+		bool Stale = false;
+		time_t Expires;
+		std::string Name = Domain;
+		std::vector< std::string > Services;
+
+	// Find the directory servers of the domain from its SRV records, kept in the cache until their TTL has passed. Stale records are
+	// still used while they are queried again in the background; without the cache, DNS is queried every time.
+
+		transform( Name.begin(), Name.end(), Name.begin(), ::tolower );
+
+		while( ( !Name.empty() ) && ( Name.back() == '.' ) )
+			Name.pop_back();
+
+		if( Name.empty() || ( Name.find( '/' ) != std::string::npos ) )
+			throw std::invalid_argument( "Value of 'uri' parameter invalid. 'dns:' must be followed by a domain" );
+
+		if( KeyCache->IsActive() && KeyCache->LoadServices( Name, Services, Stale ) )
+		{
+			if( Stale )
+			{
+				try
+				{
+					KeyCache->StoreServices( Name, Services, time( nullptr ) + 60 );
+
+					*Log << DEBUG << "Refreshing the directory servers of: '" << Name << "' in the background." << std::endl;
+
+					Detach( [ this, Name ]()
+					        {
+					            std::vector< std::string > Fresh;
+					            time_t FreshExpires = Query( Name, Fresh );
+
+					            if( !Fresh.empty() )
+					                KeyCache->StoreServices( Name, Fresh, FreshExpires );
+					        } );
+				}
+				catch( std::ios_base::failure& )
+				{
+				}
+			}
+		}
+		else
+		{
+			Expires = Query( Name, Services );
+
+			if( Services.empty() )
+				throw std::runtime_error( "Cannot discover directory servers for: '" + Name + "'" );
+
+			if( KeyCache->IsActive() )
+			{
+				try
+				{
+					KeyCache->StoreServices( Name, Services, Expires );
+				}
+				catch( std::ios_base::failure& Exception )
+				{
+					*Log << WARNING << "Cannot store directory servers in cache. '" << Exception.what() << "' : " << Utility::ErrnoToString()
+					                << ". Attempting to continue." << std::endl;
+				}
+			}
+		}
+
+	// Return the servers' URIs in the order to try them.
+
+		return Order( Services );
+}
+
+// Private Methods
+
+std::vector< std::string > AddressCache::Resolve( const std::string& Host )
+{
+	// Create local variables.
+
+		char Buffer[ NI_MAXHOST ];
+		struct addrinfo Hints;
+		struct addrinfo* Addresses = nullptr;
+		std::vector< std::string > ReturnValue;
+
+	// Resolve the host through the system's resolver, so '/etc/hosts' and the configured name services apply, and keep each distinct
+	// address in the order returned.
+
+		memset( &Hints, 0, sizeof( Hints ) );
+		Hints.ai_family = AF_UNSPEC;
+		Hints.ai_socktype = SOCK_STREAM;
+		Hints.ai_flags = AI_ADDRCONFIG;
+
+		if( getaddrinfo( Host.c_str(), nullptr, &Hints, &Addresses ) != 0 )
+			return ReturnValue;
+
+		for( struct addrinfo* Current = Addresses; Current != nullptr; Current = Current->ai_next )
+		{
+			if( ( getnameinfo( Current->ai_addr, Current->ai_addrlen, Buffer, sizeof( Buffer ), nullptr, 0, NI_NUMERICHOST ) == 0 ) &&
+			    ( std::find( ReturnValue.begin(), ReturnValue.end(), Buffer ) == ReturnValue.end() ) )
+			{
+				ReturnValue.push_back( Buffer );
+			}
+		}
+
+		freeaddrinfo( Addresses );
+
+	// Return ReturnValue.
+
+		return ReturnValue;
+}
+
+void AddressCache::Store( const std::string& Host, const std::vector< std::string >& Addresses )
+{
+	// Store the addresses; failing to is not fatal, as the host is resolved again next time.
+
+		try
+		{
+			KeyCache->StoreAddresses( Host, Addresses, time( nullptr ) + Lifetime );
+		}
+		catch( std::ios_base::failure& Exception )
+		{
+			*Log << WARNING << "Cannot store addresses in cache. '" << Exception.what() << "' : " << Utility::ErrnoToString()
+			                << ". Attempting to continue." << std::endl;
+		}
+}
+
+void AddressCache::Refresh( const std::string& Host, const std::vector< std::string >& Addresses )
+{
+	// Keep the old addresses for another minute first, so concurrent lookups do not each start a refresh, and the addresses are
+	// retried in a minute if the resolver is failing. Then resolve the host again in the background.
+
+		try
+		{
+			KeyCache->StoreAddresses( Host, Addresses, time( nullptr ) + 60 );
+		}
+		catch( std::ios_base::failure& )
+		{
+			return;
+		}
+
+		*Log << DEBUG << "Refreshing the cached addresses of: '" << Host << "' in the background." << std::endl;
+
+		Detach( [ this, Host ]()
+		        {
+		            std::vector< std::string > Resolved = Resolve( Host );
+
+		            if( !Resolved.empty() )
+		                KeyCache->StoreAddresses( Host, Resolved, time( nullptr ) + Lifetime );
+		        } );
+}
+
+time_t AddressCache::Query( const std::string& Domain, std::vector< std::string >& Services )
+{
+	// Create local variables.
+
+		int Length;
+		uint32_t Shortest = UINT32_MAX;
+		char Target[ NS_MAXDNAME ];
+		const unsigned char* Data;
+		std::vector< unsigned char > Answer( NS_PACKETSZ * 16 );
+		ns_msg Message;
+		ns_rr Record;
+
+	// Query the '_ldaps._tcp' and '_ldap._tcp' SRV records of the domain. Each is kept as 'SCHEME PRIORITY WEIGHT PORT TARGET'; a
+	// target of '.' means the service is not offered. The records may be used until the shortest of their TTLs has passed.
+
+		for( const char* Scheme : { "ldaps", "ldap" } )
+		{
+			if( ( Length = res_query( ( std::string( "_" ) + Scheme + "._tcp." + Domain ).c_str(), ns_c_in, ns_t_srv, Answer.data(),
+			                          Answer.size() ) ) <= 0 )
+			{
+				continue;
+			}
+
+			if( ns_initparse( Answer.data(), std::min( Length, ( int ) Answer.size() ), &Message ) != 0 )
+				continue;
+
+			for( int Index = 0; Index < ns_msg_count( Message, ns_s_an ); Index++ )
+			{
+				if( ( ns_parserr( &Message, ns_s_an, Index, &Record ) != 0 ) || ( ns_rr_type( Record ) != ns_t_srv ) ||
+				    ( ns_rr_rdlen( Record ) < 7 ) )
+				{
+					continue;
+				}
+
+				Data = ns_rr_rdata( Record );
+
+				if( ( dn_expand( ns_msg_base( Message ), ns_msg_end( Message ), Data + 6, Target, sizeof( Target ) ) < 0 ) ||
+				    ( Target[ 0 ] == '\0' ) || ( strcmp( Target, "." ) == 0 ) )
+				{
+					continue;
+				}
+
+				Services.push_back( std::string( Scheme ) + " " + std::to_string( ns_get16( Data ) ) + " " + std::to_string( ns_get16( Data + 2 ) ) +
+				                    " " + std::to_string( ns_get16( Data + 4 ) ) + " " + Target );
+				Shortest = std::min( Shortest, ( uint32_t ) ns_rr_ttl( Record ) );
+			}
+		}
+
+	// Return the time the records become stale.
+
+		return time( nullptr ) + ( ( Shortest == UINT32_MAX ) ? 60 : Shortest );
+}
+
+std::vector< std::string > AddressCache::Order( const std::vector< std::string >& Services )
+{
+	// Create local variables.
+
+		size_t Group;
+		size_t Next;
+		unsigned long Total;
+		unsigned long Running;
+		unsigned long Choice;
+		std::vector< Service > Candidates;
+		std::vector< std::string > ReturnValue;
+		std::mt19937 Generator( std::random_device{}() );
+
+	// Parse the services, skipping any that are malformed, and sort them with the 'ldaps' services first, then by priority.
+
+		for( const std::string& Entry : Services )
+		{
+			Service Current;
+			std::istringstream EntryStream( Entry );
+
+			if( EntryStream >> Current.Scheme >> Current.Priority >> Current.Weight >> Current.Port >> Current.Target )
+				Candidates.push_back( Current );
+		}
+
+		std::stable_sort( Candidates.begin(), Candidates.end(),
+		                  []( const Service& Left, const Service& Right )
+		                  {
+		                      return ( std::make_pair( Left.Scheme != "ldaps", Left.Priority ) <
+		                               std::make_pair( Right.Scheme != "ldaps", Right.Priority ) );
+		                  } );
+
+	// Order the services of each priority as RFC 2782 describes: those of weight 0 first, then repeatedly pick one at random with a
+	// chance proportional to its weight, so the load is spread over the servers as the weights say.
+
+		for( Group = 0; Group < Candidates.size(); Group = Next )
+		{
+			for( Next = Group; ( Next < Candidates.size() ) && ( Candidates[ Next ].Scheme == Candidates[ Group ].Scheme ) &&
+			                   ( Candidates[ Next ].Priority == Candidates[ Group ].Priority ); Next++ );
+
+			std::stable_partition( Candidates.begin() + Group, Candidates.begin() + Next, []( const Service& Current ) { return Current.Weight == 0; } );
+
+			for( size_t Position = Group; Position < Next; Position++ )
+			{
+				Total = 0;
+
+				for( size_t Index = Position; Index < Next; Index++ )
+					Total += Candidates[ Index ].Weight;
+
+				Choice = std::uniform_int_distribution< unsigned long >( 0, Total )( Generator );
+				Running = 0;
+
+				for( size_t Index = Position; Index < Next; Index++ )
+				{
+					Running += Candidates[ Index ].Weight;
+
+					if( Running >= Choice )
+					{
+						std::rotate( Candidates.begin() + Position, Candidates.begin() + Index, Candidates.begin() + Index + 1 );
+						break;
+					}
+				}
+
+				ReturnValue.push_back( Candidates[ Position ].Scheme + "://" + Candidates[ Position ].Target + ":" +
+				                       std::to_string( Candidates[ Position ].Port ) );
+			}
+		}
+
+	// Return ReturnValue.
+
+		return ReturnValue;
+}
+
+void AddressCache::Detach( const std::function< void() >& Work )
+{
+	// Create local variables.
+
+		pid_t Child;
+		int Null;
+
+	// In server mode, do the work on a thread, one at a time, since the previous refresh is long finished by the time another is
+	// needed.
+
+		if( Threaded )
+		{
+			if( Worker.joinable() )
+				Worker.join();
+
+			Worker = std::thread( [ Work ]()
+			                      {
+			                          try
+			                          {
+			                              Work();
+			                          }
+			                          catch( ... )
+			                          {
+			                          }
+			                      } );
+
+			return;
+		}
+
+	// Otherwise, do the work in a grandchild detached from this process and its output, so neither the lookup nor the SSH server,
+	// which reads the keys until the output closes, waits for it. The child exits at once and is reaped here. The grandchild keeps
+	// none of the other descriptors, such as the connection to the directory.
+
+		if( ( Child = fork() ) == -1 )
+			return;
+
+		if( Child != 0 )
+		{
+			waitpid( Child, nullptr, 0 );
+
+			return;
+		}
+
+		if( ( Null = open( "/dev/null", O_RDWR ) ) != -1 )
+		{
+			dup2( Null, STDIN_FILENO );
+			dup2( Null, STDOUT_FILENO );
+			dup2( Null, STDERR_FILENO );
+		}
+
+		setsid();
+
+		if( fork() == 0 )
+		{
+			for( long Descriptor = ( STDERR_FILENO + 1 ); Descriptor < sysconf( _SC_OPEN_MAX ); Descriptor++ )
+				close( Descriptor );
+
+			try
+			{
+				Work();
+			}
+			catch( ... )
+			{
+			}
+		}
+
+		_exit( EXIT_SUCCESS );
+}
+
+int AddressCache::Dial( const std::string& Address, const int Port )
+{
+	// Create local variables.
+
+		int Descriptor;
+		int Error = 0;
+		socklen_t Length = sizeof( Error );
+		struct addrinfo Hints;
+		struct addrinfo* Target = nullptr;
+		struct pollfd Poll;
+
+	// Connect to the numeric address without blocking for longer than the timeout, then return the socket in blocking mode for
+	// libldap, or -1.
+
+		memset( &Hints, 0, sizeof( Hints ) );
+		Hints.ai_family = AF_UNSPEC;
+		Hints.ai_socktype = SOCK_STREAM;
+		Hints.ai_flags = ( AI_NUMERICHOST | AI_NUMERICSERV );
+
+		if( getaddrinfo( Address.c_str(), std::to_string( Port ).c_str(), &Hints, &Target ) != 0 )
+			return -1;
+
+		if( ( Descriptor = socket( Target->ai_family, ( SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC ), 0 ) ) == -1 )
+		{
+			freeaddrinfo( Target );
+
+			return -1;
+		}
+
+		if( connect( Descriptor, Target->ai_addr, Target->ai_addrlen ) != 0 )
+		{
+			Poll.fd = Descriptor;
+			Poll.events = POLLOUT;
+
+			if( ( errno != EINPROGRESS ) || ( poll( &Poll, 1, Timeout * 1000 ) != 1 ) ||
+			    ( getsockopt( Descriptor, SOL_SOCKET, SO_ERROR, &Error, &Length ) != 0 ) || ( Error != 0 ) )
+			{
+				close( Descriptor );
+				Descriptor = -1;
+			}
+		}
+
+		freeaddrinfo( Target );
+
+		if( Descriptor != -1 )
+			fcntl( Descriptor, F_SETFL, ( fcntl( Descriptor, F_GETFL ) & ~O_NONBLOCK ) );
+
+	// Return Descriptor.
+
+		return Descriptor;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// End of 'AddressCache.cpp'
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
\ No newline at end of file
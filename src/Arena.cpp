@@ -0,0 +1,87 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Arena.cpp
+// Matthew J. Schultz | Created : 31OCT17 | Last Modified : 31OCT17 by Matthew J. Schultz
+// Version : 0.0.1
+// This is the source file for the 'Arena' class of 'LSSHKeys', a reusable memory resource for per-request objects.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2017 QuantuMatriX Software, a QuantuMatriX Technologies Cooperative Partnership.
+//
+// This file is part of 'LSSHKeys'.
+//
+// 'LSSHKeys' is free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any later version.
+//
+// 'LSSHKeys' is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License along with 'LSSHKeys'.  If not, see <http://www.gnu.org/licenses/>.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Header Files
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "../include/LSSHKeys.hpp"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The 'Arena' Class
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Constructor
+
+Arena::Arena() : Monotonic( Initial, sizeof( Initial ), &Heap )
+{
+	// Set field values.
+
+		Allocations = 0;
+}
+
+// Public Methods
+
+void Arena::Release()
+{
+	// Free everything allocated since the last release at once; the next request starts over in the inline block.
+
+		Monotonic.release();
+}
+
+size_t Arena::GetAllocations()
+{
+	// Return the number of allocations served since construction.
+
+		return Allocations;
+}
+
+size_t Arena::GetHeapAllocations()
+{
+	// Return the number of allocations that needed memory from the heap since construction.
+
+		return Heap.Allocations;
+}
+
+// Private Methods
+
+void* Arena::do_allocate( size_t Bytes, size_t Alignment )
+{
+	// Count the allocation and serve it from the monotonic buffer.
+
+		Allocations++;
+
+		return Monotonic.allocate( Bytes, Alignment );
+}
+
+void Arena::do_deallocate( void* Pointer, size_t Bytes, size_t Alignment )
+{
+	// Memory is only reclaimed by Release().
+}
+
+bool Arena::do_is_equal( const std::pmr::memory_resource& Other ) const noexcept
+{
+	// Only this arena can free its own memory.
+
+		return ( this == &Other );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// End of 'Arena.cpp'
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
\ No newline at end of file
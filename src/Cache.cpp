@@ -0,0 +1,489 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Cache.cpp
+// Matthew J. Schultz | Created : 31OCT17 | Last Modified : 31OCT17 by Matthew J. Schultz
+// Version : 0.0.1
+// This is the source file for the 'Cache' class of 'LSSHKeys', which stores users' DNs and keys between lookups.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2017 QuantuMatriX Software, a QuantuMatriX Technologies Cooperative Partnership.
+//
+// This file is part of 'LSSHKeys'.
+//
+// 'LSSHKeys' is free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any later version.
+//
+// 'LSSHKeys' is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License along with 'LSSHKeys'.  If not, see <http://www.gnu.org/licenses/>.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Header Files
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "../include/LSSHKeys.hpp"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The 'Cache' Class
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Constructor
+
+Cache::Cache()
+{
+	// Set field values.
+
+		Active = false;
+		Keyring = false;
+		Lifetime = 0;
+		KeyringID = -1;
+}
+
+// Public Methods
+
+void Cache::Init( const std::string& Path, const time_t Lifetime )
+{
+	// Create local variables.
+
+		struct stat Status;
+
+	// Create the cache directory if it does not exist; error if it cannot be created or used.
+
+		if( ( mkdir( Path.c_str(), S_IRWXU ) != 0 ) && ( errno != EEXIST ) )
+		{
+			throw std::ios_base::failure( "Cannot create cache directory" );
+		}
+
+	// Cached keys are served without asking the server, so whoever can write to the directory could add keys for any user. Only use
+	// a real directory owned by this user that no one else can write to.
+
+		if( lstat( Path.c_str(), &Status ) != 0 )
+		{
+			throw std::ios_base::failure( "Cannot access cache directory" );
+		}
+
+		if( ( !S_ISDIR( Status.st_mode ) ) || ( Status.st_uid != geteuid() ) || ( Status.st_mode & ( S_IWGRP | S_IWOTH ) ) )
+		{
+			errno = EPERM;
+
+			throw std::ios_base::failure( "Cache directory is not a directory owned by this user and writable by it alone" );
+		}
+
+		if( !ACCESS( Path.c_str(), ( R_OK | W_OK | X_OK ) ) )
+		{
+			throw std::ios_base::failure( "Cannot access cache directory" );
+		}
+
+	// Set field values.
+
+		Directory = Path;
+		this->Lifetime = Lifetime;
+		Active = true;
+}
+
+void Cache::InitKeyring( const std::string& Name, const time_t Lifetime )
+{
+	// Keep the records in the kernel instead of a directory, in the keyring 'Name' inside the user's persistent keyring, which
+	// outlives the processes using it, or inside the user keyring where the kernel has no persistent keyrings. Linking the
+	// persistent keyring to this process's keyring makes this process possess it and the records in it. The keyring is created if
+	// it does not exist yet.
+
+#				if defined( __linux__ )
+
+		long Parent;
+
+		if( ( Parent = syscall( __NR_keyctl, KEYCTL_GET_PERSISTENT, -1, KEY_SPEC_PROCESS_KEYRING ) ) == -1 )
+			Parent = KEY_SPEC_USER_KEYRING;
+
+		if( ( ( KeyringID = syscall( __NR_keyctl, KEYCTL_SEARCH, Parent, "keyring", Name.c_str(), 0 ) ) == -1 ) &&
+		    ( ( KeyringID = syscall( __NR_add_key, "keyring", Name.c_str(), nullptr, 0, Parent ) ) == -1 ) )
+		{
+			throw std::ios_base::failure( "Cannot create cache keyring" );
+		}
+
+#				else
+
+		throw std::ios_base::failure( "Kernel keyrings are not supported on this platform" );
+
+#				endif
+
+	// Set field values.
+
+		this->Lifetime = Lifetime;
+		Keyring = true;
+		Active = true;
+}
+
+bool Cache::IsActive()
+{
+	// Return true if the cache has been initialized.
+
+		return Active;
+}
+
+bool Cache::IsKeyring()
+{
+	// Return true if the records are kept in a kernel keyring.
+
+		return Keyring;
+}
+
+const std::string& Cache::GetDirectory()
+{
+	// Return the directory holding the records.
+
+		return Directory;
+}
+
+bool Cache::Load( const std::string& Username, Record& Entry )
+{
+	// Create local variables.
+
+		bool ReturnValue = false;
+		size_t Position = 0;
+		size_t LineEnd;
+		size_t Separator;
+		time_t Stored;
+		std::string Contents;
+		std::string_view Line;
+
+	// A missing record is a cache miss.
+
+		if( !ReadFile( Username, Contents, Stored ) )
+			return false;
+
+	// Parse the header of the record; each line holds a key and a value separated by a single space. A 'keys' line gives the length
+	// of the rendered authorized_keys block that follows the header, which is taken as it is. Keys are only meaningful when the
+	// record also carries the CSN they were fetched under and the fingerprint of the settings they were selected under.
+
+		Entry.CSN.clear();
+		Entry.Rules = 0;
+		Entry.Block.clear();
+
+		while( ( Position < Contents.size() ) && ( ( LineEnd = Contents.find( '\n', Position ) ) != std::string::npos ) )
+		{
+			Line = std::string_view( Contents ).substr( Position, LineEnd - Position );
+			Position = LineEnd + 1;
+
+			if( ( Separator = Line.find( ' ' ) ) == std::string_view::npos )
+				continue;
+
+			if( Line.compare( 0, Separator, "dn" ) == 0 )
+			{
+				Entry.DN = Line.substr( Separator + 1 );
+				ReturnValue = true;
+			}
+			else if( Line.compare( 0, Separator, "csn" ) == 0 )
+			{
+				Entry.CSN = Line.substr( Separator + 1 );
+			}
+			else if( Line.compare( 0, Separator, "rules" ) == 0 )
+			{
+				Entry.Rules = std::strtoull( std::string( Line.substr( Separator + 1 ) ).c_str(), nullptr, 10 );
+			}
+			else if( Line.compare( 0, Separator, "keys" ) == 0 )
+			{
+				Entry.Block = Contents.substr( Position, std::strtoul( std::string( Line.substr( Separator + 1 ) ).c_str(), nullptr, 10 ) );
+				break;
+			}
+		}
+
+	// Return ReturnValue.
+
+		return ReturnValue;
+}
+
+void Cache::Store( const std::string& Username, const Record& Entry )
+{
+	// Create local variables.
+
+		std::string Contents = "dn " + Entry.DN + "\n";
+
+	// Serialize the record. Keys are only written alongside the CSN that validates them, as the rendered block after the header, so
+	// a hit is served without formatting each key again.
+
+		if( !Entry.CSN.empty() )
+		{
+			Contents += "csn " + Entry.CSN + "\n";
+			Contents += "rules " + std::to_string( Entry.Rules ) + "\n";
+			Contents += "keys " + std::to_string( Entry.Block.size() ) + "\n";
+			Contents += Entry.Block;
+		}
+
+		WriteFile( Username, Contents );
+}
+
+bool Cache::LoadCSN( std::string& CSN, const time_t MaximumAge )
+{
+	// Create local variables.
+
+		time_t Stored;
+		std::string Contents;
+
+	// The CSN last read from the server is only trusted for 'MaximumAge' seconds after it was stored.
+
+		if( ( !ReadFile( ".csn", Contents, Stored ) ) || ( ( time( nullptr ) - Stored ) >= MaximumAge ) )
+			return false;
+
+		if( ( Contents.compare( 0, 4, "csn " ) != 0 ) || ( Contents.find( '\n' ) == std::string::npos ) )
+			return false;
+
+		CSN = Contents.substr( 4, Contents.find( '\n' ) - 4 );
+
+	// Return true on success.
+
+		return true;
+}
+
+void Cache::StoreCSN( const std::string& CSN )
+{
+	// Store the CSN last read from the server; the time it is stored records when it was read.
+
+		WriteFile( ".csn", "csn " + CSN + "\n" );
+}
+
+bool Cache::LoadHost( std::string& FQDN, const time_t MaximumAge )
+{
+	// Create local variables.
+
+		time_t Stored;
+		std::string Contents;
+
+	// The host's resolved name is only trusted for 'MaximumAge' seconds after it was stored.
+
+		if( ( !ReadFile( ".host", Contents, Stored ) ) || ( ( time( nullptr ) - Stored ) >= MaximumAge ) )
+			return false;
+
+		if( ( Contents.compare( 0, 5, "fqdn " ) != 0 ) || ( Contents.find( '\n' ) <= 5 ) )
+			return false;
+
+		FQDN = Contents.substr( 5, Contents.find( '\n' ) - 5 );
+
+	// Return true on success.
+
+		return true;
+}
+
+void Cache::StoreHost( const std::string& FQDN )
+{
+	// Store the host's resolved name; the time it is stored records when it was resolved.
+
+		WriteFile( ".host", "fqdn " + FQDN + "\n" );
+}
+
+bool Cache::LoadAddresses( const std::string& Host, std::vector< std::string >& Addresses, bool& Stale )
+{
+	// Load the addresses the host resolved to.
+
+		return LoadExpiring( ".dns." + Host, "address", Addresses, Stale );
+}
+
+void Cache::StoreAddresses( const std::string& Host, const std::vector< std::string >& Addresses, const time_t Expires )
+{
+	// Store the host's resolved addresses with the time they become stale.
+
+		StoreExpiring( ".dns." + Host, "address", Addresses, Expires );
+}
+
+bool Cache::LoadServices( const std::string& Domain, std::vector< std::string >& Services, bool& Stale )
+{
+	// Load the directory services discovered for the domain.
+
+		return LoadExpiring( ".srv." + Domain, "service", Services, Stale );
+}
+
+void Cache::StoreServices( const std::string& Domain, const std::vector< std::string >& Services, const time_t Expires )
+{
+	// Store the domain's discovered directory services with the time they become stale.
+
+		StoreExpiring( ".srv." + Domain, "service", Services, Expires );
+}
+
+void Cache::Remove( const std::string& Username )
+{
+	// Remove the record; a record that is already gone is not an error.
+
+		RemoveFile( Username );
+}
+
+// Private Methods
+
+bool Cache::LoadExpiring( const std::string& Name, const std::string& Field, std::vector< std::string >& Values, bool& Stale )
+{
+	// Create local variables.
+
+		long long Expires = 0;
+		time_t Stored;
+		std::string Contents;
+		std::string Line;
+
+	// A missing record is a cache miss. The values are stale once the time stored with them has passed.
+
+		if( !ReadFile( Name, Contents, Stored ) )
+			return false;
+
+		std::istringstream File( Contents );
+
+		while( std::getline( File, Line ) )
+		{
+			if( Line.compare( 0, 8, "expires " ) == 0 )
+				Expires = std::atoll( Line.c_str() + 8 );
+			else if( ( Line.length() > ( Field.length() + 1 ) ) && ( Line.compare( 0, Field.length(), Field ) == 0 ) &&
+			         ( Line[ Field.length() ] == ' ' ) )
+				Values.push_back( Line.substr( Field.length() + 1 ) );
+		}
+
+		Stale = ( time( nullptr ) >= Expires );
+
+	// Return true if there are any values.
+
+		return !Values.empty();
+}
+
+void Cache::StoreExpiring( const std::string& Name, const std::string& Field, const std::vector< std::string >& Values, const time_t Expires )
+{
+	// Create local variables.
+
+		std::string Contents = "expires " + std::to_string( Expires ) + "\n";
+
+	// Serialize the values, one per line, after the time they become stale.
+
+		for( const std::string& Value : Values )
+			Contents += Field + " " + Value + "\n";
+
+		WriteFile( Name, Contents );
+}
+
+bool Cache::ReadFile( const std::string& Name, std::string& Contents, time_t& Stored )
+{
+	// Create local variables.
+
+		size_t Separator;
+		struct stat Status;
+
+	// Read a record and the time it was stored: from a file, with a single read, and its modification time, or from a key in the
+	// keyring, whose contents start with a line 'stored TIME'. A record older than the lifetime is a miss; the kernel also drops such
+	// keys by itself.
+
+		if( Keyring )
+		{
+
+#					if defined( __linux__ )
+
+			long Key;
+			long Size;
+			std::vector< char > Buffer( 4096 );
+
+			if( ( Key = syscall( __NR_keyctl, KEYCTL_SEARCH, KeyringID, "user", Name.c_str(), 0 ) ) == -1 )
+				return false;
+
+			while( ( ( Size = syscall( __NR_keyctl, KEYCTL_READ, Key, Buffer.data(), Buffer.size() ) ) != -1 ) &&
+			       ( ( size_t ) Size > Buffer.size() ) )
+			{
+				Buffer.resize( Size );
+			}
+
+			if( Size == -1 )
+				return false;
+
+			Contents.assign( Buffer.data(), Size );
+
+			if( ( Contents.compare( 0, 7, "stored " ) != 0 ) || ( ( Separator = Contents.find( '\n' ) ) == std::string::npos ) )
+				return false;
+
+			Stored = std::atoll( Contents.c_str() + 7 );
+			Contents.erase( 0, Separator + 1 );
+
+#					endif
+
+		}
+		else
+		{
+			int Descriptor;
+			ssize_t Size;
+
+			if( ( Descriptor = open( ( Directory + "/" + Name ).c_str(), ( O_RDONLY | O_CLOEXEC | O_NOFOLLOW ) ) ) == -1 )
+				return false;
+
+			if( fstat( Descriptor, &Status ) != 0 )
+			{
+				close( Descriptor );
+
+				return false;
+			}
+
+			Contents.resize( Status.st_size );
+			Size = read( Descriptor, Contents.data(), Contents.size() );
+
+			close( Descriptor );
+
+			if( Size != ( ssize_t ) Status.st_size )
+				return false;
+
+			Stored = Status.st_mtime;
+		}
+
+	// Return true if the record is within its lifetime.
+
+		return ( ( Lifetime == 0 ) || ( ( time( nullptr ) - Stored ) < Lifetime ) );
+}
+
+void Cache::WriteFile( const std::string& Name, const std::string& Contents )
+{
+	// Replace the file atomically. Temporary names start with a dot, which can never collide with a valid username. In the keyring,
+	// adding a key replaces the contents of one with the same name at once, and the kernel removes it after the lifetime.
+
+		if( Keyring )
+		{
+
+#					if defined( __linux__ )
+
+			long Key;
+			std::string Payload = "stored " + std::to_string( time( nullptr ) ) + "\n" + Contents;
+
+			if( ( Key = syscall( __NR_add_key, "user", Name.c_str(), Payload.data(), Payload.size(), KeyringID ) ) == -1 )
+			{
+				throw std::ios_base::failure( "Cannot write key" );
+			}
+
+			if( Lifetime != 0 )
+				syscall( __NR_keyctl, KEYCTL_SET_TIMEOUT, Key, ( unsigned ) Lifetime );
+
+#					endif
+
+		}
+		else
+		{
+			Utility::WriteFileAtomically( Directory, Name, Contents, ( S_IRUSR | S_IWUSR ) );
+		}
+}
+
+void Cache::RemoveFile( const std::string& Name )
+{
+	// Remove the file, or unlink the key from the keyring; a record that is already gone is not an error.
+
+		if( Keyring )
+		{
+
+#					if defined( __linux__ )
+
+			long Key;
+
+			if( ( ( Key = syscall( __NR_keyctl, KEYCTL_SEARCH, KeyringID, "user", Name.c_str(), 0 ) ) != -1 ) &&
+			    ( syscall( __NR_keyctl, KEYCTL_UNLINK, Key, KeyringID ) == -1 ) && ( errno != ENOKEY ) )
+			{
+				throw std::ios_base::failure( "Cannot remove cache record" );
+			}
+
+#					endif
+
+		}
+		else if( ( unlink( ( Directory + "/" + Name ).c_str() ) != 0 ) && ( errno != ENOENT ) )
+		{
+			throw std::ios_base::failure( "Cannot remove cache record" );
+		}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// End of 'Cache.cpp'
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
\ No newline at end of file
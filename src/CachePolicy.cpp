@@ -0,0 +1,502 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// CachePolicy.cpp
+// Matthew J. Schultz | Created : 31OCT17 | Last Modified : 31OCT17 by Matthew J. Schultz
+// Version : 0.0.1
+// This is the source file for the 'CachePolicy' class of 'LSSHKeys', which bounds the cache with the W-TinyLFU policy.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2017 QuantuMatriX Software, a QuantuMatriX Technologies Cooperative Partnership.
+//
+// This file is part of 'LSSHKeys'.
+//
+// 'LSSHKeys' is free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any later version.
+//
+// 'LSSHKeys' is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License along with 'LSSHKeys'.  If not, see <http://www.gnu.org/licenses/>.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Header Files
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "../include/LSSHKeys.hpp"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The 'CachePolicy' Class
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Constructor
+
+CachePolicy::CachePolicy()
+{
+	// Set field values.
+
+		Descriptor = -1;
+		Capacity = 0;
+}
+
+// Destructor
+
+CachePolicy::~CachePolicy()
+{
+	// Perform necessary cleanup.
+
+		if( Descriptor != -1 )
+		{
+			flock( Descriptor, LOCK_UN );
+			close( Descriptor );
+		}
+}
+
+// Public Methods
+
+void CachePolicy::Open( const std::string& Directory, const size_t Capacity )
+{
+	// Lock the policy state shared by all invocations and load it. Hold the lock only briefly; it serializes every lookup that
+	// uses the cache.
+
+		if( ( Descriptor = open( ( Directory + "/.policy" ).c_str(), ( O_RDWR | O_CREAT | O_CLOEXEC | O_NOFOLLOW ), ( S_IRUSR | S_IWUSR ) ) ) == -1 )
+		{
+			throw std::ios_base::failure( "Cannot open cache policy" );
+		}
+
+		if( flock( Descriptor, LOCK_EX ) != 0 )
+		{
+			close( Descriptor );
+			Descriptor = -1;
+
+			throw std::ios_base::failure( "Cannot lock cache policy" );
+		}
+
+		this->Capacity = std::max< size_t >( Capacity, 1 );
+		WindowCapacity = std::max< size_t >( this->Capacity / 100, 1 );
+		MainCapacity = this->Capacity - std::min( WindowCapacity, this->Capacity );
+		ProtectedCapacity = ( MainCapacity * 8 ) / 10;
+
+	// Start over from the records on disk when there is no usable state (first use, corruption or a changed capacity).
+
+		if( !Load() )
+			Import( Directory );
+}
+
+void CachePolicy::Close()
+{
+	// Save the policy state and release the lock.
+
+		if( Descriptor != -1 )
+		{
+			Save();
+			flock( Descriptor, LOCK_UN );
+			close( Descriptor );
+
+			Descriptor = -1;
+		}
+}
+
+CachePolicy::Segment CachePolicy::Access( const std::string& Username )
+{
+	// Create local variables.
+
+		Segment ReturnValue = None;
+		std::unordered_map< std::string, Segment >::iterator Position = Index.find( Username );
+
+	// Count the access in the frequency sketch whether or not the user is cached; admission decisions are based on it.
+
+		Increment( Username );
+
+	// On a hit, move the user to the most recently used end of its segment. A hit in probation promotes the user to the protected
+	// segment, demoting the least recently used protected user back to probation if the protected segment is full.
+
+		if( Position == Index.end() )
+		{
+			Statistics[ "misses" ]++;
+
+			return None;
+		}
+
+		ReturnValue = Position->second;
+
+		switch( ReturnValue )
+		{
+			case Segment::Window:
+			{
+				Statistics[ "window_hits" ]++;
+				MoveToFront( WindowList, Username );
+				break;
+			}
+
+			case Segment::Probation:
+			{
+				Statistics[ "probation_hits" ]++;
+				ProbationList.remove( Username );
+				ProtectedList.push_front( Username );
+				Position->second = Segment::Protected;
+
+				if( ProtectedList.size() > ProtectedCapacity )
+				{
+					ProbationList.push_front( ProtectedList.back() );
+					Index[ ProtectedList.back() ] = Segment::Probation;
+					ProtectedList.pop_back();
+				}
+
+				break;
+			}
+
+			default:
+			{
+				Statistics[ "protected_hits" ]++;
+				MoveToFront( ProtectedList, Username );
+				break;
+			}
+		}
+
+	// Return ReturnValue.
+
+		return ReturnValue;
+}
+
+void CachePolicy::Predict( const std::string& Username )
+{
+	// Count a predicted access, such as a prefetch, in the frequency sketch without counting it as a hit or miss.
+
+		Increment( Username );
+}
+
+void CachePolicy::Admit( const std::string& Username )
+{
+	// Create local variables.
+
+		std::string Candidate;
+		std::string Victim;
+
+	// New users always enter the window. The user falling out of the window only enters the main segments if the sketch says it
+	// is used more often than the user it would evict, so a burst of one-off usernames cannot flush out frequently used ones.
+
+		if( Index.find( Username ) != Index.end() )
+			return;
+
+		WindowList.push_front( Username );
+		Index[ Username ] = Segment::Window;
+
+		if( WindowList.size() <= WindowCapacity )
+			return;
+
+		Candidate = WindowList.back();
+		WindowList.pop_back();
+
+		if( ( ProbationList.size() + ProtectedList.size() ) < MainCapacity )
+		{
+			ProbationList.push_front( Candidate );
+			Index[ Candidate ] = Segment::Probation;
+
+			return;
+		}
+
+		if( ProbationList.empty() && ProtectedList.empty() )
+		{
+			Statistics[ "rejected" ]++;
+			Evict( Candidate );
+
+			return;
+		}
+
+		Victim = ( ProbationList.empty() ? ProtectedList.back() : ProbationList.back() );
+
+		if( Frequency( Candidate ) > Frequency( Victim ) )
+		{
+			Statistics[ "admitted" ]++;
+			( ProbationList.empty() ? ProtectedList : ProbationList ).pop_back();
+			Evict( Victim );
+			ProbationList.push_front( Candidate );
+			Index[ Candidate ] = Segment::Probation;
+		}
+		else
+		{
+			Statistics[ "rejected" ]++;
+			Evict( Candidate );
+		}
+}
+
+std::vector< std::string > CachePolicy::TakeEvictions()
+{
+	// Create local variables.
+
+		std::vector< std::string > ReturnValue;
+
+	// Return the users evicted since the last call; their cache records must be removed by the caller.
+
+		ReturnValue.swap( Evictions );
+
+		return ReturnValue;
+}
+
+std::vector< std::pair< std::string, unsigned long long > > CachePolicy::GetStatistics()
+{
+	// Create local variables.
+
+		std::vector< std::pair< std::string, unsigned long long > > ReturnValue;
+
+	// Return the counters in a fixed order, followed by the current number of entries.
+
+		for( const char* Name : StatisticNames )
+			ReturnValue.push_back( std::make_pair( Name, Statistics[ Name ] ) );
+
+		ReturnValue.push_back( std::make_pair( "entries", Index.size() ) );
+		ReturnValue.push_back( std::make_pair( "capacity", Capacity ) );
+
+		return ReturnValue;
+}
+
+// Private Methods
+
+void CachePolicy::MoveToFront( std::list< std::string >& List, const std::string& Username )
+{
+	// Move 'Username' to the most recently used end of 'List'.
+
+		List.remove( Username );
+		List.push_front( Username );
+}
+
+void CachePolicy::Evict( const std::string& Username )
+{
+	// Forget the user and queue its cache record for removal.
+
+		Statistics[ "evicted" ]++;
+		Index.erase( Username );
+		Evictions.push_back( Username );
+}
+
+size_t CachePolicy::Slot( const std::string& Username, const int Row )
+{
+	// Create local variables.
+
+		uint64_t Hash = Utility::Hash( Username );
+
+	// Derive one counter per sketch row from a single hash by double hashing.
+
+		return ( ( Row * Width ) + ( ( ( Hash & 0xffffffffull ) + ( Row * ( ( Hash >> 32 ) | 1 ) ) ) & ( Width - 1 ) ) );
+}
+
+unsigned CachePolicy::Counter( const size_t Position )
+{
+	// Return the 4-bit counter at 'Position'; two counters are packed in each byte.
+
+		return ( ( Sketch[ Position / 2 ] >> ( ( Position % 2 ) * 4 ) ) & 0x0f );
+}
+
+unsigned CachePolicy::Frequency( const std::string& Username )
+{
+	// Create local variables.
+
+		unsigned ReturnValue = 15;
+
+	// The estimate is the smallest of the user's counters (count-min).
+
+		for( int Row = 0; Row < SketchDepth; Row++ )
+			ReturnValue = std::min( ReturnValue, Counter( Slot( Username, Row ) ) );
+
+		return ReturnValue;
+}
+
+void CachePolicy::Increment( const std::string& Username )
+{
+	// Create local variables.
+
+		size_t Position;
+
+	// Increment the user's counters, saturating at 15.
+
+		for( int Row = 0; Row < SketchDepth; Row++ )
+		{
+			Position = Slot( Username, Row );
+
+			if( Counter( Position ) < 15 )
+				Sketch[ Position / 2 ] += ( 1 << ( ( Position % 2 ) * 4 ) );
+		}
+
+	// Age the sketch by halving every counter once it has seen ten times as many accesses as the cache holds, so old popularity
+	// fades.
+
+		if( ++Additions >= ( Capacity * 10 ) )
+		{
+			for( uint8_t& Pair : Sketch )
+				Pair = ( ( Pair >> 1 ) & 0x77 );
+
+			Additions /= 2;
+		}
+}
+
+void CachePolicy::Reset()
+{
+	// Size the sketch to the next power of two at or above the capacity and clear all state.
+
+		for( Width = 16; Width < Capacity; Width *= 2 );
+
+		Sketch.assign( ( Width * SketchDepth ) / 2, 0 );
+		Additions = 0;
+		WindowList.clear();
+		ProbationList.clear();
+		ProtectedList.clear();
+		Index.clear();
+}
+
+void CachePolicy::Import( const std::string& Directory )
+{
+	// Create local variables.
+
+		DIR* Handle;
+		struct dirent* Item;
+
+	// Track every record already on disk, evicting whatever does not fit.
+
+		Reset();
+
+		if( ( Handle = opendir( Directory.c_str() ) ) == nullptr )
+			return;
+
+		while( ( Item = readdir( Handle ) ) != nullptr )
+		{
+			if( Utility::IsValidUsername( Item->d_name ) )
+				Admit( Item->d_name );
+		}
+
+		closedir( Handle );
+}
+
+bool CachePolicy::Load()
+{
+	// Create local variables.
+
+		struct stat Status;
+		std::string Contents;
+		std::string Key;
+		std::string Name;
+		std::string Hexadecimal;
+		std::istringstream Stream;
+		unsigned long long Value;
+		size_t StoredCapacity = 0;
+
+	// Read the whole file.
+
+		if( ( fstat( Descriptor, &Status ) != 0 ) || ( Status.st_size == 0 ) )
+			return false;
+
+		Contents.resize( Status.st_size );
+
+		if( pread( Descriptor, &Contents[ 0 ], Contents.size(), 0 ) != ( ssize_t ) Contents.size() )
+			return false;
+
+	// Parse the state: a header, the capacity, the counters, the three segments (most recently used first) and the sketch.
+
+		Reset();
+		Stream.str( Contents );
+
+		if( !std::getline( Stream, Key ) || ( Key != "lsshkeys-policy 1" ) )
+			return false;
+
+		while( Stream >> Key )
+		{
+			if( Key == "capacity" )
+			{
+				Stream >> StoredCapacity;
+			}
+			else if( Key == "additions" )
+			{
+				Stream >> Additions;
+			}
+			else if( Key == "statistic" )
+			{
+				Stream >> Name >> Value;
+				Statistics[ Name ] = Value;
+			}
+			else if( ( Key == "window" ) || ( Key == "probation" ) || ( Key == "protected" ) )
+			{
+				Stream >> Name;
+
+				if( Key == "window" )
+				{
+					WindowList.push_back( Name );
+					Index[ Name ] = Segment::Window;
+				}
+				else if( Key == "probation" )
+				{
+					ProbationList.push_back( Name );
+					Index[ Name ] = Segment::Probation;
+				}
+				else
+				{
+					ProtectedList.push_back( Name );
+					Index[ Name ] = Segment::Protected;
+				}
+			}
+			else if( Key == "sketch" )
+			{
+				Stream >> Hexadecimal;
+			}
+			else
+			{
+				return false;
+			}
+		}
+
+	// Discard the state if the capacity changed or the sketch does not fit it; the statistics are kept.
+
+		if( ( StoredCapacity != Capacity ) || ( Hexadecimal.size() != ( Sketch.size() * 2 ) ) )
+			return false;
+
+		for( size_t Position = 0; Position < Sketch.size(); Position++ )
+			Sketch[ Position ] = ( uint8_t ) std::stoul( Hexadecimal.substr( Position * 2, 2 ), nullptr, 16 );
+
+	// Return true on success.
+
+		return true;
+}
+
+void CachePolicy::Save()
+{
+	// Create local variables.
+
+		static const char Digits[] = "0123456789abcdef";
+		std::string Contents = "lsshkeys-policy 1\n";
+
+	// Serialize the state in the format read by Load().
+
+		Contents += "capacity " + std::to_string( Capacity ) + "\n";
+		Contents += "additions " + std::to_string( Additions ) + "\n";
+
+		for( const std::pair< const std::string, unsigned long long >& Statistic : Statistics )
+			Contents += "statistic " + Statistic.first + " " + std::to_string( Statistic.second ) + "\n";
+
+		for( const std::string& Name : WindowList )
+			Contents += "window " + Name + "\n";
+
+		for( const std::string& Name : ProbationList )
+			Contents += "probation " + Name + "\n";
+
+		for( const std::string& Name : ProtectedList )
+			Contents += "protected " + Name + "\n";
+
+		Contents += "sketch ";
+
+		for( const uint8_t Pair : Sketch )
+		{
+			Contents.push_back( Digits[ Pair >> 4 ] );
+			Contents.push_back( Digits[ Pair & 0x0f ] );
+		}
+
+		Contents += "\n";
+
+	// Overwrite the file in place; the lock keeps other invocations from reading it meanwhile.
+
+		if( ( pwrite( Descriptor, Contents.data(), Contents.size(), 0 ) != ( ssize_t ) Contents.size() ) ||
+		    ( ftruncate( Descriptor, Contents.size() ) != 0 ) )
+		{
+			ftruncate( Descriptor, 0 );
+		}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// End of 'CachePolicy.cpp'
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
\ No newline at end of file
@@ -0,0 +1,174 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// CallerWatch.cpp
+// Matthew J. Schultz | Created : 31OCT17 | Last Modified : 31OCT17 by Matthew J. Schultz
+// Version : 0.0.1
+// This is the source file for the 'CallerWatch' class of 'LSSHKeys', which abandons a lookup the calling process has given up on.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2017 QuantuMatriX Software, a QuantuMatriX Technologies Cooperative Partnership.
+//
+// This file is part of 'LSSHKeys'.
+//
+// 'LSSHKeys' is free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any later version.
+//
+// 'LSSHKeys' is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License along with 'LSSHKeys'.  If not, see <http://www.gnu.org/licenses/>.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Header Files
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "../include/LSSHKeys.hpp"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The 'CallerWatch' Class
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Constructor
+
+CallerWatch::CallerWatch()
+{
+	// Set field values.
+
+		Active = false;
+		Descriptor = -1;
+		Parent = 0;
+		Log = nullptr;
+}
+
+// Destructor
+
+CallerWatch::~CallerWatch()
+{
+	// Close the parent's process descriptor.
+
+		if( Descriptor != -1 )
+			close( Descriptor );
+}
+
+// Public Methods
+
+void CallerWatch::Start( Output& Log )
+{
+	// Set field values.
+
+		this->Log = &Log;
+		Parent = getppid();
+		Active = true;
+
+	// Watch the parent, normally sshd, through a process descriptor, which becomes readable when it exits. Where the kernel has none,
+	// ask it to terminate this process instead; the connection is then closed without abandoning the operation first. The parent may
+	// have exited before either was set up, which shows as a new parent.
+
+#				if defined( __linux__ )
+
+#					if defined( __NR_pidfd_open )
+
+		if( ( Descriptor = syscall( __NR_pidfd_open, Parent, 0 ) ) == -1 )
+			prctl( PR_SET_PDEATHSIG, SIGTERM );
+
+#					else
+
+		prctl( PR_SET_PDEATHSIG, SIGTERM );
+
+#					endif
+
+#				endif
+
+		if( getppid() != Parent )
+			Abandon( nullptr, -1, "parent exited" );
+}
+
+int CallerWatch::Wait( LDAP* Interface, const int MessageID, const int All, LDAPMessage*& Message )
+{
+	// Create local variables.
+
+		int ReturnValue;
+		int Socket = -1;
+		int Remaining = -1;
+		struct timeval* Timeout = nullptr;
+		struct timeval Poll = { 0, 0 };
+		struct pollfd Polls[ 3 ];
+		std::chrono::steady_clock::time_point Deadline;
+
+	// Without a watch, wait for the result as libldap would.
+
+		Message = nullptr;
+
+		if( !Active )
+			return ldap_result( Interface, MessageID, All, nullptr, &Message );
+
+	// Wait no longer than the 'bind_timelimit' set as LDAP_OPT_TIMEOUT, as the synchronous calls do.
+
+		if( ( ldap_get_option( Interface, LDAP_OPT_TIMEOUT, &Timeout ) == LDAP_OPT_SUCCESS ) && ( Timeout != nullptr ) )
+		{
+			if( Timeout->tv_sec >= 0 )
+			{
+				Remaining = ( Timeout->tv_sec * 1000 ) + ( Timeout->tv_usec / 1000 );
+				Deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds( Remaining );
+			}
+
+			ldap_memfree( Timeout );
+		}
+
+	// Take the result as soon as it is complete, polling the connection together with stdout, which reports an error or a hangup once
+	// sshd closes its end of the pipe, and the parent's process descriptor. Either of those abandons the operation, as does a stdout
+	// that is not open at all, since the keys could not be written and poll() would report it at once on every pass.
+
+		for( ; ; )
+		{
+			if( ( ReturnValue = ldap_result( Interface, MessageID, All, &Poll, &Message ) ) != 0 )
+				return ReturnValue;
+
+			if( Remaining != -1 )
+			{
+				Remaining = std::chrono::duration_cast< std::chrono::milliseconds >( Deadline - std::chrono::steady_clock::now() ).count();
+
+				if( Remaining <= 0 )
+					return 0;
+			}
+
+			if( ( ldap_get_option( Interface, LDAP_OPT_DESC, &Socket ) != LDAP_OPT_SUCCESS ) || ( Socket == -1 ) )
+				return ldap_result( Interface, MessageID, All, nullptr, &Message );
+
+			Polls[ 0 ] = { Socket, POLLIN, 0 };
+			Polls[ 1 ] = { STDOUT_FILENO, 0, 0 };
+			Polls[ 2 ] = { Descriptor, POLLIN, 0 };
+
+			if( ( poll( Polls, ( ( Descriptor != -1 ) ? 3 : 2 ), Remaining ) == -1 ) && ( errno != EINTR ) )
+				return -1;
+
+			if( Polls[ 1 ].revents & ( POLLHUP | POLLERR | POLLNVAL ) )
+				Abandon( Interface, MessageID, "stdout closed" );
+
+			if( ( Descriptor != -1 ) && ( Polls[ 2 ].revents != 0 ) )
+				Abandon( Interface, MessageID, "parent exited" );
+		}
+}
+
+// Private Methods
+
+void CallerWatch::Abandon( LDAP* Interface, const int MessageID, const char* Reason )
+{
+	// Abandon the operation and unbind, so the server stops working for a caller that is gone and the connection is not held until
+	// the timeouts run out, then exit at once. Nothing is left to write to.
+
+		if( Interface != nullptr )
+		{
+			if( MessageID > 0 )
+				ldap_abandon_ext( Interface, MessageID, nullptr, nullptr );
+
+			ldap_unbind_ext_s( Interface, nullptr, nullptr );
+		}
+
+		*Log << NOTICE << "Abandoned lookup (" << Reason << ")." << std::endl;
+
+		_exit( EXIT_FAILURE );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// End of 'CallerWatch.cpp'
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
\ No newline at end of file
@@ -0,0 +1,159 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Config.cpp
+// Matthew J. Schultz | Created : 31OCT17 | Last Modified : 31OCT17 by Matthew J. Schultz
+// Version : 0.0.1
+// This is the source file for the 'Config' class of 'LSSHKeys', which reads the configuration file.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2017 QuantuMatriX Software, a QuantuMatriX Technologies Cooperative Partnership.
+//
+// This file is part of 'LSSHKeys'.
+//
+// 'LSSHKeys' is free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any later version.
+//
+// 'LSSHKeys' is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License along with 'LSSHKeys'.  If not, see <http://www.gnu.org/licenses/>.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Header Files
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "../include/LSSHKeys.hpp"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The 'Config' Class
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Public Methods
+
+void Config::Init()
+{
+	// Initialize using default configuration file.
+
+		std::ifstream File( CONFIG );
+		Init( File );
+}
+
+void Config::Init( std::ifstream& File )
+{
+	// Create local variables.
+
+		char CurrentSymbol;
+		bool Comment = false;
+		std::string Buffer;
+		std::string Key;
+		std::string Value;
+
+	// Ensure our file is open.
+
+		if( !File.is_open() )
+		{
+			throw std::ios_base::failure( "Cannot open configuration file" );
+		}
+
+	// Parse contents of configuration file and store in configuration map.
+
+		while( File.good() )
+		{
+			CurrentSymbol = File.get();
+
+			if( CurrentSymbol == '#' )
+			{
+				Comment = true;
+			}
+			else if( ( ( CurrentSymbol == '\t' ) || ( CurrentSymbol == ' ') ) && ( !Comment ))
+			{
+				Key = Buffer;
+				Buffer.clear();
+			}
+			else if( CurrentSymbol == '\n' )
+			{
+				if( !Comment )
+				{
+					if ( !Buffer.empty() )
+					{
+						Value = Buffer;
+						Buffer.clear();
+						ConfigurationMap.insert( make_pair( Key, Value ) );
+					}
+				}
+				else
+					Comment = false;
+			}
+			else
+			{
+				if( !Comment )
+					Buffer.push_back( CurrentSymbol );
+			}
+
+		}
+}
+
+bool Config::Exists( const std::string_view Key )
+{
+
+	// Create local variables.
+
+		bool ReturnValue;
+		std::map< std::string, std::string, std::less<> >::iterator Iterator;
+
+	// Search for 'key' in the configuration map.
+
+		Iterator = ConfigurationMap.find( Key );
+
+	// Return true if 'key' is found.
+
+		if( Iterator != ConfigurationMap.end() )
+			ReturnValue = true;
+		else
+			ReturnValue = false;
+
+	// Return ReturnValue.
+
+		return ReturnValue;
+}
+
+const std::string& Config::GetValue( const std::string_view Key )
+{
+	// Create local variables.
+
+		static const std::string Empty;
+		std::map< std::string, std::string, std::less<> >::iterator Iterator;
+
+	// Return a reference to the value denoted by 'Key' from the configuration map, or to an empty string. Lookups compare the
+	// key in place, so neither a key nor a value is copied.
+
+		Iterator = ConfigurationMap.find( Key );
+
+		return ( ( Iterator != ConfigurationMap.end() ) ? Iterator->second : Empty );
+}
+
+void Config::Merge( Config& Defaults )
+{
+	// Add the values of 'Defaults' whose keys are not set in this configuration, so a configuration read first overrides the one
+	// merged into it.
+
+		for( const auto& CfgPair : Defaults.GetConfigurationMap() )
+			ConfigurationMap.insert( CfgPair );
+}
+
+int Config::Size()
+{
+	// Return the size of the configuration map.
+
+		return ConfigurationMap.size();
+}
+
+const std::map< std::string, std::string, std::less<> >& Config::GetConfigurationMap()
+{
+	// Return the entire configuration map (for debugging).
+
+		return ConfigurationMap;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// End of 'Config.cpp'
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
\ No newline at end of file
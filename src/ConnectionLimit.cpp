@@ -0,0 +1,387 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// ConnectionLimit.cpp
+// Matthew J. Schultz | Created : 31OCT17 | Last Modified : 31OCT17 by Matthew J. Schultz
+// Version : 0.0.1
+// This is the source file for the 'ConnectionLimit' class of 'LSSHKeys', which limits the directory connections open at once on the host.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2017 QuantuMatriX Software, a QuantuMatriX Technologies Cooperative Partnership.
+//
+// This file is part of 'LSSHKeys'.
+//
+// 'LSSHKeys' is free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any later version.
+//
+// 'LSSHKeys' is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License along with 'LSSHKeys'.  If not, see <http://www.gnu.org/licenses/>.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Header Files
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "../include/LSSHKeys.hpp"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The 'ConnectionLimit' Class
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Constructor
+
+ConnectionLimit::ConnectionLimit()
+{
+	// Set field values.
+
+		Maximum = 0;
+		Wait = 10;
+		Held = false;
+		Self = { 0, 0 };
+		Table = nullptr;
+		Log = nullptr;
+}
+
+// Destructor
+
+ConnectionLimit::~ConnectionLimit()
+{
+	// Give the slot back and unmap the table.
+
+		Release();
+
+		if( Table != nullptr )
+			munmap( Table, sizeof( SharedTable ) );
+}
+
+// Public Methods
+
+void ConnectionLimit::Init( Config& Configuration, Output& Log )
+{
+	// Set field values.
+
+		this->Log = &Log;
+
+	// Read the number of lookups that may be connected to the directories at once on this host from the 'max_concurrent'
+	// configuration parameter, where 0 means no limit, and how many seconds a lookup waits for its turn from 'concurrent_wait'.
+
+		Log << DEBUG << "Checking if 'max_concurrent' parameter exists... ";
+
+		if( Configuration.Exists( "max_concurrent" ) )
+		{
+			Log << "Yes." << std::endl;
+			Log << DEBUG << "The value of 'max_concurrent' is: '" << Configuration.GetValue( "max_concurrent" ) << "'" << std::endl;
+
+			try
+			{
+				Maximum = std::min( std::stoul( Configuration.GetValue( "max_concurrent" ) ), ( unsigned long ) HolderCapacity );
+			}
+			catch( std::exception& Exception )
+			{
+				Log << WARNING << "Value of 'max_concurrent' parameter cannot be parsed. '" << Exception.what() << "' : "
+				               << Utility::ErrnoToString( EINVAL ) << ". Defaulting to 'max_concurrent' = '0'." << std::endl;
+
+				Maximum = 0;
+			}
+		}
+		else
+		{
+			Log << "No." << std::endl;
+			Log << DEBUG << "Defaulting to 'max_concurrent' = '0'." << std::endl;
+		}
+
+		if( Maximum == 0 )
+			return;
+
+		Log << DEBUG << "Checking if 'concurrent_wait' parameter exists... ";
+
+		if( Configuration.Exists( "concurrent_wait" ) )
+		{
+			Log << "Yes." << std::endl;
+			Log << DEBUG << "The value of 'concurrent_wait' is: '" << Configuration.GetValue( "concurrent_wait" ) << "'" << std::endl;
+
+			try
+			{
+				Wait = std::max( std::stoi( Configuration.GetValue( "concurrent_wait" ) ), 0 );
+			}
+			catch( std::exception& Exception )
+			{
+				Log << WARNING << "Value of 'concurrent_wait' parameter cannot be parsed. '" << Exception.what() << "' : "
+				               << Utility::ErrnoToString( EINVAL ) << ". Defaulting to 'concurrent_wait' = '10'." << std::endl;
+
+				Wait = 10;
+			}
+		}
+		else
+		{
+			Log << "No." << std::endl;
+			Log << DEBUG << "Defaulting to 'concurrent_wait' = '10'." << std::endl;
+		}
+}
+
+void ConnectionLimit::Init( const ConnectionLimit& Parent, Output& Log )
+{
+	// Limit another connection in the same way as 'Parent', logging through 'Log'. Each object takes its own slot.
+
+		this->Log = &Log;
+		Maximum = Parent.Maximum;
+		Wait = Parent.Wait;
+}
+
+void ConnectionLimit::Acquire()
+{
+	// Create local variables.
+
+		bool Turn = false;
+		long long Waited;
+		static std::atomic< uint32_t > Tokens( 0 );
+		struct timespec Until;
+		std::chrono::steady_clock::time_point Started = std::chrono::steady_clock::now();
+		std::chrono::steady_clock::time_point Deadline = Started + std::chrono::seconds( Wait );
+
+	// Nothing to do without a limit, or with a slot held already.
+
+		if( ( Maximum == 0 ) || Held )
+			return;
+
+		if( !Map() )
+			return;
+
+	// Identify this object's place and slot by the process and a token, so the objects of one process, such as those of its threads,
+	// are told apart.
+
+		Self = { getpid(), ++Tokens };
+
+	// Queue behind the lookups already waiting and take a slot once this lookup is first in line and one is free, so lookups are
+	// served in the order they arrived. Slots and places held by processes that have exited are reclaimed while waiting, since
+	// their owners cannot give them back. A lookup still waiting at the deadline leaves the queue and fails.
+
+		Lock();
+		Reap();
+
+		if( Table->Count == QueueCapacity )
+		{
+			Unlock();
+
+			*Log << WARNING << "Connection queue is full. Connecting without waiting." << std::endl;
+
+			return;
+		}
+
+		Table->Queue[ Table->Count++ ] = Self;
+
+		while( !( Turn = ( IsSelf( Table->Queue[ 0 ] ) && ( Holders() < Maximum ) ) ) )
+		{
+			if( std::chrono::steady_clock::now() >= Deadline )
+				break;
+
+			clock_gettime( CLOCK_MONOTONIC, &Until );
+
+			Until.tv_sec += 1;
+
+			if( pthread_cond_timedwait( &Table->Changed, &Table->Mutex, &Until ) == EOWNERDEAD )
+				pthread_mutex_consistent( &Table->Mutex );
+
+			Reap();
+		}
+
+		Dequeue( Self );
+
+		if( Turn )
+		{
+			for( Ticket& Holder : Table->Holders )
+			{
+				if( Holder.Process == 0 )
+				{
+					Holder = Self;
+
+					break;
+				}
+			}
+
+			Held = true;
+		}
+
+		pthread_cond_broadcast( &Table->Changed );
+		Unlock();
+
+	// Log how long the lookup waited, and fail it if it did not get a slot in time.
+
+		Waited = std::chrono::duration_cast< std::chrono::milliseconds >( std::chrono::steady_clock::now() - Started ).count();
+
+		if( !Turn )
+			throw std::runtime_error( "Timed out after " + std::to_string( Waited ) + " ms waiting for a directory connection" );
+
+		*Log << INFORMATION << "Waited " << std::to_string( Waited ) << " ms for a directory connection." << std::endl;
+}
+
+void ConnectionLimit::Release()
+{
+	// Give the slot back and wake the waiters.
+
+		if( !Held )
+			return;
+
+		Lock();
+
+		for( Ticket& Holder : Table->Holders )
+		{
+			if( IsSelf( Holder ) )
+			{
+				Holder = { 0, 0 };
+
+				break;
+			}
+		}
+
+		pthread_cond_broadcast( &Table->Changed );
+		Unlock();
+
+		Held = false;
+}
+
+// Private Methods
+
+bool ConnectionLimit::Map()
+{
+	// Create local variables.
+
+		int Descriptor;
+		struct stat Status;
+		pthread_mutexattr_t MutexAttributes;
+		pthread_condattr_t ConditionAttributes;
+		std::string Name = "/" BINARY "." + std::to_string( getuid() );
+
+	// Map the table shared by every lookup of this user on the host, creating it if needed. Each user has a table only they can open,
+	// since any user able to write a table shared by all could hold every slot. The first process to lock the new, empty object sizes
+	// it and initializes a robust mutex, so a process that exits while holding it cannot block the others, and a condition variable
+	// on the monotonic clock. A table that cannot be used leaves lookups unlimited.
+
+		if( Table != nullptr )
+			return true;
+
+		if( ( Descriptor = shm_open( Name.c_str(), ( O_RDWR | O_CREAT | O_CLOEXEC ), ( S_IRUSR | S_IWUSR ) ) ) == -1 )
+		{
+			*Log << WARNING << "Cannot open connection table: '" << Name << "' : " << Utility::ErrnoToString() << ". Connecting without "
+			                   "waiting." << std::endl;
+
+			return false;
+		}
+
+		flock( Descriptor, LOCK_EX );
+
+		if( ( fstat( Descriptor, &Status ) == 0 ) && ( ( Status.st_size == 0 ) || ( Status.st_size == sizeof( SharedTable ) ) ) &&
+		    ( ( Status.st_size != 0 ) || ( ftruncate( Descriptor, sizeof( SharedTable ) ) == 0 ) ) )
+		{
+			Table = static_cast< SharedTable* >( mmap( nullptr, sizeof( SharedTable ), ( PROT_READ | PROT_WRITE ), MAP_SHARED, Descriptor, 0 ) );
+
+			if( ( Table != MAP_FAILED ) && ( Status.st_size == 0 ) )
+			{
+				pthread_mutexattr_init( &MutexAttributes );
+				pthread_mutexattr_setpshared( &MutexAttributes, PTHREAD_PROCESS_SHARED );
+				pthread_mutexattr_setrobust( &MutexAttributes, PTHREAD_MUTEX_ROBUST );
+				pthread_mutex_init( &Table->Mutex, &MutexAttributes );
+				pthread_mutexattr_destroy( &MutexAttributes );
+
+				pthread_condattr_init( &ConditionAttributes );
+				pthread_condattr_setpshared( &ConditionAttributes, PTHREAD_PROCESS_SHARED );
+				pthread_condattr_setclock( &ConditionAttributes, CLOCK_MONOTONIC );
+				pthread_cond_init( &Table->Changed, &ConditionAttributes );
+				pthread_condattr_destroy( &ConditionAttributes );
+			}
+		}
+
+		flock( Descriptor, LOCK_UN );
+		close( Descriptor );
+
+		if( ( Table == nullptr ) || ( Table == MAP_FAILED ) )
+		{
+			Table = nullptr;
+
+			*Log << WARNING << "Cannot map connection table: '" << Name << "'. Connecting without waiting." << std::endl;
+
+			return false;
+		}
+
+	// Return true.
+
+		return true;
+}
+
+void ConnectionLimit::Lock()
+{
+	// Lock the table. If its last owner exited while holding it, the table is still consistent, since every change to it is
+	// complete before the next one starts; only the owner's slot or place may be left behind, which Reap() reclaims.
+
+		if( pthread_mutex_lock( &Table->Mutex ) == EOWNERDEAD )
+			pthread_mutex_consistent( &Table->Mutex );
+}
+
+void ConnectionLimit::Unlock()
+{
+	// Unlock the table.
+
+		pthread_mutex_unlock( &Table->Mutex );
+}
+
+void ConnectionLimit::Reap()
+{
+	// Create local variables.
+
+		size_t Index = 0;
+
+	// Free the slots and queue places of processes that no longer exist.
+
+		for( Ticket& Holder : Table->Holders )
+		{
+			if( ( Holder.Process != 0 ) && ( kill( Holder.Process, 0 ) == -1 ) && ( errno == ESRCH ) )
+				Holder = { 0, 0 };
+		}
+
+		while( Index < Table->Count )
+		{
+			if( ( kill( Table->Queue[ Index ].Process, 0 ) == -1 ) && ( errno == ESRCH ) )
+				Dequeue( Table->Queue[ Index ] );
+			else
+				Index++;
+		}
+}
+
+void ConnectionLimit::Dequeue( const Ticket& Waiter )
+{
+	// Create local variables.
+
+		size_t Index;
+
+	// Remove the waiter from the queue, closing the gap it leaves.
+
+		for( Index = 0; Index < Table->Count; Index++ )
+		{
+			if( ( Table->Queue[ Index ].Process == Waiter.Process ) && ( Table->Queue[ Index ].Token == Waiter.Token ) )
+				break;
+		}
+
+		if( Index == Table->Count )
+			return;
+
+		std::copy( Table->Queue + Index + 1, Table->Queue + Table->Count, Table->Queue + Index );
+
+		Table->Count--;
+}
+
+size_t ConnectionLimit::Holders()
+{
+	// Return the number of slots in use.
+
+		return std::count_if( std::begin( Table->Holders ), std::end( Table->Holders ), []( const Ticket& Holder ) { return ( Holder.Process != 0 ); } );
+}
+
+bool ConnectionLimit::IsSelf( const Ticket& Other )
+{
+	// Return true if 'Other' is this object's place or slot.
+
+		return ( ( Other.Process == Self.Process ) && ( Other.Token == Self.Token ) );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// End of 'ConnectionLimit.cpp'
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
\ No newline at end of file
@@ -0,0 +1,204 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// DirectoryScan.cpp
+// Matthew J. Schultz | Created : 31OCT17 | Last Modified : 31OCT17 by Matthew J. Schultz
+// Version : 0.0.1
+// This is the source file for the 'DirectoryScan' class of 'LSSHKeys', which streams a paged search of every user.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2017 QuantuMatriX Software, a QuantuMatriX Technologies Cooperative Partnership.
+//
+// This file is part of 'LSSHKeys'.
+//
+// 'LSSHKeys' is free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any later version.
+//
+// 'LSSHKeys' is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License along with 'LSSHKeys'.  If not, see <http://www.gnu.org/licenses/>.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Header Files
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "../include/LSSHKeys.hpp"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The 'DirectoryScan' Class
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Constructor
+
+DirectoryScan::DirectoryScan( LDAP* Interface, const std::string& Base, const int Scope, const std::string& Filter, const std::string& NameAttribute,
+                              const std::string& AttributeName, AccountPolicy& Account, ValueFilter& ValueRules,
+                              const int PageSize )
+{
+	// Set field values.
+
+		this->Interface = Interface;
+		this->Base = Base;
+		this->Scope = Scope;
+		this->Filter = Filter;
+		this->NameAttribute = NameAttribute;
+		this->AttributeName = AttributeName;
+		this->Account = &Account;
+		this->ValueRules = &ValueRules;
+		this->PageSize = PageSize;
+}
+
+// Public Methods
+
+int DirectoryScan::Run( Sink Consume )
+{
+	// Create local variables.
+
+		int ErrorCode = LDAP_SUCCESS;
+		int MessageID;
+		int ResultType;
+		std::vector< char* > AttributeList = { const_cast< char* >( NameAttribute.c_str() ), const_cast< char* >( AttributeName.c_str() ) };
+		struct berval Cookie = { 0, nullptr };
+		LDAPControl* PageControl = nullptr;
+		LDAPControl* ServerControls[] = { nullptr, nullptr, nullptr };
+		LDAPControl** ResponseControls = nullptr;
+		LDAPControl* ResponseControl;
+		LDAPMessage* Message;
+		std::optional< Entry > Current;
+
+	// Request the attributes the account checks read along with the names and keys.
+
+		for( std::string& Attribute : Account->GetAttributes() )
+			AttributeList.push_back( const_cast< char* >( Attribute.c_str() ) );
+
+		AttributeList.push_back( nullptr );
+
+	// Read the matching entries a page at a time with the paged results control. Within a page, each message is read, handed to
+	// 'Consume' and freed as it arrives, so memory stays flat however large the directory is. The control is not critical; a
+	// server that ignores it returns everything in one page.
+
+		do
+		{
+			if( ( ErrorCode = ldap_create_page_control( Interface, PageSize, &Cookie, 0, &PageControl ) ) != LDAP_SUCCESS )
+				break;
+
+			ServerControls[ 0 ] = PageControl;
+			ServerControls[ 1 ] = ( ( ValueRules->GetControls() != nullptr ) ? ValueRules->GetControls()[ 0 ] : nullptr );
+			ErrorCode = ldap_search_ext( Interface, Base.c_str(), Scope, Filter.c_str(), AttributeList.data(), 0, ServerControls, nullptr,
+			                             nullptr, LDAP_NO_LIMIT, &MessageID );
+			ldap_control_free( PageControl );
+
+			if( Cookie.bv_val != nullptr )
+			{
+				ber_memfree( Cookie.bv_val );
+				Cookie = { 0, nullptr };
+			}
+
+			if( ErrorCode != LDAP_SUCCESS )
+				break;
+
+			for( bool Done = false; !Done; )
+			{
+				if( ( ResultType = ldap_result( Interface, MessageID, LDAP_MSG_ONE, nullptr, &Message ) ) <= 0 )
+				{
+					if( ResultType == 0 )
+						ErrorCode = LDAP_TIMEOUT;
+					else
+						ldap_get_option( Interface, LDAP_OPT_RESULT_CODE, &ErrorCode );
+
+					ldap_abandon_ext( Interface, MessageID, nullptr, nullptr );
+
+					throw std::runtime_error( std::string( "ldap_result(): " ) + ldap_err2string( ErrorCode ) );
+				}
+
+				if( ldap_msgtype( Message ) == LDAP_RES_SEARCH_ENTRY )
+				{
+					Current.emplace( &Memory );
+					Decode( Message, *Current );
+					Consume( *Current );
+					Current.reset();
+					Memory.Release();
+				}
+				else if( ldap_msgtype( Message ) == LDAP_RES_SEARCH_RESULT )
+				{
+					ldap_parse_result( Interface, Message, &ErrorCode, nullptr, nullptr, nullptr, &ResponseControls, 0 );
+
+					if( ( ResponseControl = ldap_control_find( LDAP_CONTROL_PAGEDRESULTS, ResponseControls, nullptr ) ) != nullptr )
+						ldap_parse_pageresponse_control( Interface, ResponseControl, nullptr, &Cookie );
+
+					ldap_controls_free( ResponseControls );
+					ResponseControls = nullptr;
+					Done = true;
+				}
+
+				ldap_msgfree( Message );
+			}
+		}
+		while( ( ErrorCode == LDAP_SUCCESS ) && ( Cookie.bv_len > 0 ) );
+
+		if( Cookie.bv_val != nullptr )
+			ber_memfree( Cookie.bv_val );
+
+	// Return the result code of the last page.
+
+		return ErrorCode;
+}
+
+size_t DirectoryScan::GetAllocations()
+{
+	// Return the number of allocations made for entries.
+
+		return Memory.GetAllocations();
+}
+
+size_t DirectoryScan::GetHeapAllocations()
+{
+	// Return the number of allocations for entries that needed memory from the heap.
+
+		return Memory.GetHeapAllocations();
+}
+
+// Private Methods
+
+void DirectoryScan::Decode( LDAPMessage* Message, Entry& Current )
+{
+	// Create local variables.
+
+		unsigned Findings = 0;
+		struct berval DN = { 0, nullptr };
+
+	// Copy out the DN, the values of the name attribute and the values of the key attribute in a single pass over the entry, into
+	// the arena. Only the keys the value filter selects are kept, and none when the account checks deny the entry.
+
+		Utility::DecodeEntry( Interface, Message, DN, [ & ]( const struct berval& Name, BerVarray Values )
+		                      {
+		                          std::pmr::vector< std::pmr::string >* Target = nullptr;
+
+		                          if( Utility::IsAttribute( Name, NameAttribute ) )
+		                              Target = &Current.Names;
+		                          else if( Utility::IsAttribute( Name, AttributeName ) )
+		                              Target = &Current.Values;
+
+		                          if( ( Target != nullptr ) && ( Values != nullptr ) )
+		                          {
+		                              for( ; Values->bv_val != nullptr; Values++ )
+		                              {
+		                                  std::string_view Value( Values->bv_val, Values->bv_len );
+
+		                                  if( ( Target == &Current.Names ) || ValueRules->Select( Value ) )
+		                                      Target->emplace_back( Value.data(), Value.length() );
+		                              }
+		                          }
+		                          else if( Target == nullptr )
+		                          {
+		                              Findings |= Account->Inspect( Name, Values );
+		                          }
+		                      } );
+
+		Current.DN.assign( DN.bv_val, DN.bv_len );
+
+		if( ( Current.Denied = Account->Deny( Findings ) ) != nullptr )
+			Current.Values.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// End of 'DirectoryScan.cpp'
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
\ No newline at end of file
@@ -0,0 +1,252 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// ExportWriter.cpp
+// Matthew J. Schultz | Created : 31OCT17 | Last Modified : 31OCT17 by Matthew J. Schultz
+// Version : 0.0.1
+// This is the source file for the 'ExportWriter' class of 'LSSHKeys', which writes exported authorized_keys files.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2017 QuantuMatriX Software, a QuantuMatriX Technologies Cooperative Partnership.
+//
+// This file is part of 'LSSHKeys'.
+//
+// 'LSSHKeys' is free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any later version.
+//
+// 'LSSHKeys' is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License along with 'LSSHKeys'.  If not, see <http://www.gnu.org/licenses/>.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Header Files
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "../include/LSSHKeys.hpp"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The 'ExportWriter' Class
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Constructor
+
+ExportWriter::ExportWriter( const std::string& Directory, const size_t ThreadCount )
+{
+	// Set field values.
+
+		this->Directory = Directory;
+		Stopping = false;
+		Written = 0;
+		Unchanged = 0;
+		Failed = 0;
+
+	// Load the hashes of the files written by the previous export, then start the workers.
+
+		LoadManifest();
+
+		for( size_t Index = 0; Index < std::max< size_t >( ThreadCount, 1 ); Index++ )
+			Workers.emplace_back( &ExportWriter::Work, this );
+}
+
+// Destructor
+
+ExportWriter::~ExportWriter()
+{
+	// Perform necessary cleanup.
+
+		Finish();
+}
+
+// Public Methods
+
+void ExportWriter::Submit( const std::string& Username, std::string&& Contents )
+{
+	// Queue a file for the workers, waiting while the queue is full so memory stays bounded when the directory is faster than the
+	// disk.
+
+		std::unique_lock< std::mutex > Lock( Mutex );
+
+		Space.wait( Lock, [ this ]() { return ( Jobs.size() < QueueLimit ); } );
+		Jobs.emplace( Username, std::move( Contents ) );
+		Available.notify_one();
+}
+
+void ExportWriter::Finish()
+{
+	// Let the workers drain the queue, then wait for them.
+
+		{
+			std::lock_guard< std::mutex > Lock( Mutex );
+
+			Stopping = true;
+		}
+
+		Available.notify_all();
+
+		for( std::thread& Worker : Workers )
+			Worker.join();
+
+		Workers.clear();
+}
+
+size_t ExportWriter::Prune( const std::set< std::string >& Keep, const std::function< bool( const std::string& ) >& IsGone )
+{
+	// Create local variables.
+
+		size_t ReturnValue = 0;
+		DIR* Handle;
+		struct dirent* Item;
+		std::set< std::string > Kept( Keep );
+
+	// Remove every file named like a user that is not in 'Keep' and that 'IsGone' confirms, then save the hashes of the remaining
+	// files. Call this only after Finish() and only after a complete scan.
+
+		if( ( Handle = opendir( Directory.c_str() ) ) != nullptr )
+		{
+			while( ( Item = readdir( Handle ) ) != nullptr )
+			{
+				if( Utility::IsValidUsername( Item->d_name ) && ( Keep.find( Item->d_name ) == Keep.end() ) )
+				{
+					if( !IsGone( Item->d_name ) )
+						Kept.insert( Item->d_name );
+					else if( unlinkat( dirfd( Handle ), Item->d_name, 0 ) == 0 )
+						ReturnValue++;
+				}
+			}
+
+			closedir( Handle );
+		}
+
+		for( std::map< std::string, uint64_t >::iterator Position = Current.begin(); Position != Current.end(); )
+		{
+			if( Kept.find( Position->first ) == Kept.end() )
+				Position = Current.erase( Position );
+			else
+				++Position;
+		}
+
+		SaveManifest();
+
+	// Return ReturnValue.
+
+		return ReturnValue;
+}
+
+size_t ExportWriter::GetWritten()
+{
+	// Return the number of files written.
+
+		return Written;
+}
+
+size_t ExportWriter::GetUnchanged()
+{
+	// Return the number of files skipped because they were unchanged.
+
+		return Unchanged;
+}
+
+size_t ExportWriter::GetFailed()
+{
+	// Return the number of files that could not be written.
+
+		return Failed;
+}
+
+// Private Methods
+
+void ExportWriter::Work()
+{
+	// Create local variables.
+
+		uint64_t Hash;
+		struct stat Status;
+		std::pair< std::string, std::string > Job;
+		std::map< std::string, uint64_t >::const_iterator Entry;
+
+	// Write queued files until the queue is drained after Finish(). A file is skipped when its hash matches the previous export
+	// and the file on disk still has the expected size.
+
+		while( true )
+		{
+			{
+				std::unique_lock< std::mutex > Lock( Mutex );
+
+				Available.wait( Lock, [ this ]() { return ( Stopping || ( !Jobs.empty() ) ); } );
+
+				if( Jobs.empty() )
+					return;
+
+				Job = std::move( Jobs.front() );
+				Jobs.pop();
+				Space.notify_one();
+			}
+
+			Hash = Utility::Hash( Job.second );
+			Entry = Previous.find( Job.first );
+
+			if( ( Entry != Previous.end() ) &&
+			    ( Entry->second == Hash ) &&
+			    ( stat( ( Directory + "/" + Job.first ).c_str(), &Status ) == 0 ) &&
+			    ( ( size_t ) Status.st_size == Job.second.size() ) )
+			{
+				Unchanged++;
+			}
+			else
+			{
+				try
+				{
+					Utility::WriteFileAtomically( Directory, Job.first, Job.second, ( S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH ) );
+					Written++;
+				}
+				catch( std::ios_base::failure& Exception )
+				{
+					Failed++;
+
+					continue;
+				}
+			}
+
+			std::lock_guard< std::mutex > Lock( Mutex );
+
+			Current[ Job.first ] = Hash;
+		}
+}
+
+void ExportWriter::LoadManifest()
+{
+	// Create local variables.
+
+		uint64_t Hash;
+		std::string Name;
+		std::ifstream Manifest( Directory + "/.manifest" );
+
+	// Read the 'username hash' lines written by SaveManifest(). A missing manifest only means every file is rewritten once.
+
+		while( Manifest >> Name >> std::hex >> Hash )
+			Previous[ Name ] = Hash;
+}
+
+void ExportWriter::SaveManifest()
+{
+	// Create local variables.
+
+		std::ostringstream Contents;
+
+	// Record the hash of every exported file.
+
+		for( const std::pair< const std::string, uint64_t >& Entry : Current )
+			Contents << Entry.first << ' ' << std::hex << Entry.second << std::dec << '\n';
+
+		try
+		{
+			Utility::WriteFileAtomically( Directory, ".manifest", Contents.str(), ( S_IRUSR | S_IWUSR ) );
+		}
+		catch( std::ios_base::failure& Exception )
+		{
+			Failed++;
+		}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// End of 'ExportWriter.cpp'
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
\ No newline at end of file
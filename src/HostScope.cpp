@@ -0,0 +1,309 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// HostScope.cpp
+// Matthew J. Schultz | Created : 31OCT17 | Last Modified : 31OCT17 by Matthew J. Schultz
+// Version : 0.0.1
+// This is the source file for the 'HostScope' class of 'LSSHKeys', which resolves the local host's names and groups for scoped keys.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2017 QuantuMatriX Software, a QuantuMatriX Technologies Cooperative Partnership.
+//
+// This file is part of 'LSSHKeys'.
+//
+// 'LSSHKeys' is free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any later version.
+//
+// 'LSSHKeys' is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License along with 'LSSHKeys'.  If not, see <http://www.gnu.org/licenses/>.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Header Files
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "../include/LSSHKeys.hpp"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The 'HostScope' Class
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Constructor
+
+HostScope::HostScope()
+{
+	// Set field values.
+
+		Resolved = false;
+		KeyCache = nullptr;
+		Log = nullptr;
+}
+
+// Public Methods
+
+void HostScope::Init( Config& Configuration, Cache& KeyCache, Output& Log )
+{
+	// Create local variables.
+
+		std::string Entry;
+
+	// Set field values.
+
+		this->KeyCache = &KeyCache;
+		this->Log = &Log;
+
+	// Read the local host's groups from the 'host_groups' configuration parameter, separated by '|', and the fully qualified name
+	// from 'host_fqdn', which is otherwise resolved when first needed.
+
+		Log << DEBUG << "Checking if 'host_groups' parameter exists... ";
+
+		if( Configuration.Exists( "host_groups" ) )
+		{
+			Log << "Yes." << std::endl;
+			Log << DEBUG << "The value of 'host_groups' is: '" << Configuration.GetValue( "host_groups" ) << "'" << std::endl;
+
+			std::istringstream GroupStream( Configuration.GetValue( "host_groups" ) );
+
+			while( std::getline( GroupStream, Entry, '|' ) )
+			{
+				if( !Entry.empty() )
+					Groups.push_back( Entry );
+			}
+		}
+		else
+		{
+			Log << "No." << std::endl;
+		}
+
+		Log << DEBUG << "Checking if 'host_fqdn' parameter exists... ";
+
+		if( Configuration.Exists( "host_fqdn" ) && ( !Configuration.GetValue( "host_fqdn" ).empty() ) )
+		{
+			Log << "Yes." << std::endl;
+			Log << DEBUG << "The value of 'host_fqdn' is: '" << Configuration.GetValue( "host_fqdn" ) << "'" << std::endl;
+
+			FQDN = Configuration.GetValue( "host_fqdn" );
+		}
+		else
+		{
+			Log << "No." << std::endl;
+		}
+
+	// Read the scopes of the key values valid on this host from the 'value_scope' configuration parameter, separated by '|'.
+
+		Log << DEBUG << "Checking if 'value_scope' parameter exists... ";
+
+		if( Configuration.Exists( "value_scope" ) )
+		{
+			Log << "Yes." << std::endl;
+			Log << DEBUG << "The value of 'value_scope' is: '" << Configuration.GetValue( "value_scope" ) << "'" << std::endl;
+
+			std::istringstream ScopeStream( Configuration.GetValue( "value_scope" ) );
+
+			while( std::getline( ScopeStream, Entry, '|' ) )
+			{
+				if( Entry.empty() )
+					continue;
+
+				for( std::string& Scope : Expand( Entry ) )
+				{
+					if( std::find( Scopes.begin(), Scopes.end(), Scope ) == Scopes.end() )
+						Scopes.push_back( Scope );
+				}
+			}
+
+			if( Scopes.empty() )
+				throw std::invalid_argument( "Value of 'value_scope' parameter invalid. No scope applies to this host" );
+		}
+		else
+		{
+			Log << "No." << std::endl;
+		}
+}
+
+std::vector< std::string > HostScope::Expand( const std::string& Pattern )
+{
+	// Create local variables.
+
+		std::string Current = Pattern;
+		std::vector< std::string > ReturnValue;
+
+	// Replace '%h' with the host name, '%f' with the fully qualified name and '%d' with the domain. A pattern with '%g' expands to one
+	// value for each host group, and to none when the host has no groups.
+
+		Replace( Current, false );
+
+		if( Current.find( "%g" ) == std::string::npos )
+		{
+			ReturnValue.push_back( Current );
+		}
+		else
+		{
+			for( const std::string& Group : Groups )
+				ReturnValue.push_back( std::regex_replace( Current, std::regex( "%g" ), Group ) );
+		}
+
+	// Return ReturnValue.
+
+		return ReturnValue;
+}
+
+std::string HostScope::ExpandFilter( const std::string& Filter )
+{
+	// Create local variables.
+
+		size_t Position;
+		size_t Open;
+		size_t Close;
+		std::string Item;
+		std::string Alternatives;
+		std::string ReturnValue = Filter;
+
+	// Substitute the host tokens into the filter, escaped. The innermost item containing '%g' becomes an OR of that item for each host
+	// group, or an item that never matches when the host has no groups. '%1' is left for the username.
+
+		Replace( ReturnValue, true );
+
+		if( ( ReturnValue.find( "%g" ) != std::string::npos ) && ( ReturnValue[ 0 ] != '(' ) )
+			ReturnValue = "(" + ReturnValue + ")";
+
+		while( ( Position = ReturnValue.find( "%g" ) ) != std::string::npos )
+		{
+			Open = ReturnValue.rfind( '(', Position );
+			Close = ReturnValue.find( ')', Position );
+
+			if( ( Open == std::string::npos ) || ( Close == std::string::npos ) )
+				throw std::invalid_argument( "Value of 'filter' parameter invalid. '%g' must be inside an item" );
+
+			Item = ReturnValue.substr( Open, ( Close - Open ) + 1 );
+			Alternatives.clear();
+
+			for( const std::string& Group : Groups )
+				Alternatives += std::regex_replace( Item, std::regex( "%g" ), Utility::EscapeFilterValue( Group ) );
+
+			ReturnValue.replace( Open, ( Close - Open ) + 1, Groups.empty() ? "(!(objectClass=*))" : ( "(|" + Alternatives + ")" ) );
+		}
+
+	// Return ReturnValue.
+
+		return ReturnValue;
+}
+
+std::vector< std::string >& HostScope::GetScopes()
+{
+	// Return the scopes of the key values valid on this host.
+
+		return Scopes;
+}
+
+// Private Methods
+
+void HostScope::Resolve()
+{
+	// Create local variables.
+
+		char Buffer[ HOST_NAME_MAX + 1 ] = { 0 };
+		struct addrinfo Hints;
+		struct addrinfo* Addresses = nullptr;
+
+	// Resolve the host's names once. The host name is the part of the system's name before the first '.'. Unless it is configured,
+	// the fully qualified name is its canonical name in DNS, kept in the cache for an hour so that logins do not each query DNS.
+
+		if( Resolved )
+			return;
+
+		Resolved = true;
+
+		if( gethostname( Buffer, HOST_NAME_MAX ) != 0 )
+			throw std::runtime_error( "Cannot read host name : " + Utility::ErrnoToString() );
+
+		Name = Buffer;
+
+		if( FQDN.empty() && ( ( !KeyCache->IsActive() ) || ( !KeyCache->LoadHost( FQDN, 3600 ) ) ) )
+		{
+			memset( &Hints, 0, sizeof( Hints ) );
+			Hints.ai_family = AF_UNSPEC;
+			Hints.ai_flags = AI_CANONNAME;
+
+			if( ( getaddrinfo( Name.c_str(), nullptr, &Hints, &Addresses ) == 0 ) && ( Addresses->ai_canonname != nullptr ) )
+				FQDN = Addresses->ai_canonname;
+			else
+				*Log << WARNING << "Cannot resolve the fully qualified name of: '" << Name << "'. Using the host name." << std::endl;
+
+			if( Addresses != nullptr )
+				freeaddrinfo( Addresses );
+
+			if( FQDN.empty() )
+				FQDN = Name;
+
+			if( KeyCache->IsActive() )
+			{
+				try
+				{
+					KeyCache->StoreHost( FQDN );
+				}
+				catch( std::ios_base::failure& Exception )
+				{
+					*Log << WARNING << "Cannot store host name in cache. '" << Exception.what() << "' : " << Utility::ErrnoToString()
+					                << ". Attempting to continue." << std::endl;
+				}
+			}
+		}
+
+		Name = Name.substr( 0, Name.find( '.' ) );
+		Domain = ( FQDN.find( '.' ) != std::string::npos ) ? FQDN.substr( FQDN.find( '.' ) + 1 ) : "";
+
+		*Log << DEBUG << "The host name is: '" << Name << "', the fully qualified name is: '" << FQDN << "'" << std::endl;
+}
+
+void HostScope::Replace( std::string& Pattern, const bool Escape )
+{
+	// Create local variables.
+
+		size_t Position = 0;
+		std::string Value;
+
+	// Replace each '%h', '%f' and '%d' token, resolving the host's names first if there is one.
+
+		while( ( Position = Pattern.find( '%', Position ) ) != std::string::npos )
+		{
+			if( ( Position + 1 ) >= Pattern.length() )
+				break;
+
+			switch( Pattern[ Position + 1 ] )
+			{
+				case 'h':
+				{
+					Resolve();
+					Value = Name;
+					break;
+				}
+				case 'f':
+				{
+					Resolve();
+					Value = FQDN;
+					break;
+				}
+				case 'd':
+				{
+					Resolve();
+					Value = Domain;
+					break;
+				}
+				default:
+				{
+					Position += 2;
+					continue;
+				}
+			}
+
+			if( Escape )
+				Value = Utility::EscapeFilterValue( Value );
+
+			Pattern.replace( Position, 2, Value );
+			Position += Value.length();
+		}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// End of 'HostScope.cpp'
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
\ No newline at end of file
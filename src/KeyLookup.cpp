@@ -0,0 +1,3177 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// KeyLookup.cpp
+// Matthew J. Schultz | Created : 16OCT17 | Last Modified : 31OCT17 by Matthew J. Schultz
+// Version : 0.0.1
+// This is the source file for the 'KeyLookup' class of 'LSSHKeys', which looks up users' keys over one connection for many lookups.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2017 QuantuMatriX Software, a QuantuMatriX Technologies Cooperative Partnership.
+//
+// This file is part of 'LSSHKeys'.
+//
+// 'LSSHKeys' is free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any later version.
+//
+// 'LSSHKeys' is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License along with 'LSSHKeys'.  If not, see <http://www.gnu.org/licenses/>.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Header Files
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "../include/LSSHKeys.hpp"
+
+using namespace std;
+using namespace Utility;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The 'KeyLookup' Class
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Constructor
+
+KeyLookup::KeyLookup( const Config& Configuration, Output& Log, const string& Profile ) : Cfg( Configuration ), Account( Cfg, Log ), Log( Log )
+{
+	// Create local variables.
+
+		string StringValue;
+		string Namespace = Profile.empty() ? "" : ".profile." + to_string( Hash( Profile ) );
+
+	// Set field values.
+
+		CSNValidation = false;
+		StartTLS = false;
+		InstallTLS = false;
+		Bound = false;
+		CSNLifetime = 5;
+		Scope = LDAP_SCOPE_ONELEVEL;
+		CacheSize = 0;
+		CacheLifetime = 0;
+		PipelineDepth = 32;
+		MemberChunkSize = 100;
+		MemberAttribute = "member";
+		MemberDNAttribute = "entryDN";
+		Interface = nullptr;
+
+	// Read how many seconds cache records are used for from the 'cache_ttl' configuration parameter, or use them for as long as they
+	// are valid.
+
+		Log << DEBUG << "Checking if 'cache_ttl' parameter exists... ";
+
+		if( Cfg.Exists( "cache_ttl" ) )
+		{
+			Log << "Yes." << endl;
+			Log << DEBUG << "The value of 'cache_ttl' is: '" << Cfg.GetValue( "cache_ttl" ) << "'" << endl;
+
+			try
+			{
+				CacheLifetime = stoul( Cfg.GetValue( "cache_ttl" ) );
+			}
+			catch( exception& Exception )
+			{
+				Log << WARNING << "Value of 'cache_ttl' parameter cannot be parsed. '" << Exception.what() << "' : "
+				               << ErrnoToString( EINVAL ) << ". Defaulting to no limit." << endl;
+
+				CacheLifetime = 0;
+			}
+		}
+		else
+		{
+			Log << "No." << endl;
+		}
+
+	// Initialize the cache in the kernel keyring named by the 'cache_keyring' configuration parameter (default 'lsshkeys') if the
+	// 'cache_backend' configuration parameter is set to 'keyring', for hosts where no cache directory can be written, or else in the
+	// directory the 'cache_dir' configuration parameter names, if it is set. A route profile keeps its records and the CSN they were
+	// fetched under apart from those of the main configuration and the other profiles, in a keyring or a subdirectory of its own
+	// named after the profile. The cache is an optimization only, so any failure here is logged and the lookup continues uncached.
+
+		Log << DEBUG << "Checking if 'cache_backend' parameter exists... ";
+
+		if( Cfg.Exists( "cache_backend" ) )
+		{
+			Log << "Yes." << endl;
+			Log << DEBUG << "The value of 'cache_backend' is: '" << Cfg.GetValue( "cache_backend" ) << "'" << endl;
+
+			StringValue = Cfg.GetValue( "cache_backend" );
+			transform( StringValue.begin(), StringValue.end(), StringValue.begin(), ::tolower );
+
+			if( ( StringValue != "keyring" ) && ( StringValue != "file" ) )
+			{
+				Log << WARNING << "Value of 'cache_backend' parameter invalid. Defaulting to 'cache_backend' = 'file'." << endl;
+
+				StringValue = "file";
+			}
+		}
+		else
+		{
+			Log << "No." << endl;
+			Log << DEBUG << "Defaulting to 'cache_backend' = 'file'." << endl;
+
+			StringValue = "file";
+		}
+
+		if( StringValue == "keyring" )
+		{
+			StringValue = ( Cfg.Exists( "cache_keyring" ) && ( !Cfg.GetValue( "cache_keyring" ).empty() ) ) ? Cfg.GetValue( "cache_keyring" )
+			                                                                                               : "lsshkeys";
+
+			StringValue += Namespace;
+
+			Log << DEBUG << "The cache keyring is: '" << StringValue << "'" << endl;
+
+			try
+			{
+				KeyCache.InitKeyring( StringValue, CacheLifetime );
+
+				Log << INFORMATION << "Cache initialized successfully." << endl;
+			}
+			catch( ios_base::failure& Exception )
+			{
+				Log << WARNING << "Cannot use cache keyring. '" << Exception.what() << "' : " << ErrnoToString() << ". "
+				                  "Attempting to continue." << endl;
+			}
+		}
+		else
+		{
+			Log << DEBUG << "Checking if 'cache_dir' parameter exists... ";
+
+			if( Cfg.Exists( "cache_dir" ) && ( !Cfg.GetValue( "cache_dir" ).empty() ) )
+			{
+				Log << "Yes." << endl;
+				Log << DEBUG << "The value of 'cache_dir' is: '" << Cfg.GetValue( "cache_dir" ) << "'" << endl;
+
+				try
+				{
+					KeyCache.Init( Cfg.GetValue( "cache_dir" ), CacheLifetime );
+
+					if( !Namespace.empty() )
+						KeyCache.Init( Cfg.GetValue( "cache_dir" ) + "/" + Namespace, CacheLifetime );
+
+					Log << DEBUG << "The cache directory is: '" << KeyCache.GetDirectory() << "'" << endl;
+
+					Log << INFORMATION << "Cache initialized successfully." << endl;
+				}
+				catch( ios_base::failure& Exception )
+				{
+					Log << WARNING << "Cannot use cache directory. '" << Exception.what() << "' : " << ErrnoToString() << ". "
+					                  "Attempting to continue." << endl;
+				}
+			}
+			else
+			{
+				Log << "No." << endl;
+			}
+		}
+
+	// Enable CSN-based validation of cached keys if the 'cache_validation' configuration parameter is set to 'csn'.
+
+		Log << DEBUG << "Checking if 'cache_validation' parameter exists... ";
+
+		if( Cfg.Exists( "cache_validation" ) )
+		{
+			Log << "Yes." << endl;
+			Log << DEBUG << "The value of 'cache_validation' is: '" << Cfg.GetValue( "cache_validation" ) << "'" << endl;
+
+			StringValue = Cfg.GetValue( "cache_validation" );
+			transform( StringValue.begin(), StringValue.end(), StringValue.begin(), ::tolower );
+
+			if( StringValue == "csn" )
+			{
+				CSNValidation = KeyCache.IsActive();
+			}
+			else if( StringValue != "none" )
+			{
+				Log << WARNING << "Value of 'cache_validation' parameter invalid. Defaulting to 'cache_validation' = 'none'."
+				               << endl;
+			}
+		}
+		else
+		{
+			Log << "No." << endl;
+		}
+
+	// Set how long a CSN read from the server is trusted from the 'cache_csn_ttl' configuration parameter or default to 5
+	// seconds.
+
+		if( CSNValidation )
+		{
+			Log << DEBUG << "Checking if 'cache_csn_ttl' parameter exists... ";
+
+			if( Cfg.Exists( "cache_csn_ttl" ) )
+			{
+				Log << "Yes." << endl;
+				Log << DEBUG << "The value of 'cache_csn_ttl' is: '" << Cfg.GetValue( "cache_csn_ttl" ) << "'" << endl;
+
+				try
+				{
+					CSNLifetime = stoi( Cfg.GetValue( "cache_csn_ttl" ) );
+				}
+				catch( exception& Exception )
+				{
+					Log << WARNING << "Value of 'cache_csn_ttl' parameter cannot be parsed. '" << Exception.what() << "' : "
+					               << ErrnoToString( EINVAL ) << ". Defaulting to 5 seconds." << endl;
+
+					CSNLifetime = 5;
+				}
+			}
+			else
+			{
+				Log << "No." << endl;
+				Log << DEBUG << "Defaulting to 'cache_csn_ttl' = '5'." << endl;
+			}
+		}
+
+	// Bound the number of cached users with the 'cache_size' configuration parameter. Admission and eviction follow the W-TinyLFU
+	// policy, so users who log in often stay cached when a burst of rarely seen usernames arrives. Without it the cache is
+	// unbounded. The policy keeps its state in the cache directory, so a keyring is bounded by the kernel's key quotas instead.
+
+		if( KeyCache.IsActive() && ( !KeyCache.IsKeyring() ) )
+		{
+			Log << DEBUG << "Checking if 'cache_size' parameter exists... ";
+
+			if( Cfg.Exists( "cache_size" ) )
+			{
+				Log << "Yes." << endl;
+				Log << DEBUG << "The value of 'cache_size' is: '" << Cfg.GetValue( "cache_size" ) << "'" << endl;
+
+				try
+				{
+					CacheSize = stoul( Cfg.GetValue( "cache_size" ) );
+				}
+				catch( exception& Exception )
+				{
+					Log << WARNING << "Value of 'cache_size' parameter cannot be parsed. '" << Exception.what() << "' : "
+					               << ErrnoToString( EINVAL ) << ". Defaulting to an unbounded cache." << endl;
+
+					CacheSize = 0;
+				}
+			}
+			else
+			{
+				Log << "No." << endl;
+			}
+		}
+
+	// Use SASL EXTERNAL to bind if the 'sasl_mech' configuration parameter is set to 'EXTERNAL'. The server then authenticates the
+	// client from the connection itself, by the peer credentials of an 'ldapi://' socket or a TLS client certificate, so no password
+	// is exchanged or stored. The mechanism's credentials are the authorization identity, from the optional 'sasl_authzid'
+	// configuration parameter, and are kept in place of the bind password.
+
+		Log << DEBUG << "Checking if 'sasl_mech' parameter exists... ";
+
+		if( Cfg.Exists( "sasl_mech" ) )
+		{
+			Log << "Yes." << endl;
+			Log << DEBUG << "The value of 'sasl_mech' is: '" << Cfg.GetValue( "sasl_mech" ) << "'" << endl;
+
+			BindMechanism = Cfg.GetValue( "sasl_mech" );
+			transform( BindMechanism.begin(), BindMechanism.end(), BindMechanism.begin(), ::toupper );
+
+			if( BindMechanism != "EXTERNAL" )
+				throw invalid_argument( "Value of 'sasl_mech' parameter invalid. Only 'EXTERNAL' is supported" );
+
+			Log << DEBUG << "Checking if 'sasl_authzid' parameter exists... ";
+
+			if( Cfg.Exists( "sasl_authzid" ) )
+			{
+				Log << "Yes." << endl;
+				Log << DEBUG << "The value of 'sasl_authzid' is: '" << Cfg.GetValue( "sasl_authzid" ) << "'" << endl;
+
+				BindPassword = Cfg.GetValue( "sasl_authzid" );
+			}
+			else
+			{
+				Log << "No." << endl;
+			}
+		}
+		else
+		{
+			Log << "No." << endl;
+		}
+
+	// Keep the addresses the URIs' hosts resolve to in the cache, if there is one.
+
+		Addresses.Init( Cfg, KeyCache, Log );
+
+	// Limit how many lookups on this host may be connected to the directories at once.
+
+		Limit.Init( Cfg, Log );
+
+	// Check if 'uri' parameter exists in configuration file and split it into the URIs it lists. An entry 'dns:DOMAIN' stands for the
+	// directory servers the domain's SRV records list, in the order RFC 2782 selects. The connection itself is opened by the first
+	// lookup.
+
+		Log << DEBUG << "Checking if 'uri' parameter exists... ";
+
+		if( Cfg.Exists( "uri" ) )
+		{
+			Log << "Yes." << endl;
+			Log << DEBUG << "The value of 'uri' is: '" << Cfg.GetValue( "uri" ) << "'" << endl;
+
+			for( size_t FindStart = 0, FindEnd; FindStart < Cfg.GetValue( "uri" ).length(); FindStart = FindEnd + 1 )
+			{
+				FindEnd = Cfg.GetValue( "uri" ).find_first_of( ", ", FindStart );
+
+				if( FindEnd == string::npos )
+					FindEnd = Cfg.GetValue( "uri" ).length();
+
+				if( FindEnd <= FindStart )
+					continue;
+
+				StringValue = Cfg.GetValue( "uri" ).substr( FindStart, FindEnd - FindStart );
+
+				if( strncasecmp( StringValue.c_str(), "dns:", 4 ) == 0 )
+				{
+					for( const string& Discovered : Addresses.Discover( StringValue.substr( 4 ) ) )
+					{
+						Log << DEBUG << "Discovered directory server: '" << Discovered << "'" << endl;
+
+						URIs.push_back( Discovered );
+					}
+				}
+				else
+				{
+					URIs.push_back( StringValue );
+				}
+			}
+		}
+
+		if( URIs.empty() )
+		{
+			Log << "No." << endl;
+
+			throw invalid_argument( "Value of 'uri' parameter undefined" );
+		}
+
+	// Set scope from configuration value (only accepts "one" or "sub"; "base" is ignored) or default to LDAP_SCOPE_ONELEVEL.
+
+		Log << DEBUG << "Checking if 'scope' parameter exists... ";
+
+		if( Cfg.Exists( "scope" ) )
+		{
+			Log << "Yes." << endl;
+			Log << DEBUG << "The value of 'scope' is: '" << Cfg.GetValue( "scope" ) << "'" << endl;
+
+			if( ( Cfg.GetValue( "scope" ) == "one" ) || ( Cfg.GetValue( "scope" ) == "onelevel" ) )
+			{
+				Scope = LDAP_SCOPE_ONELEVEL;
+			}
+			else if( ( Cfg.GetValue( "scope" ) == "sub" ) || ( Cfg.GetValue( "scope" ) == "subtree" ) )
+			{
+				Scope = LDAP_SCOPE_SUBTREE;
+			}
+			else
+			{
+				Log << WARNING << "Value of 'scope' parameter invalid. Defaulting to 'scope' = 'onelevel'." << endl;
+
+				Scope = LDAP_SCOPE_ONELEVEL;
+			}
+		}
+		else
+		{
+			Log << "No." << endl;
+			Log << DEBUG << "Defaulting to 'scope' = 'onelevel'." << endl;
+
+			Scope = LDAP_SCOPE_ONELEVEL;
+		}
+
+	// Set the filter template from configuration value (%1 denotes the username and is replaced on each lookup).
+
+		Log << DEBUG << "Checking if 'filter' parameter exists... ";
+
+		if( Cfg.Exists( "filter" ) )
+		{
+			Log << "Yes." << endl;
+			Log << DEBUG << "The value of 'filter' is: '" << Cfg.GetValue( "filter" ) << "'" << endl;
+
+			FilterTemplate = Cfg.GetValue( "filter" );
+
+			if( FilterTemplate.find( "%1" ) == string::npos )
+			{
+				throw invalid_argument( "Value of 'filter' parameter invalid. '%1' must denote username in filter" );
+			}
+		}
+		else
+		{
+			Log << "No." << endl;
+			Log << DEBUG << "Defaulting to 'filter' = 'cn=%1'" << endl;
+
+			FilterTemplate = "cn=%1";
+		}
+
+	// Copy attribute name from configuration value or default to the default attribute name, "sshPublicKey".
+
+		Log << DEBUG << "Checking if 'attribute' parameter exists... ";
+
+		if( Cfg.Exists( "attribute" ) && ( !Cfg.GetValue( "attribute" ).empty() ) )
+		{
+			Log << "Yes." << endl;
+			Log << DEBUG << "The value of 'attribute' is: '" << Cfg.GetValue( "attribute" ) << "'" << endl;
+
+			AttributeName = Cfg.GetValue( "attribute" );
+		}
+		else
+		{
+			Log << "No." << endl;
+			Log << DEBUG << "Defaulting to 'attribute' = 'sshPublicKey'" << endl;
+
+			AttributeName = "sshPublicKey";
+		}
+
+	// Substitute the local host's names and groups into the filter, and limit the keys returned to the values the 'value_scope' and
+	// 'value_filter' configuration parameters select for this host.
+
+		Host.Init( Cfg, KeyCache, Log );
+
+		FilterTemplate = Host.ExpandFilter( FilterTemplate );
+
+		Log << DEBUG << "The filter for this host is: '" << FilterTemplate << "'" << endl;
+
+		ValueRules.Init( Cfg, AttributeName, Host.GetScopes(), Log );
+
+	// Check if 'base' parameter exists in configuration file.
+
+		Log << DEBUG << "Checking if 'base' parameter exists...";
+
+		if( Cfg.Exists( "base" ) )
+		{
+			Log << "Yes." << endl;
+			Log << DEBUG << "The value of 'base' is: '" << Cfg.GetValue( "base" ) << "'" << endl;
+
+			if( ! regex_match( Cfg.GetValue( "base" ), regex("(\\w+[=]{1}[a-zA-Z0-9\\_\\-\\!\\%\\*\\+\\/\\:\\;\\<\\>\\?\\$\\&\\#"
+			                                                 "\\(\\)\\[\\]\\{\\}\\.\\s]+)([,{1}]\\w+[=]{1}[a-zA-Z0-9\\_\\-\\!\\%"
+			                                                 "\\*\\+\\/\\:\\;\\<\\>\\?\\$\\&\\#\\(\\)\\[\\]\\{\\}\\.\\s]+)*") ) )
+			{
+				throw invalid_argument( "Value of 'base' parameter invalid" );
+			}
+		}
+		else
+		{
+			Log << "No." << endl;
+
+			throw invalid_argument( "Value of 'base' parameter undefined" );
+		}
+
+	// Set the number of searches to keep outstanding on one connection from the 'pipeline_depth' configuration parameter or
+	// default to 32.
+
+		Log << DEBUG << "Checking if 'pipeline_depth' parameter exists... ";
+
+		if( Cfg.Exists( "pipeline_depth" ) )
+		{
+			Log << "Yes." << endl;
+			Log << DEBUG << "The value of 'pipeline_depth' is: '" << Cfg.GetValue( "pipeline_depth" ) << "'" << endl;
+
+			try
+			{
+				PipelineDepth = stoul( Cfg.GetValue( "pipeline_depth" ) );
+			}
+			catch( exception& Exception )
+			{
+				Log << WARNING << "Value of 'pipeline_depth' parameter cannot be parsed. '" << Exception.what() << "' : "
+				               << ErrnoToString( EINVAL ) << ". Defaulting to 32." << endl;
+
+				PipelineDepth = 32;
+			}
+		}
+		else
+		{
+			Log << "No." << endl;
+			Log << DEBUG << "Defaulting to 'pipeline_depth' = '32'." << endl;
+		}
+
+	// Read the shared accounts listed in the 'shared_accounts' configuration parameter, separated by '|'. Each is 'NAME=DN', and the
+	// keys of the account NAME are those of every member of the group DN.
+
+		Log << DEBUG << "Checking if 'shared_accounts' parameter exists... ";
+
+		if( Cfg.Exists( "shared_accounts" ) )
+		{
+			Log << "Yes." << endl;
+			Log << DEBUG << "The value of 'shared_accounts' is: '" << Cfg.GetValue( "shared_accounts" ) << "'" << endl;
+
+			istringstream SharedStream( Cfg.GetValue( "shared_accounts" ) );
+			size_t Separator;
+
+			while( getline( SharedStream, StringValue, '|' ) )
+			{
+				if( StringValue.empty() )
+					continue;
+
+				Separator = StringValue.find( '=' );
+
+				if( ( Separator == string::npos ) || ( !IsValidUsername( StringValue.substr( 0, Separator ) ) ) ||
+				    ( ( Separator + 1 ) == StringValue.length() ) )
+				{
+					throw invalid_argument( "Value of 'shared_accounts' parameter invalid: '" + StringValue + "'" );
+				}
+
+				SharedAccounts.emplace( StringValue.substr( 0, Separator ), StringValue.substr( Separator + 1 ) );
+			}
+		}
+		else
+		{
+			Log << "No." << endl;
+		}
+
+	// Set the group attribute listing the members of a shared account from the 'member_attribute' configuration parameter or default
+	// to 'member', the attribute members given as DNs are matched by from 'member_dn_attribute' or default to 'entryDN', and the
+	// number of members to find with each search from 'member_chunk_size' or default to 100.
+
+		if( !SharedAccounts.empty() )
+		{
+			Log << DEBUG << "Checking if 'member_attribute' parameter exists... ";
+
+			if( Cfg.Exists( "member_attribute" ) && ( !Cfg.GetValue( "member_attribute" ).empty() ) )
+			{
+				Log << "Yes." << endl;
+				Log << DEBUG << "The value of 'member_attribute' is: '" << Cfg.GetValue( "member_attribute" ) << "'" << endl;
+
+				MemberAttribute = Cfg.GetValue( "member_attribute" );
+			}
+			else
+			{
+				Log << "No." << endl;
+				Log << DEBUG << "Defaulting to 'member_attribute' = 'member'." << endl;
+			}
+
+			Log << DEBUG << "Checking if 'member_dn_attribute' parameter exists... ";
+
+			if( Cfg.Exists( "member_dn_attribute" ) && ( !Cfg.GetValue( "member_dn_attribute" ).empty() ) )
+			{
+				Log << "Yes." << endl;
+				Log << DEBUG << "The value of 'member_dn_attribute' is: '" << Cfg.GetValue( "member_dn_attribute" ) << "'" << endl;
+
+				MemberDNAttribute = Cfg.GetValue( "member_dn_attribute" );
+			}
+			else
+			{
+				Log << "No." << endl;
+				Log << DEBUG << "Defaulting to 'member_dn_attribute' = 'entryDN'." << endl;
+			}
+
+			Log << DEBUG << "Checking if 'member_chunk_size' parameter exists... ";
+
+			if( Cfg.Exists( "member_chunk_size" ) )
+			{
+				Log << "Yes." << endl;
+				Log << DEBUG << "The value of 'member_chunk_size' is: '" << Cfg.GetValue( "member_chunk_size" ) << "'" << endl;
+
+				try
+				{
+					MemberChunkSize = max< size_t >( stoul( Cfg.GetValue( "member_chunk_size" ) ), 1 );
+				}
+				catch( exception& Exception )
+				{
+					Log << WARNING << "Value of 'member_chunk_size' parameter cannot be parsed. '" << Exception.what() << "' : "
+					               << ErrnoToString( EINVAL ) << ". Defaulting to 100." << endl;
+
+					MemberChunkSize = 100;
+				}
+			}
+			else
+			{
+				Log << "No." << endl;
+				Log << DEBUG << "Defaulting to 'member_chunk_size' = '100'." << endl;
+			}
+		}
+
+	// Fingerprint the settings that decide which keys a lookup returns: the value rules, the account checks, and the filter, which
+	// holds the local host's names and groups, with the base, scope and attribute it is searched with. Keys cached under other
+	// settings are not served from the cache.
+
+		RulesFingerprint = Hash( "values " + to_string( ValueRules.GetFingerprint() ) + "\naccount " + to_string( Account.GetFingerprint() ) +
+		                         "\nfilter " + FilterTemplate + "\nbase " + Cfg.GetValue( "base" ) + "\nscope " + to_string( Scope ) +
+		                         "\nattribute " + AttributeName + '\n' );
+}
+
+// Destructor
+
+KeyLookup::~KeyLookup()
+{
+	// Unbind and close the connection.
+
+		Disconnect();
+}
+
+// Public Methods
+
+void KeyLookup::WatchCaller()
+{
+	// Abandon lookups once the calling process, normally sshd, gives up on them by closing stdout or exiting.
+
+		Caller.Start( Log );
+}
+
+bool KeyLookup::Lookup( const string& Username, Result& Keys )
+{
+	// Create local variables.
+
+		bool CacheHit = false;
+		bool FreshCSN;
+		int ErrorCode = LDAP_SUCCESS;
+		int AttributeCount = 0;
+		int ValueIndex;
+		unsigned Findings = 0;
+		uint64_t Fingerprint;
+		const char* Denied;
+		string Filter;
+		map< string, string >::iterator SharedAccount;
+		Cache::Record CacheRecord;
+		CachePolicy::Segment PolicySegment = CachePolicy::Segment::None;
+		vector< char* > AttributeList( 1, const_cast< char* >( AttributeName.c_str() ) );
+		struct berval EntryName = { 0, nullptr };
+		LDAPMessage* Entry = nullptr;
+		LDAPMessage* Response = nullptr;
+		ConnectionLimit::Turn Slot( Limit );
+
+	// Reject usernames that cannot be placed in a filter.
+
+		if( !IsValidUsername( Username ) )
+			throw invalid_argument( "Invalid username: '" + Username + "'" );
+
+		Keys.DN.clear();
+		Keys.Keys.clear();
+		Keys.Block.clear();
+		Keys.Cached = false;
+
+		Fingerprint = GetFingerprint( Username );
+
+	// Request the attributes the account checks read in the same search as the keys, so no further round trip is needed to decide
+	// whether the keys may be used.
+
+		for( string& Attribute : Account.GetAttributes() )
+			AttributeList.push_back( const_cast< char* >( Attribute.c_str() ) );
+
+		AttributeList.push_back( nullptr );
+
+	// Start connecting to the server before the cache work below, unless a recently read CSN may let the keys be served from the
+	// cache without it, so the handshake completes in the meantime.
+
+		FreshCSN = CSNValidation && KeyCache.LoadCSN( CurrentCSN, CSNLifetime );
+
+		if( !FreshCSN )
+			Open();
+
+	// Count this lookup with the cache policy. Users the policy no longer tracks are admitted once their record is stored.
+
+		if( CacheSize != 0 )
+		{
+			try
+			{
+				Policy.Open( KeyCache.GetDirectory(), CacheSize );
+
+				PolicySegment = Policy.Access( Username );
+
+				for( const string& Evicted : Policy.TakeEvictions() )
+					KeyCache.Remove( Evicted );
+
+				Policy.Close();
+			}
+			catch( ios_base::failure& Exception )
+			{
+				Policy.Close();
+
+				Log << WARNING << "Cannot update cache policy. '" << Exception.what() << "' : " << ErrnoToString() << ". "
+				                  "Attempting to continue." << endl;
+			}
+		}
+
+	// With CSN validation, use the CSN read recently from the server or read it now, and serve the cached block of keys as it is,
+	// without searching or formatting, when the CSN has not moved since it was rendered and the settings it was selected under
+	// have not changed.
+
+		if( CSNValidation )
+		{
+			if( !FreshCSN )
+				ReadCSN();
+
+			if( ( !CurrentCSN.empty() ) && KeyCache.Load( Username, CacheRecord ) && ( CacheRecord.CSN == CurrentCSN ) &&
+			    ( CacheRecord.Rules == Fingerprint ) )
+			{
+				Log << DEBUG << "Size of cached block of keys: " << CacheRecord.Block.size() << " bytes." << endl;
+
+				Keys.DN = CacheRecord.DN;
+				Keys.Block = move( CacheRecord.Block );
+				Keys.Cached = true;
+
+				Log << INFORMATION << "Success for user: " << Username << " (served from cache, CSN unchanged)." << endl;
+
+				return true;
+			}
+		}
+
+		Connect();
+
+	// A shared account's keys are the keys of every member of its group, found with a few searches rather than one per member. The
+	// union is cached like a user's keys, under the CSN it was fetched under.
+
+		if( ( SharedAccount = SharedAccounts.find( Username ) ) != SharedAccounts.end() )
+		{
+			if( !LookupMembers( SharedAccount->second, Keys, Findings ) )
+				return false;
+
+			for( const string& Key : Keys.Keys )
+				Keys.Block.append( Key ).push_back( '\n' );
+
+			if( KeyCache.IsActive() && ( !CurrentCSN.empty() ) && ( !( Findings & AccountPolicy::Expiring ) ) )
+			{
+				CacheRecord.DN = Keys.DN;
+				CacheRecord.CSN = CurrentCSN;
+				CacheRecord.Rules = Fingerprint;
+				CacheRecord.Block = Keys.Block;
+
+				try
+				{
+					KeyCache.Store( Username, CacheRecord );
+
+					if( ( CacheSize != 0 ) && ( PolicySegment == CachePolicy::Segment::None ) )
+						Admit( vector< string >( 1, Username ), false );
+				}
+				catch( ios_base::failure& Exception )
+				{
+					Log << WARNING << "Cannot store cache record. '" << Exception.what() << "' : " << ErrnoToString() << ". "
+					                  "Attempting to continue." << endl;
+				}
+			}
+
+			Log << INFORMATION << "Success for shared account: " << Username << "." << endl;
+
+			return true;
+		}
+
+		Filter = ExpandFilter( FilterTemplate, Username );
+
+	// If the user's DN is cached, read that entry directly with a base-scope search. The filter is still applied so an entry that no
+	// longer matches is not used. Fall back to the filtered search when the entry is gone or no longer matches.
+
+		if( KeyCache.IsActive() && KeyCache.Load( Username, CacheRecord ) && ( !CacheRecord.DN.empty() ) )
+		{
+			Log << DEBUG << "Performing base-scope search of cached DN: '" << CacheRecord.DN << "'... ";
+
+			ErrorCode = Search( CacheRecord.DN, LDAP_SCOPE_BASE, Filter, AttributeList.data(), 2, Response );
+
+			Log << "Finished." << endl;
+
+			if( ( ErrorCode == LDAP_SUCCESS ) && ( ldap_count_entries( Interface, Response ) == 1 ) )
+			{
+				CacheHit = true;
+
+				Log << INFORMATION << "Cached DN is valid for user: " << Username << "." << endl;
+			}
+			else
+			{
+				if( ( ErrorCode == LDAP_NO_SUCH_OBJECT ) || ( ErrorCode == LDAP_SUCCESS ) )
+				{
+					Log << INFORMATION << "Cached DN is no longer valid for user: " << Username << ". Falling back to filtered search."
+					                   << endl;
+
+					try
+					{
+						KeyCache.Remove( Username );
+					}
+					catch( ios_base::failure& Exception )
+					{
+						Log << WARNING << "Cannot remove cache record. '" << Exception.what() << "' : " << ErrnoToString() << ". "
+						                  "Attempting to continue." << endl;
+					}
+				}
+				else
+				{
+					Log << WARNING << "ldap_search_ext_s(): " << ldap_err2string( ErrorCode ) << ". Falling back to filtered search."
+					               << endl;
+				}
+
+				if( Response != nullptr )
+				{
+					LDAPMsgFree( Response );
+				}
+			}
+		}
+
+	// Commit search. Note: Fetch a maximum 2 entries to ensure the entry is singular.
+
+		if( !CacheHit )
+		{
+			Log << DEBUG << "Performing search... ";
+
+			ErrorCode = Search( Cfg.GetValue( "base" ), Scope, Filter, AttributeList.data(), 2, Response );
+
+			Log << "Finished." << endl;
+		}
+
+	// If an error occurred, throw.
+
+		if( ErrorCode != LDAP_SUCCESS )
+		{
+			if( Response != nullptr )
+			{
+				LDAPMsgFree( Response );
+			}
+
+			throw runtime_error( string( "ldap_search_ext_s(): " ) + ldap_err2string( ErrorCode ) );
+		}
+
+	// Ensure the entry is singular or throw; return false on zero entries.
+
+		Log << DEBUG << "Number of entries in result: " << ldap_count_entries( Interface, Response ) << "." << endl;
+
+		if( ldap_count_entries( Interface, Response ) > 1 )
+		{
+			LDAPMsgFree( Response );
+
+			throw runtime_error( "Filter returned more than one result for user: " + Username );
+		}
+		else if( ldap_count_entries( Interface, Response ) == 0 )
+		{
+			LDAPMsgFree( Response );
+
+			Log << INFORMATION << "No results returned for user: " << Username << "." << endl;
+
+			return false;
+		}
+
+	// Set a pointer to the entry.
+
+		Entry = ldap_first_entry( Interface, Response );
+
+	// Loop through the attributes in place, without copying names. Copy the values of the attribute matching the attribute name
+	// (above) that the value filter selects to the result and pass the other attributes to the account checks.
+
+		DecodeEntry( Interface, Entry, EntryName, [ & ]( const struct berval& Name, BerVarray AttributeValues )
+		{
+			if( ( AttributeValues != nullptr ) && IsAttribute( Name, AttributeName ) )
+			{
+				for( ValueIndex = 0; AttributeValues[ ValueIndex ].bv_val != nullptr; ValueIndex++ )
+				{
+					string_view Value( AttributeValues[ ValueIndex ].bv_val, AttributeValues[ ValueIndex ].bv_len );
+
+					if( ValueRules.Select( Value ) )
+						Keys.Keys.emplace_back( Value );
+				}
+
+				Log << DEBUG << "Number of attribute values in result: " << ValueIndex << "." << endl;
+			}
+			else
+			{
+				Findings |= Account.Inspect( Name, AttributeValues );
+			}
+
+			AttributeCount++;
+		} );
+
+		Keys.DN.assign( EntryName.bv_val, EntryName.bv_len );
+
+		LDAPMsgFree( Response );
+
+		Log << DEBUG << "Number of attributes in result: " << AttributeCount << "." << endl;
+
+	// Return no keys for an account the checks deny. Render the keys as the authorized_keys block written out and cached.
+
+		if( ( Denied = Account.Deny( Findings ) ) != nullptr )
+			Keys.Keys.clear();
+
+		for( const string& Key : Keys.Keys )
+			Keys.Block.append( Key ).push_back( '\n' );
+
+	// Store the user's DN, and with CSN validation the keys and the CSN they were fetched under, in the cache. The keys of denied
+	// accounts and of accounts that will expire are not kept, since an account can expire without the CSN moving, so those users
+	// are searched again on every lookup.
+
+		if( KeyCache.IsActive() && ( ( !CacheHit ) || ( !CurrentCSN.empty() ) ) )
+		{
+			CacheRecord.DN = Keys.DN;
+			CacheRecord.CSN = ( ( Denied == nullptr ) && ( !( Findings & AccountPolicy::Expiring ) ) ) ? CurrentCSN : "";
+
+			CacheRecord.Rules = Fingerprint;
+
+			if( !CacheRecord.CSN.empty() )
+				CacheRecord.Block = Keys.Block;
+			else
+				CacheRecord.Block.clear();
+
+			try
+			{
+				KeyCache.Store( Username, CacheRecord );
+
+				Log << DEBUG << "Cached DN: '" << CacheRecord.DN << "' for user: " << Username << "." << endl;
+
+				if( ( CacheSize != 0 ) && ( PolicySegment == CachePolicy::Segment::None ) )
+					Admit( vector< string >( 1, Username ), false );
+			}
+			catch( ios_base::failure& Exception )
+			{
+				Log << WARNING << "Cannot store cache record. '" << Exception.what() << "' : " << ErrnoToString() << ". "
+				                  "Attempting to continue." << endl;
+			}
+		}
+
+		if( Denied != nullptr )
+		{
+			Log << NOTICE << "Denied keys for user: " << Username << " (" << Denied << ")." << endl;
+
+			return false;
+		}
+
+		Log << INFORMATION << "Success for user: " << Username << "." << endl;
+
+	// Return true.
+
+		return true;
+}
+
+void KeyLookup::LookupMany( SearchPipeline::Source NextUsername, SearchPipeline::Sink OnResult )
+{
+	// Create local variables.
+
+		vector< string > SharedNames;
+		ConnectionLimit::Turn Slot( Limit );
+
+	// Look up the usernames the source returns over this object's connection with pipelined searches, passing each result to the
+	// sink in completion order. Shared accounts are set aside and looked up once the pipeline is drained.
+
+		Connect();
+
+		SearchPipeline Pipeline( Interface, Cfg.GetValue( "base" ), Scope, FilterTemplate, AttributeName, Account, ValueRules,
+		                         PipelineDepth );
+
+		Pipeline.Run( [ & ]( string& Next )
+		              {
+		                  while( NextUsername( Next ) )
+		                  {
+		                      if( SharedAccounts.count( Next ) == 0 )
+		                          return true;
+
+		                      SharedNames.push_back( Next );
+		                  }
+
+		                  return false;
+		              },
+		              OnResult );
+
+		Log << DEBUG << "Result arenas served " << Pipeline.GetAllocations() << " allocations, " << Pipeline.GetHeapAllocations()
+		             << " from the heap." << endl;
+
+	// A shared account's result holds the keys of every member of its group that the account checks allow, and no DN. One whose
+	// group is missing is reported as not found, and one whose members cannot be searched as an error.
+
+		for( const string& Name : SharedNames )
+		{
+			SearchPipeline::Result Current( pmr::new_delete_resource() );
+			Result Keys;
+
+			Current.Username = Name;
+
+			try
+			{
+				if( LookupMembers( SharedAccounts[ Name ], Keys, Current.Findings ) )
+				{
+					Current.EntryCount = 1;
+
+					for( const string& Key : Keys.Keys )
+						Current.Values.emplace_back( Key );
+				}
+			}
+			catch( runtime_error& Exception )
+			{
+				Log << WARNING << "Cannot look up shared account: " << Name << " : " << Exception.what() << "." << endl;
+
+				Current.ErrorCode = LDAP_OTHER;
+			}
+
+			OnResult( Current );
+		}
+}
+
+size_t KeyLookup::Prefetch( const vector< string >& Usernames )
+{
+	// Create local variables.
+
+		size_t PrefetchIndex = 0;
+		size_t PrefetchStored = 0;
+		vector< string > PrefetchedUsers;
+		Cache::Record CacheRecord;
+		ConnectionLimit::Turn Slot( Limit );
+
+	// Prefetching fills the cache, so it needs one.
+
+		if( !KeyCache.IsActive() )
+			throw invalid_argument( "Prefetch mode requires a usable 'cache_dir' parameter" );
+
+		if( !CSNValidation )
+		{
+			Log << NOTICE << "Keys are only cached with 'cache_validation' = 'csn'. Prefetching DNs only." << endl;
+		}
+		else
+		{
+			Connect();
+			ReadCSN();
+		}
+
+	// Fetch the users' entries with pipelined searches and store them in the cache.
+
+		LookupMany( [ & ]( string& NextUsername )
+		            {
+		                if( PrefetchIndex >= Usernames.size() )
+		                    return false;
+
+		                NextUsername = Usernames[ PrefetchIndex++ ];
+
+		                return true;
+		            },
+		            [ & ]( SearchPipeline::Result& Current )
+		            {
+		                if( ( Current.ErrorCode != LDAP_SUCCESS ) || ( Current.EntryCount != 1 ) )
+		                {
+		                    Log << DEBUG << "Not prefetching user: " << Current.Username << " ("
+		                                 << ( ( Current.ErrorCode != LDAP_SUCCESS ) ? ldap_err2string( Current.ErrorCode )
+		                                                                           : "no single entry" ) << ")." << endl;
+		                    return;
+		                }
+
+		                if( ( Current.Denied != nullptr ) || ( Current.Findings & AccountPolicy::Expiring ) )
+		                {
+		                    Log << DEBUG << "Not prefetching user: " << Current.Username << " ("
+		                                 << ( ( Current.Denied != nullptr ) ? Current.Denied : "account expiring" ) << ")." << endl;
+		                    return;
+		                }
+
+		                if( ( !CSNValidation ) && Current.DN.empty() )
+		                {
+		                    Log << DEBUG << "Not prefetching shared account: " << Current.Username << " (no DN to cache)." << endl;
+		                    return;
+		                }
+
+		                CacheRecord.DN.assign( Current.DN );
+		                CacheRecord.CSN = CurrentCSN;
+		                CacheRecord.Rules = GetFingerprint( string( Current.Username ) );
+		                CacheRecord.Block.clear();
+
+		                if( CSNValidation )
+		                {
+		                    for( const pmr::string& Key : Current.Values )
+		                        CacheRecord.Block.append( Key ).push_back( '\n' );
+		                }
+
+		                try
+		                {
+		                    PrefetchedUsers.emplace_back( Current.Username );
+		                    KeyCache.Store( PrefetchedUsers.back(), CacheRecord );
+		                    PrefetchStored++;
+		                }
+		                catch( ios_base::failure& Exception )
+		                {
+		                    Log << WARNING << "Cannot store cache record. '" << Exception.what() << "' : " << ErrnoToString()
+		                                   << ". Attempting to continue." << endl;
+		                }
+		            } );
+
+		if( CacheSize != 0 )
+			Admit( PrefetchedUsers, true );
+
+		Log << INFORMATION << "Prefetched " << PrefetchStored << " of " << Usernames.size() << " users." << endl;
+
+	// Return PrefetchStored.
+
+		return PrefetchStored;
+}
+
+KeyLookup::ExportResult KeyLookup::Export( const string& Directory )
+{
+	// Create local variables.
+
+		int ErrorCode = LDAP_SUCCESS;
+		int PageSize = 1000;
+		size_t ExportThreads = 4;
+		size_t ExportAllocations = 0;
+		size_t ExportHeapAllocations = 0;
+		string NameAttribute;
+		string PrefixFilters;
+		string ScanPrefixes;
+		string StringValue;
+		smatch Match;
+		set< string > ExportSeen;
+		set< string > ExportKeep;
+		set< string > ExportDuplicates;
+		vector< string > ScanPartitions;
+		vector< string > ScanBaseNames;
+		vector< string > ScanBases;
+		vector< string > ScanFilters;
+		ExportResult Summary = { 0, 0, 0, 0, 0, 0 };
+		ConnectionLimit::Turn Slot( Limit );
+
+	// Determine the username attribute from the filter and create the export directory.
+
+		if( !regex_search( FilterTemplate, Match, regex( "([A-Za-z][-A-Za-z0-9;.]*)=%1" ) ) )
+			throw invalid_argument( "Cannot determine the username attribute from the filter: '" + FilterTemplate + "'" );
+
+		NameAttribute = Match[ 1 ];
+
+		Log << DEBUG << "The username attribute is: '" << NameAttribute << "'" << endl;
+
+		if( ( mkdir( Directory.c_str(), ( S_IRWXU | S_IRGRP | S_IXGRP | S_IROTH | S_IXOTH ) ) != 0 ) && ( errno != EEXIST ) )
+			throw runtime_error( "Cannot create export directory: '" + Directory + "' : " + ErrnoToString() );
+
+	// Set the number of writer threads from the 'export_threads' configuration parameter or default to 4.
+
+		Log << DEBUG << "Checking if 'export_threads' parameter exists... ";
+
+		if( Cfg.Exists( "export_threads" ) )
+		{
+			Log << "Yes." << endl;
+			Log << DEBUG << "The value of 'export_threads' is: '" << Cfg.GetValue( "export_threads" ) << "'" << endl;
+
+			try
+			{
+				ExportThreads = stoul( Cfg.GetValue( "export_threads" ) );
+			}
+			catch( exception& Exception )
+			{
+				Log << WARNING << "Value of 'export_threads' parameter cannot be parsed. '" << Exception.what() << "' : "
+				               << ErrnoToString( EINVAL ) << ". Defaulting to 4." << endl;
+
+				ExportThreads = 4;
+			}
+		}
+		else
+		{
+			Log << "No." << endl;
+			Log << DEBUG << "Defaulting to 'export_threads' = '4'." << endl;
+		}
+
+	// Set the number of entries per page from the 'page_size' configuration parameter or default to 1000.
+
+		Log << DEBUG << "Checking if 'page_size' parameter exists... ";
+
+		if( Cfg.Exists( "page_size" ) )
+		{
+			Log << "Yes." << endl;
+			Log << DEBUG << "The value of 'page_size' is: '" << Cfg.GetValue( "page_size" ) << "'" << endl;
+
+			try
+			{
+				PageSize = stoi( Cfg.GetValue( "page_size" ) );
+			}
+			catch( exception& Exception )
+			{
+				Log << WARNING << "Value of 'page_size' parameter cannot be parsed. '" << Exception.what() << "' : "
+				               << ErrnoToString( EINVAL ) << ". Defaulting to 1000." << endl;
+
+				PageSize = 1000;
+			}
+		}
+		else
+		{
+			Log << "No." << endl;
+			Log << DEBUG << "Defaulting to 'page_size' = '1000'." << endl;
+		}
+
+	// Split the scan into the partitions listed in the 'scan_partitions' configuration parameter, separated by '|'. A partition
+	// containing '=' is a sub-base, scanned with the full filter; any other partition is a set of first characters of the username
+	// such as 'a-f' or '0-9xyz', scanned from 'base'. Each partition is scanned concurrently on its own connection, to the URIs
+	// listed in 'uri' in turn.
+
+		Log << DEBUG << "Checking if 'scan_partitions' parameter exists... ";
+
+		if( Cfg.Exists( "scan_partitions" ) )
+		{
+			Log << "Yes." << endl;
+			Log << DEBUG << "The value of 'scan_partitions' is: '" << Cfg.GetValue( "scan_partitions" ) << "'" << endl;
+
+			istringstream PartitionStream( Cfg.GetValue( "scan_partitions" ) );
+
+			while( getline( PartitionStream, StringValue, '|' ) )
+			{
+				if( !StringValue.empty() )
+					ScanPartitions.push_back( StringValue );
+			}
+		}
+		else
+		{
+			Log << "No." << endl;
+		}
+
+		StringValue = ExpandFilter( FilterTemplate, "*" );
+
+		if( StringValue[ 0 ] != '(' )
+			StringValue = "(" + StringValue + ")";
+
+		if( ScanPartitions.empty() )
+			ScanPartitions.push_back( "" );
+
+	// Partitions must not overlap, since a user found by two of them is taken for a duplicate and left out, and they must cover every
+	// user, since users outside all of them would be pruned. First characters may only be listed once, and users whose names start
+	// with any other character are scanned by one more partition. Sub-bases may not contain one another, and cannot be mixed with
+	// first characters.
+
+		for( const string& Partition : ScanPartitions )
+		{
+			if( Partition.empty() || ( Partition.find( '=' ) != string::npos ) )
+			{
+				string BaseLower = Partition;
+
+				transform( BaseLower.begin(), BaseLower.end(), BaseLower.begin(), ::tolower );
+
+				auto IsWithin = []( const string& Inner, const string& Outer )
+				                {
+				                    return ( ( Inner == Outer ) ||
+				                             ( ( Inner.length() > Outer.length() ) &&
+				                               ( Inner.compare( Inner.length() - Outer.length() - 1, string::npos, "," + Outer ) == 0 ) ) );
+				                };
+
+				for( const string& Other : ScanBaseNames )
+				{
+					if( IsWithin( BaseLower, Other ) || IsWithin( Other, BaseLower ) )
+						throw invalid_argument( "Value of 'scan_partitions' parameter invalid. Partitions overlap: '" + Partition + "'" );
+				}
+
+				ScanBaseNames.push_back( BaseLower );
+				ScanBases.push_back( Partition.empty() ? Cfg.GetValue( "base" ) : Partition );
+				ScanFilters.push_back( StringValue );
+
+				continue;
+			}
+
+			string PrefixFilter;
+
+			for( size_t Index = 0;
+			     ( Index < Partition.length() ) && ( Partition.find_first_not_of( "-0123456789abcdefghijklmnopqrstuvwxyz" ) == string::npos );
+			     Index++ )
+			{
+				char First = Partition[ Index ];
+				char Last = First;
+
+				if( ( ( Index + 2 ) < Partition.length() ) && ( Partition[ Index + 1 ] == '-' ) )
+				{
+					Last = Partition[ Index + 2 ];
+					Index += 2;
+				}
+
+				for( char Symbol = First; ( Symbol <= Last ) && ( Symbol != '-' ); Symbol++ )
+				{
+					if( ScanPrefixes.find( Symbol ) != string::npos )
+						throw invalid_argument( "Value of 'scan_partitions' parameter invalid. Partitions overlap: '" + Partition + "'" );
+
+					ScanPrefixes += Symbol;
+					PrefixFilter += "(" + NameAttribute + "=" + Symbol + "*)";
+				}
+			}
+
+			if( PrefixFilter.empty() )
+				throw invalid_argument( "Value of 'scan_partitions' parameter invalid: '" + Partition + "'" );
+
+			ScanBases.push_back( Cfg.GetValue( "base" ) );
+			ScanFilters.push_back( "(&" + StringValue + "(|" + PrefixFilter + "))" );
+			PrefixFilters += PrefixFilter;
+		}
+
+		if( ( !ScanPrefixes.empty() ) && ( !ScanBaseNames.empty() ) )
+			throw invalid_argument( "Value of 'scan_partitions' parameter invalid. Sub-bases and first characters cannot be mixed" );
+
+		if( !ScanPrefixes.empty() )
+		{
+			Log << DEBUG << "Adding a partition for users whose names start with characters other than: '" << ScanPrefixes << "'." << endl;
+
+			ScanBases.push_back( Cfg.GetValue( "base" ) );
+			ScanFilters.push_back( "(&" + StringValue + "(!(|" + PrefixFilters + ")))" );
+		}
+
+	// Scan the partitions and write one authorized_keys file per user on a pool of worker threads while the pages of results arrive.
+	// A user found in more than one entry is emptied as soon as the second entry arrives, since either entry's keys would be wrong,
+	// and the file is removed once the scan is complete.
+
+		Connect();
+
+		ExportWriter Writer( Directory, ExportThreads );
+		mutex SinkMutex;
+		atomic< size_t > NextPartition( 0 );
+		vector< thread > Scanners;
+		vector< int > ScanResults( ScanBases.size(), LDAP_SUCCESS );
+		vector< string > ScanErrors( ScanBases.size() );
+
+		auto ConsumeEntry = [ & ]( DirectoryScan::Entry& Current )
+		                    {
+		                        string Contents;
+
+		                        for( const pmr::string& Key : Current.Values )
+		                        {
+		                            Contents += Key;
+		                            Contents += '\n';
+		                        }
+
+		                        for( const pmr::string& Entry : Current.Names )
+		                        {
+		                            const string Name( Entry );
+
+		                            if( ( !IsValidUsername( Name ) ) || ( SharedAccounts.count( Name ) != 0 ) )
+		                                continue;
+
+		                            if( !ExportSeen.insert( Name ).second )
+		                            {
+		                                if( ExportDuplicates.insert( Name ).second )
+		                                {
+		                                    Log << WARNING << "More than one entry found for user: " << Name << ". Not exporting." << endl;
+
+		                                    ExportKeep.erase( Name );
+		                                    Writer.Submit( Name, string() );
+		                                }
+
+		                                continue;
+		                            }
+
+		                            if( Current.Denied != nullptr )
+		                            {
+		                                Log << DEBUG << "Not exporting user: " << Name << " (" << Current.Denied << ")." << endl;
+
+		                                continue;
+		                            }
+
+		                            if( !Contents.empty() )
+		                            {
+		                                ExportKeep.insert( Name );
+		                                Writer.Submit( Name, string( Contents ) );
+		                            }
+		                        }
+
+		                        Summary.Entries++;
+		                    };
+
+		for( size_t Index = 0; Index < ScanBases.size(); Index++ )
+		{
+			Log << DEBUG << "Scanning partition " << Index << ": base '" << ScanBases[ Index ] << "', filter '" << ScanFilters[ Index ]
+			             << "'." << endl;
+		}
+
+	// Each scanner takes the next partition until none are left. The first uses this object's connection; every other one first waits
+	// for a turn of its own when the number of lookups using the directory is limited, then opens another connection. A scanner that
+	// cannot get one leaves its partitions to the others.
+
+		for( size_t ScannerIndex = 0; ScannerIndex < ScanBases.size(); ScannerIndex++ )
+		{
+			Scanners.emplace_back( [ &, ScannerIndex ]()
+			                       {
+			                           size_t Index;
+			                           LDAP* Connection = Interface;
+			                           Output ScanLog;
+			                           ConnectionLimit ScanLimit;
+
+			                           ScanLog.Init( Log );
+
+			                           if( ScannerIndex != 0 )
+			                           {
+			                               try
+			                               {
+			                                   ScanLimit.Init( Limit, ScanLog );
+			                                   ScanLimit.Acquire();
+
+			                                   if( NextPartition >= ScanBases.size() )
+			                                       return;
+
+			                                   Connection = CloneConnection( Interface, URIs[ ScannerIndex % URIs.size() ], StartTLS, BindMechanism,
+			                                                                 BindDN, BindPassword );
+			                               }
+			                               catch( exception& Exception )
+			                               {
+			                                   ScanLog << NOTICE << "Cannot open another connection for the scan: " << Exception.what() << ". "
+			                                                        "Scanning on the remaining connections." << endl;
+
+			                                   return;
+			                               }
+			                           }
+
+			                           while( ( Index = NextPartition++ ) < ScanBases.size() )
+			                           {
+			                               try
+			                               {
+			                                   DirectoryScan Scan( Connection, ScanBases[ Index ], Scope, ScanFilters[ Index ], NameAttribute,
+			                                                       AttributeName, Account, ValueRules, PageSize );
+
+			                                   ScanResults[ Index ] = Scan.Run( [ & ]( DirectoryScan::Entry& Current )
+			                                                                    {
+			                                                                        lock_guard< mutex > Lock( SinkMutex );
+
+			                                                                        ConsumeEntry( Current );
+			                                                                    } );
+
+			                                   {
+			                                       lock_guard< mutex > Lock( SinkMutex );
+
+			                                       ExportAllocations += Scan.GetAllocations();
+			                                       ExportHeapAllocations += Scan.GetHeapAllocations();
+			                                   }
+
+			                                   if( ScanResults[ Index ] != LDAP_SUCCESS )
+			                                       ScanErrors[ Index ] = ldap_err2string( ScanResults[ Index ] );
+			                               }
+			                               catch( exception& Exception )
+			                               {
+			                                   ScanResults[ Index ] = LDAP_OTHER;
+			                                   ScanErrors[ Index ] = Exception.what();
+			                               }
+			                           }
+
+			                           if( Connection != Interface )
+			                               ldap_unbind_ext_s( Connection, nullptr, nullptr );
+			                       } );
+		}
+
+		for( thread& Scanner : Scanners )
+			Scanner.join();
+
+	// Write the files of the shared accounts once the scan is complete, over this object's connection. An entry of the same name is
+	// left out of the scan, as a lookup by username takes the shared account. One whose group is missing is pruned like a user who is
+	// gone, and one whose members cannot be searched fails the export.
+
+		for( pair< const string, string >& SharedAccount : SharedAccounts )
+		{
+			Result Keys;
+			unsigned Findings = 0;
+			string Contents;
+
+			try
+			{
+				if( !LookupMembers( SharedAccount.second, Keys, Findings ) )
+					continue;
+			}
+			catch( runtime_error& Exception )
+			{
+				Log << ERROR << "Cannot look up shared account: " << SharedAccount.first << " : " << Exception.what() << "." << endl;
+
+				ErrorCode = LDAP_OTHER;
+
+				continue;
+			}
+
+			for( const string& Key : Keys.Keys )
+			{
+				Contents += Key;
+				Contents += '\n';
+			}
+
+			if( !Contents.empty() )
+			{
+				ExportKeep.insert( SharedAccount.first );
+				Writer.Submit( SharedAccount.first, move( Contents ) );
+			}
+		}
+
+		Writer.Finish();
+
+	// Keep every existing file when any partition failed, since users missing from an incomplete scan are not known to be gone.
+
+		for( size_t Index = 0; Index < ScanBases.size(); Index++ )
+		{
+			if( ScanResults[ Index ] != LDAP_SUCCESS )
+			{
+				Log << ERROR << "Scan of partition " << Index << " failed: " << ScanErrors[ Index ] << "." << endl;
+
+				ErrorCode = ScanResults[ Index ];
+			}
+		}
+
+		if( ErrorCode != LDAP_SUCCESS )
+			throw runtime_error( "Export scan failed. Existing files were kept" );
+
+	// Remove the files of users who are no longer found. Sub-bases cannot be checked to cover every user, so with more than one, a user
+	// the scan did not see is looked up from 'base' first, and the file is kept if the user is still found there or the search fails.
+
+		Summary.Removed = Writer.Prune( ExportKeep, [ & ]( const string& Name )
+		                                            {
+		                                                char* NoAttributes[] = { ( char* ) "1.1", nullptr };
+		                                                int SearchResult;
+		                                                bool Gone;
+		                                                LDAPMessage* Response = nullptr;
+
+		                                                if( ( ScanBaseNames.size() < 2 ) || ( ExportSeen.count( Name ) != 0 ) )
+		                                                    return true;
+
+		                                                SearchResult = Search( Cfg.GetValue( "base" ), Scope, ExpandFilter( FilterTemplate, Name ),
+		                                                                       NoAttributes, 1, Response );
+		                                                Gone = ( ( SearchResult == LDAP_SUCCESS ) && ( ldap_count_entries( Interface, Response ) == 0 ) );
+
+		                                                if( Response != nullptr )
+		                                                {
+		                                                    LDAPMsgFree( Response );
+		                                                }
+
+		                                                if( !Gone )
+		                                                    Log << WARNING << "User: " << Name << " was not scanned but may still exist. "
+		                                                                      "Keeping the existing file." << endl;
+
+		                                                return Gone;
+		                                            } );
+		Summary.Users = ExportKeep.size();
+		Summary.Written = Writer.GetWritten();
+		Summary.Unchanged = Writer.GetUnchanged();
+		Summary.Failed = Writer.GetFailed();
+
+		Log << INFORMATION << "Exported " << Summary.Users << " users from " << Summary.Entries << " entries to: '" << Directory << "' ("
+		                   << Summary.Written << " written, " << Summary.Unchanged << " unchanged, " << Summary.Removed << " removed)."
+		                   << endl;
+		Log << DEBUG << "Entry arenas served " << ExportAllocations << " allocations, " << ExportHeapAllocations << " from the heap."
+		             << endl;
+
+	// Return Summary.
+
+		return Summary;
+}
+
+vector< pair< string, unsigned long long > > KeyLookup::GetCacheStatistics()
+{
+	// Create local variables.
+
+		vector< pair< string, unsigned long long > > ReturnValue;
+
+	// Read the cache policy counters.
+
+		if( CacheSize == 0 )
+			throw invalid_argument( "Cache statistics require usable 'cache_dir' and 'cache_size' parameters" );
+
+		try
+		{
+			Policy.Open( KeyCache.GetDirectory(), CacheSize );
+
+			ReturnValue = Policy.GetStatistics();
+
+			Policy.Close();
+		}
+		catch( ios_base::failure& Exception )
+		{
+			Policy.Close();
+
+			throw runtime_error( string( "Cannot read cache policy. '" ) + Exception.what() + "' : " + ErrnoToString() );
+		}
+
+	// Return ReturnValue.
+
+		return ReturnValue;
+}
+
+// Private Methods
+
+void KeyLookup::Open()
+{
+	// Create local variables.
+
+		bool ErrorOccurred = false;
+		bool Dialed = false;
+		int ErrorCode;
+		int IntegerValue;
+		string StringValue;
+		string URIList;
+		struct timeval Seconds;
+
+	// Wait for a turn to use the directory when the number of lookups using it at once on this host is limited. The turn lasts until
+	// the public method that started it returns, while the connection may stay open.
+
+		Limit.Acquire();
+
+	// Keep an open connection for the lifetime of this object.
+
+		if( Interface != nullptr )
+			return;
+
+	// Connect to a cached address of the URIs' hosts if there is one, or else initialize LDAP using the URIs 'uri' lists.
+
+		for( const string& URI : URIs )
+			URIList += ( URIList.empty() ? "" : " " ) + URI;
+
+		if( ( Interface = Addresses.Open( URIs, InstallTLS ) ) != nullptr )
+		{
+			Dialed = true;
+			Log << INFORMATION << "LDAP interface initialized successfully." << endl;
+		}
+		else if( ( ErrorCode = ldap_initialize( &Interface, URIList.c_str() ) ) != LDAP_SUCCESS )
+		{
+			throw runtime_error( string( "ldap_initialize(): " ) + ldap_err2string( ErrorCode ) );
+		}
+		else
+		{
+			Log << INFORMATION << "LDAP interface initialized successfully." << endl;
+		}
+
+	// Set LDAP_OPT_PROTOCOL_VERSION using 'ldap_version' configuration parameter.
+
+		Log << DEBUG << "Checking if 'ldap_version' parameter exists... ";
+
+		if( Cfg.Exists( "ldap_version" ) )
+		{
+			Log << "Yes." << endl;
+			Log << DEBUG << "The value of 'ldap_version' is: '" << Cfg.GetValue( "ldap_version" ) << "'" << endl;
+
+			try
+			{
+				IntegerValue = stoi( Cfg.GetValue( "ldap_version" ) );
+			}
+			catch( invalid_argument& Exception )
+			{
+				Log << WARNING << "Value of 'ldap_version' parameter cannot be parsed. '" << Exception.what() << "' : "
+				               << ErrnoToString( EINVAL ) << ". Defaulting to LDAPv3." << endl;
+
+				IntegerValue = LDAP_VERSION3;
+			}
+			catch( out_of_range& Exception )
+			{
+				Log << WARNING << "Value of 'ldap_version' parameter cannot be parsed. '" << Exception.what() << "' : "
+				               << ErrnoToString( ERANGE ) << ". Defaulting to LDAPv3." << endl;
+
+				IntegerValue = LDAP_VERSION3;
+			}
+			catch( exception& Exception )
+			{
+				Log << WARNING << "Value of 'ldap_version' parameter cannot be parsed. '" << Exception.what() << "' threw an "
+				                  "unhandled exception. Defaulting to LDAPv3." << endl;
+
+				IntegerValue = LDAP_VERSION3;
+			}
+
+			if( IntegerValue == 2 )
+			{
+				Log << NOTICE << "You are using LDAPv2. Please ensure you intend to use this version and/or consider upgrading"
+				                 " to LDAPv3." << endl;
+				
+				IntegerValue = LDAP_VERSION2;
+			}
+			else if( ( IntegerValue > 3 ) || ( IntegerValue < 2 ) )
+			{
+				Log << WARNING << "Value of 'ldap_version' parameter invalid. Defaulting to LDAPv3." << endl;
+
+				IntegerValue = LDAP_VERSION3;
+			}
+
+			if( ( ErrorCode = ldap_set_option( Interface, LDAP_OPT_PROTOCOL_VERSION, &IntegerValue ) ) != LDAP_SUCCESS )
+			{
+				Disconnect();
+
+				throw runtime_error( string( "ldap_set_option( LDAP_VERSION ): " ) + ldap_err2string( ErrorCode ) );
+			}
+			else
+			{
+				Log << INFORMATION << "ldap_set_option( LDAP_VERSION ): Success." << endl;
+			}
+		} 
+		else 
+		{
+			Log << "No. Defaulting to LDAPv3." << endl;
+
+			IntegerValue = LDAP_VERSION3;
+
+			if( ( ErrorCode = ldap_set_option( Interface, LDAP_OPT_PROTOCOL_VERSION, &IntegerValue ) ) != LDAP_SUCCESS ) 
+			{
+				Disconnect();
+
+				throw runtime_error( string( "ldap_set_option( LDAP_VERSION ): " ) + ldap_err2string( ErrorCode ) );
+			}
+			else
+			{
+				Log << INFORMATION << "ldap_set_option( LDAP_VERSION ): Success." << endl;
+			}
+		}
+
+	// OpenLDAP specific configuration parameters. If these are set on any other system, they are ignored.
+
+#				ifdef LDAP_API_FEATURE_X_OPENLDAP
+
+		Log << DEBUG << "OpenLDAP detected." << endl;
+
+	// Set LDAP_OPT_X_KEEPALIVE_INTERVAL using 'tcp_keepalive_interval' configuration parameter.
+
+		Log << DEBUG << "Checking if 'tcp_keepalive_interval' parameter exists... ";
+
+		if( Cfg.Exists( "tcp_keepalive_interval" ) )
+		{
+			Log << "Yes." << endl;
+			Log << DEBUG << "The value of 'tcp_keepalive_interval' is: '" << Cfg.GetValue( "tcp_keepalive_interval" ) << "'"
+			             << endl;
+
+			try
+			{
+				IntegerValue = stoi( Cfg.GetValue( "tcp_keepalive_interval" ) );
+			}
+			catch( invalid_argument& Exception )
+			{
+				ErrorOccurred = true;
+				Log << WARNING << "Value of 'tcp_keepalive_interval' parameter cannot be parsed. '" << Exception.what() << "' : "
+				               << ErrnoToString( EINVAL ) << ". Attempting to continue." << endl;
+			}
+			catch( out_of_range& Exception )
+			{
+				ErrorOccurred = true;
+				Log << WARNING << "Value of 'tcp_keepalive_interval' parameter cannot be parsed. '" << Exception.what() << "' : "
+				               << ErrnoToString( ERANGE ) << ". Attempting to continue." << endl;
+			}
+			catch( exception& Exception )
+			{
+				ErrorOccurred = true;
+				Log << WARNING << "Value of 'tcp_keepalive_interval' parameter cannot be parsed. '" << Exception.what() << "' "
+				                  "threw an unhandled exception. Attempting to continue." << endl;
+			}
+
+			if( !ErrorOccurred )
+			{
+				if( ( ErrorCode = ldap_set_option( Interface,
+				                                   LDAP_OPT_X_KEEPALIVE_INTERVAL,
+				                                   &IntegerValue ) ) != LDAP_SUCCESS )
+				{
+					Log << WARNING << "ldap_set_option( TCP_KEEPALIVE_INTERVAL ): " << ldap_err2string( ErrorCode ) << ". "
+					                  "Attempting to continue." << endl;
+				}
+				else
+				{
+					Log << INFORMATION << "ldap_set_option( TCP_KEEPALIVE_INTERVAL ): Success." << endl;
+				}
+			}
+			else
+			{
+				ErrorOccurred = false;
+			}
+		}
+		else
+		{
+			Log << "No." << endl;
+		}
+
+	// Set LDAP_OPT_X_KEEPALIVE_IDLE using 'tcp_keepalive_idle' configuration parameter.
+
+		Log << DEBUG << "Checking if 'tcp_keepalive_idle' parameter exists... ";
+
+		if( Cfg.Exists( "tcp_keepalive_idle" ) )
+		{
+			Log << "Yes." << endl;
+			Log << DEBUG << "The value of 'tcp_keepalive_idle' is: '" << Cfg.GetValue( "tcp_keepalive_idle" ) << "'" << endl;
+
+			try
+			{
+				IntegerValue = stoi( Cfg.GetValue( "tcp_keepalive_idle" ));
+			}
+			catch( invalid_argument& Exception )
+			{
+				ErrorOccurred = true;
+				Log << WARNING << "Value of 'tcp_keepalive_idle' parameter cannot be parsed. '" << Exception.what() << "' : "
+				               << ErrnoToString( EINVAL ) << ". Attempting to continue." << endl;
+			}
+			catch( out_of_range& Exception )
+			{
+				ErrorOccurred = true;
+				Log << WARNING << "Value of 'tcp_keepalive_idle' parameter cannot be parsed. '" << Exception.what() << "' : "
+				               << ErrnoToString( ERANGE ) << ". Attempting to continue." << endl;
+			}
+			catch( exception& Exception )
+			{
+				ErrorOccurred = true;
+				Log << WARNING << "Value of 'tcp_keepalive_idle' parameter cannot be parsed. '" << Exception.what() << "' "
+				                  "threw an unhandled exception. Attempting to continue." << endl;
+			}
+
+			if( !ErrorOccurred )
+			{
+				if( ( ErrorCode = ldap_set_option( Interface,
+				                                   LDAP_OPT_X_KEEPALIVE_IDLE,
+				                                   &IntegerValue ) ) != LDAP_SUCCESS ) 
+				{
+					Log << WARNING << "ldap_set_option( TCP_KEEPALIVE_IDLE ): " << ldap_err2string( ErrorCode ) << ". "
+					                  "Attempting to continue." << endl;
+				}
+				else
+				{
+					Log << INFORMATION << "ldap_set_option( TCP_KEEPALIVE_IDLE ): Success." << endl;
+				}
+			}
+			else
+			{
+				ErrorOccurred = false;
+			}
+		}
+		else
+		{
+			Log << "No." << endl;
+		}
+
+	// Set LDAP_OPT_X_KEEPALIVE_PROBES using 'tcp_keepalive_probes' configuration parameter.
+
+		Log << DEBUG << "Checking if 'tcp_keepalive_probes' parameter exists... ";
+
+		if( Cfg.Exists( "tcp_keepalive_probes" ) )
+		{
+			Log << "Yes." << endl;
+			Log << DEBUG << "The value of 'tcp_keepalive_probes' is: '" << Cfg.GetValue( "tcp_keepalive_probes" ) << "'" << endl;
+
+			try
+			{
+				IntegerValue = stoi( Cfg.GetValue( "tcp_keepalive_probes" ) );
+			}
+			catch( invalid_argument& Exception )
+			{
+				ErrorOccurred = true;
+				Log << WARNING << "Value of 'tcp_keepalive_probes' parameter cannot be parsed. '" << Exception.what() << "' : "
+				               << ErrnoToString( EINVAL ) << ". Attempting to continue." << endl;
+			}
+			catch( out_of_range& Exception )
+			{
+				ErrorOccurred = true;
+				Log << WARNING << "Value of 'tcp_keepalive_probes' parameter cannot be parsed. '" << Exception.what() << "' : "
+				               << ErrnoToString( ERANGE ) << ". Attempting to continue." << endl;
+			}
+			catch( exception& Exception )
+			{
+				ErrorOccurred = true;
+				Log << WARNING << "Value of 'tcp_keepalive_probes' parameter cannot be parsed. '" << Exception.what() << "' "
+				                  "threw an unhandled exception. Attempting to continue." << endl;
+			}
+
+			if( !ErrorOccurred )
+			{
+				if( ( ErrorCode = ldap_set_option( Interface,
+				                                   LDAP_OPT_X_KEEPALIVE_PROBES,
+				                                   &IntegerValue ) ) != LDAP_SUCCESS )
+				{
+					Log << WARNING << "ldap_set_option( TCP_KEEPALIVE_PROBES ): " << ldap_err2string( ErrorCode ) << ". "
+					                  "Attempting to continue." << endl;
+				}
+				else
+				{
+					Log << INFORMATION << "ldap_set_option( TCP_KEEPALIVE_PROBES ): Success." << endl;
+				}
+			}
+			else
+			{
+				ErrorOccurred = false;
+			}
+		}
+		else
+		{
+			Log << "No." << endl;
+		}
+
+	// Set LDAP_OPT_TIMEOUT using 'bind_timelimit' configuration parameter.
+
+		Log << DEBUG << "Checking if 'bind_timelimit' parameter exists... ";
+		
+		if( Cfg.Exists( "bind_timelimit" ) )
+		{
+			Log << "Yes." << endl;
+			Log << DEBUG << "The value of 'bind_timelimit' is: '" << Cfg.GetValue( "bind_timelimit" ) << "'" << endl;
+
+			try
+			{
+				Seconds.tv_sec = stoi( Cfg.GetValue( "bind_timelimit" ) );
+			}
+			catch( invalid_argument& Exception )
+			{
+				ErrorOccurred = true;
+				Log << WARNING << "Value of 'bind_timelimit' parameter cannot be parsed. '" << Exception.what() << "' : "
+				               << ErrnoToString( EINVAL ) << ". Attempting to continue." << endl;
+			}
+			catch( out_of_range& Exception )
+			{
+				ErrorOccurred = true;
+				Log << WARNING << "Value of 'bind_timelimit' parameter cannot be parsed. '" << Exception.what() << "' : "
+				               << ErrnoToString( ERANGE ) << ". Attempting to continue." << endl;
+			}
+			catch( exception& Exception )
+			{
+				ErrorOccurred = true;
+				Log << WARNING << "Value of 'bind_timelimit' parameter cannot be parsed. '" << Exception.what() << "' threw "
+				                  "an unhandled exception. Attempting to continue." << endl;
+			}
+
+			if( !ErrorOccurred )
+			{
+				if( ( ErrorCode = ldap_set_option( Interface, LDAP_OPT_TIMEOUT, &Seconds ) ) != LDAP_SUCCESS )
+				{
+					Log << WARNING << "ldap_set_option( BIND_TIMELIMIT ): " << ldap_err2string( ErrorCode ) << ". "
+					                  "Attempting to continue." << endl;
+				}
+				else
+				{
+					Log << INFORMATION << "ldap_set_option( BIND_TIMELIMIT ): Success." << endl;
+				}
+			}
+			else
+			{
+				ErrorOccurred = false;
+			}
+		}
+		else
+		{
+			Log << "No." << endl;
+		}
+
+	// Set LDAP_OPT_NETWORK_TIMEOUT using 'idle_timelimit' configuration parameter.
+
+		Log << DEBUG << "Checking if 'idle_timelimit' parameter exists... ";
+		
+		if( Cfg.Exists( "idle_timelimit" ) )
+		{
+			Log << "Yes." << endl;
+			Log << DEBUG << "The value of 'idle_timelimit' is: '" << Cfg.GetValue( "idle_timelimit" ) << "'" << endl;
+
+			try
+			{
+				Seconds.tv_sec = stoi( Cfg.GetValue( "idle_timelimit" ) );
+			}
+			catch( invalid_argument& Exception )
+			{
+				ErrorOccurred = true;
+				Log << WARNING << "Value of 'idle_timelimit' parameter cannot be parsed. '" << Exception.what() << "' : "
+				               << ErrnoToString( EINVAL ) << ". Attempting to continue." << endl;
+			}
+			catch( out_of_range& Exception )
+			{
+				ErrorOccurred = true;
+				Log << WARNING << "Value of 'idle_timelimit' parameter cannot be parsed. '" << Exception.what() << "' : "
+				               << ErrnoToString( ERANGE ) << ". Attempting to continue." << endl;
+			}
+			catch( exception& Exception )
+			{
+				ErrorOccurred = true;
+				Log << WARNING << "Value of 'idle_timelimit' parameter cannot be parsed. '" << Exception.what() << "' threw "
+				                  "an unhandled exception. Attempting to continue." << endl;
+			}
+
+			if( !ErrorOccurred )
+			{
+				if( ( ErrorCode = ldap_set_option( Interface, LDAP_OPT_NETWORK_TIMEOUT, &Seconds ) ) != LDAP_SUCCESS )
+				{
+					Log << WARNING << "ldap_set_option( IDLE_TIMELIMIT ): " << ldap_err2string( ErrorCode ) << ". "
+					                  "Attempting to continue." << endl;
+				}
+				else
+				{
+					Log << INFORMATION << "ldap_set_option( IDLE_TIMELIMIT ): Success." << endl;
+				}
+			}
+			else
+			{
+				ErrorOccurred = false;
+			}
+		}
+		else
+		{
+			Log << "No." << endl;
+		}
+
+	// End of OpenLDAP specific configuration parameters.
+
+#				endif
+
+	// Start connecting to a single plain 'ldap' URI here, after the options applied as the socket is created, so the handshake runs
+	// while the remaining options and the TLS files are processed. StartTLS builds its TLS context once the connection is up, so the
+	// TLS options still apply to it. With several URIs the connection is made on first use instead, so libldap can still fail over
+	// from a server that cannot be reached.
+
+		if( ( URIs.size() == 1 ) && ( !Dialed ) && ( strncasecmp( URIs[ 0 ].c_str(), "ldap:", 5 ) == 0 ) )
+			ConnectAsync();
+
+	// Set LDAP_OPT_TIMELIMIT using 'timelimit' configuration parameter.
+
+		Log << DEBUG << "Checking if 'timelimit' parameter exists... ";
+		
+		if( Cfg.Exists( "timelimit" ) )
+		{
+			Log << "Yes." << endl;
+			Log << DEBUG << "The value of 'timelimit' is: '" << Cfg.GetValue( "timelimit" ) << "'" << endl;
+
+			try
+			{
+				IntegerValue = stoi( Cfg.GetValue( "timelimit" ) );
+			}
+			catch( invalid_argument& Exception )
+			{
+				ErrorOccurred = true;
+				Log << WARNING << "Value of 'timelimit' parameter cannot be parsed. '" << Exception.what() << "' : "
+				               << ErrnoToString( EINVAL ) << ". Attempting to continue." << endl;
+			}
+			catch( out_of_range& Exception )
+			{
+				ErrorOccurred = true;
+				Log << WARNING << "Value of 'timelimit' parameter cannot be parsed. '" << Exception.what() << "' : "
+						<< ErrnoToString( ERANGE ) << ". Attempting to continue." << endl;
+			}
+			catch( exception& Exception )
+			{
+				ErrorOccurred = true;
+				Log << WARNING << "Value of 'timelimit' parameter cannot be parsed. '" << Exception.what() << "' threw "
+							"an unhandled exception. Attempting to continue." << endl;
+			}
+
+			if( !ErrorOccurred )
+			{
+				if( ( ErrorCode = ldap_set_option( Interface, LDAP_OPT_TIMELIMIT, &IntegerValue ) ) != LDAP_SUCCESS )
+				{
+					Log << WARNING << "ldap_set_option( TIMELIMIT ): " << ldap_err2string( ErrorCode ) << ". "
+								"Attempting to continue." << endl;
+				}
+				else
+				{
+					Log << INFORMATION << "ldap_set_option( TIMELIMIT ): Success." << endl;
+				}
+			}
+			else
+			{
+				ErrorOccurred = false;
+			}
+		}
+		else
+		{
+			Log << "No." << endl;
+		}
+
+	// Set LDAP_OPT_X_TLS_CACERTDIR using 'tls_cacertdir' configuration parameter.
+
+		Log << DEBUG << "Checking if 'tls_cacertdir' parameter exists... ";
+
+		if( Cfg.Exists( "tls_cacertdir" ) )
+		{
+			Log << "Yes." << endl;
+			Log << DEBUG << "The value of 'tls_cacertdir' is: '" << Cfg.GetValue( "tls_cacertdir" ) << "'" << endl;
+			Log << DEBUG << "Checking if '" << Cfg.GetValue( "tls_cacertdir" ) << "' exists...";
+
+			if( ACCESS_F( Cfg.GetValue( "tls_cacertfile" ).c_str() ) )
+			{
+				Log << "Yes." << endl;
+				Log << DEBUG << "Checking if '" << Cfg.GetValue( "tls_cacertdir" ) << "' is searchable...";
+
+				if( ACCESS_X( Cfg.GetValue( "tls_cacertfile" ).c_str() ) )
+				{
+					Log << "Yes." << endl;
+
+					if( ( ErrorCode = ldap_set_option( Interface,
+					                                   LDAP_OPT_X_TLS_CACERTDIR,
+					                                   Cfg.GetValue( "tls_cacertdir" ).c_str() ) ) != LDAP_SUCCESS )
+					{
+						Log << WARNING << "ldap_set_option( TLS_CACERTDIR ): " << ldap_err2string( ErrorCode ) << ". "
+						                  "Attempting to continue." << endl;
+					}
+					else
+					{
+						Log << INFORMATION << "ldap_set_option( TLS_CACERTDIR ): Success." << endl;
+					}
+				}
+				else
+				{
+					Log << "No." << endl;
+					Log << WARNING << "ldap_set_option( TLS_CACERTDIR ): " << ErrnoToString() << ". Attempting to "
+					                  "continue." << endl;
+				}
+			}
+			else
+			{
+				Log << "No." << endl;
+				Log << WARNING << "ldap_set_option( TLS_CACERTDIR ): " << ErrnoToString() << ". Attempting to continue."
+				               << endl;
+			}
+		}
+		else
+		{
+			Log << "No." << endl;
+		}
+
+	// Set LDAP_OPT_X_TLS_CACERTFILE using 'tls_cacertfile' configuration parameter.
+
+		Log << DEBUG << "Checking if 'tls_cacertfile' parameter exists... ";
+
+		if( Cfg.Exists( "tls_cacertfile" ) )
+		{
+			Log << "Yes." << endl;
+			Log << DEBUG << "The value of 'tls_cacertfile' is: '" << Cfg.GetValue( "tls_cacertfile" ) << "'" << endl;
+			Log << DEBUG << "Checking if '" << Cfg.GetValue( "tls_cacertfile" ) << "' exists...";
+
+			if( ACCESS_F( Cfg.GetValue( "tls_cacertfile" ).c_str() ) )
+			{
+				Log << "Yes." << endl;
+				Log << DEBUG << "Checking if '" << Cfg.GetValue( "tls_cacertfile" ) << "' is readable...";
+
+				if( ACCESS_R( Cfg.GetValue( "tls_cacertfile" ).c_str() ) )
+				{
+					Log << "Yes." << endl;
+
+					if( ( ErrorCode = ldap_set_option( Interface,
+					                                   LDAP_OPT_X_TLS_CACERTFILE,
+					                                   Cfg.GetValue( "tls_cacertfile" ).c_str() ) ) != LDAP_SUCCESS )
+					{
+						Log << WARNING << "ldap_set_option( TLS_CACERTFILE ): " << ldap_err2string( ErrorCode ) << ". "
+						                  "Attempting to continue." << endl;
+					}
+					else
+					{
+						Log << INFORMATION << "ldap_set_option( TLS_CACERTFILE ): Success." << endl;
+					}
+				}
+				else
+				{
+					Log << "No." << endl;
+					Log << WARNING << "ldap_set_option( TLS_CACERTFILE ): " << ErrnoToString() << ". Attempting to "
+					                  "continue." << endl;
+				}
+			}
+			else
+			{
+				Log << "No." << endl;
+				Log << WARNING << "ldap_set_option( TLS_CACERTFILE ): " << ErrnoToString() << ". Attempting to continue."
+				               << endl;
+			}
+		}
+		else
+		{
+			Log << "No." << endl;
+		}
+
+	// Set LDAP_OPT_X_TLS_CERTFILE using 'tls_cert' configuration parameter.
+
+		Log << DEBUG << "Checking if 'tls_cert' parameter exists... ";
+
+		if( Cfg.Exists( "tls_cert" ) )
+		{
+			Log << "Yes." << endl;
+			Log << DEBUG << "The value of 'tls_cert' is: '" << Cfg.GetValue( "tls_cert" ) << "'" << endl;
+			Log << DEBUG << "Checking if '" << Cfg.GetValue( "tls_cert" ) << "' exists... "; 
+
+			if( ACCESS_F( Cfg.GetValue( "tls_cert" ).c_str() ) )
+			{
+				Log << "Yes." << endl;
+				Log << DEBUG << "Checking if '" << Cfg.GetValue( "tls_cert" ) << "' is readable...";
+
+				if( ACCESS_R( Cfg.GetValue( "tls_cert" ).c_str() ) )
+				{
+					Log << "Yes." << endl;
+
+					if( ( ErrorCode = ldap_set_option( Interface,
+					                                   LDAP_OPT_X_TLS_CERTFILE,
+					                                   Cfg.GetValue( "tls_cert" ).c_str() ) ) != LDAP_SUCCESS )
+					{
+						Log << WARNING << "ldap_set_option( TLS_CERT ): " << ldap_err2string( ErrorCode ) << ". "
+						                  "Attempting to continue." << endl;
+					}
+					else
+					{
+						Log << INFORMATION << "ldap_set_option( TLS_CERT ): Success." << endl;
+					}
+				}
+				else
+				{
+					Log << "No." << endl;
+					Log << WARNING << "ldap_set_option( TLS_CERT ): " << ErrnoToString() << ". Attempting to continue."
+					               << endl;
+				}
+			}
+			else
+			{
+				Log << "No." << endl;
+				Log << WARNING << "ldap_set_option( TLS_CERT ): " << ErrnoToString() << ". Attempting to continue." << endl;
+			}
+		}
+		else
+		{
+			Log << "No." << endl;
+		}
+
+	// Set LDAP_OPT_X_TLS_KEYFILE using 'tls_key' configuration parameter.
+
+		Log << DEBUG << "Checking if 'tls_key' parameter exists... ";
+
+		if( Cfg.Exists( "tls_key" ) )
+		{
+			Log << "Yes." << endl;
+			Log << DEBUG << "The value of 'tls_key' is: '" << Cfg.GetValue( "tls_key" ) << "'" << endl;
+			Log << DEBUG << "Checking if '" << Cfg.GetValue( "tls_key" ) << "' exists... "; 
+
+			if( ACCESS_F( Cfg.GetValue( "tls_key" ).c_str() ) )
+			{
+				Log << "Yes." << endl;
+				Log << DEBUG << "Checking if '" << Cfg.GetValue( "tls_key" ) << "' is readable...";
+
+				if( ACCESS_R( Cfg.GetValue( "tls_key" ).c_str() ) )
+				{
+					Log << "Yes." << endl;
+
+					if( ( ErrorCode = ldap_set_option( Interface,
+					                                   LDAP_OPT_X_TLS_KEYFILE,
+					                                   Cfg.GetValue( "tls_key" ).c_str() ) ) != LDAP_SUCCESS )
+					{
+						Log << WARNING << "ldap_set_option( TLS_KEY ): " << ldap_err2string( ErrorCode ) << ". "
+						                  "Attempting to continue." << endl;
+					}
+					else
+					{
+						Log << INFORMATION << "ldap_set_option( TLS_KEY ): Success." << endl;
+					}
+				}
+				else
+				{
+					Log << "No." << endl;
+					Log << WARNING << "ldap_set_option( TLS_KEY ): " << ErrnoToString() << ". Attempting to continue."
+					               << endl;
+				}
+			}
+			else
+			{
+				Log << "No." << endl;
+				Log << WARNING << "ldap_set_option( TLS_KEY ): " << ErrnoToString() << ". Attempting to continue." << endl;
+			}
+		}
+		else
+		{
+			Log << "No." << endl;
+		}
+
+	// Set LDAP_OPT_X_TLS_CIPHER_SUITE using 'tls_ciphers' configuration parameter.
+
+		Log << DEBUG << "Checking if 'tls_ciphers' parameter exists... ";
+
+		if( Cfg.Exists( "tls_ciphers" ) )
+		{
+			Log << "Yes." << endl;
+			Log << DEBUG << "The value of 'tls_ciphers' is: '" << Cfg.GetValue( "tls_ciphers" ) << "'" << endl;
+
+			if( ( ErrorCode = ldap_set_option( Interface,
+			                                   LDAP_OPT_X_TLS_CIPHER_SUITE,
+			                                   Cfg.GetValue( "tls_ciphers" ).c_str() ) ) != LDAP_SUCCESS )
+			{
+				Log << WARNING << "ldap_set_option( TLS_CIPHERS ): " << ldap_err2string( ErrorCode ) << ". Attempting to "
+				                  "continue." << endl;
+			}
+			else
+			{
+				Log << INFORMATION << "ldap_set_option( TLS_CIPHERS ): Success." << endl;
+			}
+		}
+		else
+		{
+			Log << "No." << endl;
+		}
+
+	// Set LDAP_OPT_X_TLS_DHFILE using 'tls_dhfile' configuration parameter.
+
+		Log << DEBUG << "Checking if 'tls_dhfile' parameter exists... ";
+
+		if( Cfg.Exists( "tls_dhfile" ) )
+		{
+			Log << "Yes." << endl;
+			Log << DEBUG << "The value of 'tls_dhfile' is: '" << Cfg.GetValue( "tls_dhfile" ) << "'" << endl;
+			Log << DEBUG << "Checking if '" << Cfg.GetValue( "tls_dhfile" ) << "' exists... "; 
+
+			if( ACCESS_F( Cfg.GetValue( "tls_dhfile" ).c_str() ) )
+			{
+				Log << "Yes." << endl;
+				Log << DEBUG << "Checking if '" << Cfg.GetValue( "tls_dhfile" ) << "' is readable...";
+
+				if( ACCESS_R( Cfg.GetValue( "tls_dhfile" ).c_str() ) )
+				{
+					Log << "Yes." << endl;
+
+					if( ( ErrorCode = ldap_set_option( Interface,
+					                                   LDAP_OPT_X_TLS_DHFILE,
+					                                   Cfg.GetValue( "tls_dhfile" ).c_str() ) ) != LDAP_SUCCESS )
+					{
+						Log << WARNING << "ldap_set_option( TLS_DHFILE ): " << ldap_err2string( ErrorCode ) << ". "
+						                  "Attempting to continue." << endl;
+					}
+					else
+					{
+						Log << INFORMATION << "ldap_set_option( TLS_DHFILE ): Success." << endl;
+					}
+				}
+				else
+				{
+					Log << "No." << endl;
+					Log << WARNING << "ldap_set_option( TLS_DHFILE ): " << ErrnoToString() << ". Attempting to continue."
+					               << endl;
+				}
+			}
+			else
+			{
+				Log << "No." << endl;
+				Log << WARNING << "ldap_set_option( TLS_DHFILE ): " << ErrnoToString() << ". Attempting to continue."
+				               << endl;
+			}
+		}
+		else
+		{
+			Log << "No." << endl;
+		}
+
+	// Set LDAP_OPT_X_TLS_RANDOM_FILE using 'tls_randfile' configuration parameter.
+
+		Log << DEBUG << "Checking if 'tls_randfile' parameter exists... ";
+
+		if( Cfg.Exists( "tls_randfile" ) )
+		{
+			Log << "Yes." << endl;
+			Log << DEBUG << "The value of 'tls_randfile' is: '" << Cfg.GetValue( "tls_randfile" ) << "'" << endl;
+			Log << DEBUG << "Checking if '" << Cfg.GetValue( "tls_randfile" ) << "' exists... ";
+
+			if( ACCESS_F( Cfg.GetValue( "tls_randfile" ).c_str() ) )
+			{
+				Log << "Yes." << endl;
+				Log << DEBUG << "Checking if '" << Cfg.GetValue( "tls_randfile" ) << "' is readable... ";
+
+				if( ACCESS_R( Cfg.GetValue( "tls_randfile" ).c_str() ) )
+				{
+					Log << "Yes." << endl;
+
+					if( ( ErrorCode = ldap_set_option( Interface,
+					                                   LDAP_OPT_X_TLS_RANDOM_FILE,
+					                                   Cfg.GetValue( "tls_randfile" ).c_str() ) ) != LDAP_SUCCESS )
+					{
+						Log << WARNING << "ldap_set_option( TLS_RANDFILE ): " << ldap_err2string( ErrorCode ) << ". "
+						                  "Attempting to continue." << endl;
+					}
+					else
+					{
+						Log << INFORMATION << "ldap_set_option( TLS_RANDFILE ): Success." << endl;
+					}
+				}
+				else
+				{
+					Log << "No." << endl;
+					Log << WARNING << "ldap_set_option( TLS_RANDFILE ): " << ErrnoToString() << ". Attempting to "
+					                  "continue." << endl;
+				}
+			}
+			else
+			{
+				Log << "No." << endl;
+				Log << WARNING << "ldap_set_option( TLS_RANDFILE ): " << ErrnoToString() << ". Attempting to continue."
+				               << endl;
+			}
+		}
+		else
+		{
+			Log << "No." << endl;
+		}
+
+	// Set LDAP_OPT_X_TLS_REQUIRE_CERT using 'tls_reqcert' configuration parameter.
+
+		Log << DEBUG << "Checking if 'tls_reqcert' parameter exists... ";
+
+		if( Cfg.Exists( "tls_reqcert" ) )
+		{
+			Log << "Yes." << endl;
+			Log << DEBUG << "The value of 'tls_reqcert' is: '" << Cfg.GetValue( "tls_reqcert" ) << "'" << endl;
+
+			StringValue = Cfg.GetValue( "tls_reqcert" );
+
+			try
+			{
+				transform( StringValue.begin(), StringValue.end(), StringValue.begin(), ::tolower );
+			}
+			catch( bad_alloc& Exception )
+			{
+				ErrorOccurred = true;
+				Log << WARNING << "Value of 'tls_reqcert' parameter cannot be parsed. '" << Exception.what() << "' : " 
+				               << ErrnoToString( ENOMEM ) << ". Attempting to continue." << endl;
+			}
+			catch( exception& Exception )
+			{
+				ErrorOccurred = true;
+				Log << WARNING << "Value of 'tls_reqcert' parameter cannot be parsed. '" << Exception.what() << "' threw an"
+				                  "unhandled exception. Attempting to continue." << endl;
+			}
+
+			if( !ErrorOccurred )
+			{
+				if( StringValue == "never" )
+				{
+					IntegerValue = LDAP_OPT_X_TLS_NEVER;
+				}
+				else if( StringValue == "allow" )
+				{
+					IntegerValue = LDAP_OPT_X_TLS_ALLOW;
+				}
+				else if( StringValue == "try" )
+				{
+					IntegerValue = LDAP_OPT_X_TLS_TRY;
+				}
+				else if( StringValue == "demand" )
+				{
+					IntegerValue = LDAP_OPT_X_TLS_DEMAND;
+				}
+				else if( StringValue == "hard" )
+				{
+					IntegerValue = LDAP_OPT_X_TLS_HARD;
+				}
+				else
+				{
+					ErrorOccurred = true;
+					Log << WARNING << "Value of 'tls_reqcert' parameter is invalid. Attempting to continue." << endl;
+				}
+
+				if( !ErrorOccurred )
+				{
+					if( ( ErrorCode = ldap_set_option( Interface,
+					                                   LDAP_OPT_X_TLS_REQUIRE_CERT,
+					                                   &IntegerValue ) ) != LDAP_SUCCESS )
+					{
+						Log << WARNING << "ldap_set_option( TLS_REQCERT ): " << ldap_err2string( ErrorCode ) << ". "
+						                  "Attempting to continue." << endl;
+					}
+					else
+					{
+						Log << INFORMATION << "ldap_set_option( TLS_REQCERT ): Success." << endl;
+					}
+				}
+				else
+				{
+					ErrorOccurred = false;
+				}
+			}
+			else
+			{
+				ErrorOccurred = false;
+			}
+		}
+		else
+		{
+			Log << "No." << endl;
+		}
+
+	// Set LDAP_OPT_X_TLS_CRLCHECK using 'tls_crlcheck' configuration parameter.
+
+		Log << DEBUG << "Checking if 'tls_crlcheck' parameter exists... ";
+
+		if( Cfg.Exists( "tls_crlcheck" ) )
+		{
+			Log << "Yes." << endl;
+			Log << DEBUG << "The value of 'tls_crlcheck' is: '" << Cfg.GetValue( "tls_crlcheck" ) << "'" << endl;
+
+			StringValue = Cfg.GetValue( "tls_crlcheck" );
+
+			try
+			{
+				transform( StringValue.begin(), StringValue.end(), StringValue.begin(), ::tolower );
+			}
+			catch( bad_alloc& Exception )
+			{
+				ErrorOccurred = true;
+				Log << WARNING << "Value of 'tls_crlcheck' parameter cannot be parsed. '" << Exception.what() << "' : "
+				               << ErrnoToString( ENOMEM ) << ". Attempting to continue." << endl;
+			}
+			catch( exception& Exception )
+			{
+				ErrorOccurred = true;
+				Log << WARNING << "Value of 'tls_crlcheck' parameter cannot be parsed. '" << Exception.what() << "' threw an"
+				                  "unhandled exception. Attempting to continue." << endl;
+			}
+
+			if( !ErrorOccurred )
+			{
+				if( StringValue == "none" )
+				{
+					IntegerValue = LDAP_OPT_X_TLS_CRL_NONE;
+				}
+				else if( StringValue == "peer" )
+				{
+					IntegerValue = LDAP_OPT_X_TLS_CRL_PEER;
+				}
+				else if( StringValue == "all" )
+				{
+					IntegerValue = LDAP_OPT_X_TLS_CRL_ALL;
+				}
+				else
+				{
+					ErrorOccurred = true;
+					Log << WARNING << "Value of 'tls_crlcheck' parameter is invalid. Attempting to continue." << endl;
+				}
+
+				if( !ErrorOccurred )
+				{
+					if( ( ErrorCode = ldap_set_option( Interface,
+					                                   LDAP_OPT_X_TLS_CRLCHECK,
+					                                   &IntegerValue ) ) != LDAP_SUCCESS )
+					{
+						Log << WARNING << "ldap_set_option( TLS_CRLCHECK ): " << ldap_err2string( ErrorCode ) << ". "
+						                  "Attempting to continue." << endl;
+					}
+					else
+					{
+						Log << INFORMATION << "ldap_set_option( TLS_REQCERT ): Success." << endl;
+					}
+				}
+				else
+				{
+					ErrorOccurred = false;
+				}
+			}
+			else
+			{
+				ErrorOccurred = false;
+			}
+		}
+		else
+		{
+			Log << "No." << endl;
+		}
+
+	// Start connecting to any other single URI now that the TLS options are set, since an 'ldaps' connection builds its TLS context
+	// from them as it connects. A connection made at a cached address is open already.
+
+		if( ( URIs.size() == 1 ) && ( !Dialed ) && ( strncasecmp( URIs[ 0 ].c_str(), "ldap:", 5 ) != 0 ) )
+			ConnectAsync();
+}
+
+void KeyLookup::Connect()
+{
+	// Create local variables.
+
+		bool ErrorOccurred = false;
+		int ErrorCode;
+		string ErrorMessage;
+		string StringValue;
+		char* ErrorMessageBuffer = nullptr;
+		BerValue Credentials = { 0, nullptr };
+
+	// Keep a bound connection for the lifetime of this object, and wait for a turn to use it.
+
+		Limit.Acquire();
+
+		if( Bound )
+			return;
+
+		Open();
+
+	// Start TLS on a connection to an 'ldaps' URI made at a cached address, now that the TLS options are set. The server's certificate
+	// is checked against the URI's host name.
+
+		if( InstallTLS )
+		{
+			InstallTLS = false;
+
+			if( ( ErrorCode = ldap_install_tls( Interface ) ) != LDAP_SUCCESS )
+			{
+				Disconnect();
+
+				throw runtime_error( string( "ldap_install_tls(): " ) + ldap_err2string( ErrorCode ) );
+			}
+		}
+
+	// Upgrade to TLS connection if 'start_tls' configuration parameter is set to a variation of 'true'.
+
+		Log << DEBUG << "Checking if 'start_tls' parameter exists... ";
+
+		if( Cfg.Exists( "start_tls" ) )
+		{
+			Log << "Yes." << endl;
+			Log << DEBUG << "The value of 'start_tls' is: '" << Cfg.GetValue( "start_tls" ) << "'" << endl;
+			Log << DEBUG << "Checking if 'start_tls' parameter is a variation of 'true'... ";
+
+			StringValue = Cfg.GetValue( "start_tls" );
+
+			try
+			{
+				transform( StringValue.begin(), StringValue.end(), StringValue.begin(), ::tolower );
+			}
+			catch( bad_alloc& Exception )
+			{
+				ErrorOccurred = true;
+				Log << endl << WARNING << "Value of 'start_tls' parameter cannot be parsed. '" << Exception.what() << "' : "
+				                       << ErrnoToString( ENOMEM ) << ". Attempting to continue." << endl;
+			}
+			catch( exception& Exception )
+			{
+				ErrorOccurred = true;
+				Log << endl << WARNING << "Value of 'start_tls' parameter cannot be parsed. '" << Exception.what() << "' threw"
+				                          " an unhandled exception. Attempting to continue." << endl;
+			}
+
+			if( !ErrorOccurred )
+			{
+				if( ( StringValue == "true" ) ||
+				    ( StringValue == "t" ) ||
+				    ( StringValue == "yes" ) ||
+				    ( StringValue == "y" ) ||
+				    ( StringValue == "enable" ) ||
+				    ( StringValue == "enabled ") ||
+				    ( StringValue == "on" ) )
+				{
+					Log << "Yes." << endl;
+
+					ErrorCode = ldap_start_tls_s( Interface, nullptr, nullptr );
+
+					if( ErrorCode != LDAP_SUCCESS )
+					{
+						ldap_get_option( Interface, LDAP_OPT_DIAGNOSTIC_MESSAGE, &ErrorMessageBuffer );
+
+						if( ErrorMessageBuffer != nullptr )
+						{
+							ErrorMessage = ErrorMessageBuffer;
+							LDAPMemFree( ErrorMessageBuffer );
+						}
+
+						Disconnect();
+
+						throw runtime_error( string( "ldap_start_tls_s(): " ) + ldap_err2string( ErrorCode ) + " : " + ErrorMessage );
+					}
+					else
+					{
+						Log << INFORMATION << "ldap_start_tls_s(): Success." << endl;
+
+						StartTLS = true;
+					}
+				}
+				else
+				{
+					Log << "No." << endl;
+				}
+			}
+			else
+			{
+				ErrorOccurred = false;
+			}
+		}
+		else
+		{
+			Log << "No." << endl;
+		}
+
+	// Bind with SASL EXTERNAL if the 'sasl_mech' configuration parameter is set to 'EXTERNAL', using the credentials supplied via
+	// 'binddn' and 'bindpw' configuration parameters otherwise, or anonymous bind.
+
+		// TODO: Add options for SASL mechanisms other than EXTERNAL. Also Kerberos.
+		if( BindMechanism == "EXTERNAL" )
+		{
+			Log << INFORMATION << "Attempting SASL EXTERNAL bind..." << endl;
+
+			Credentials.bv_val = const_cast< char* >( BindPassword.c_str() );
+			Credentials.bv_len = BindPassword.length();
+
+			ErrorCode = Bind( nullptr, BindMechanism.c_str(), &Credentials );
+		}
+		else
+		{
+			Log << DEBUG << "Checking if 'binddn' parameter exists... ";
+
+			if( Cfg.Exists( "binddn" ) )
+			{
+				Log << "Yes." << endl;
+				Log << DEBUG << "The value of 'binddn' is: '" << Cfg.GetValue( "binddn" ) << "'" << endl;
+				Log << DEBUG << "Checking if 'bindpw' parameter exists... ";
+
+				if( Cfg.Exists( "bindpw" ) )
+				{
+					Log << "Yes." << endl;
+					Log << DEBUG << "The value of 'bindpw' is: " << Cfg.GetValue( "bindpw" ) << endl;
+					Log << DEBUG << "Note: Please redact the 'bindpw' value when submitting logs (it also appears in the "
+					                "configuration dump above)." << endl;
+					Log << INFORMATION << "Attempting authenticated bind..." << endl;
+
+					BindDN = Cfg.GetValue( "binddn" );
+					BindPassword = Cfg.GetValue( "bindpw" );
+					Credentials.bv_val = const_cast< char* >( BindPassword.c_str() );
+					Credentials.bv_len = BindPassword.length();
+
+					ErrorCode = Bind( BindDN.c_str(), LDAP_SASL_SIMPLE, &Credentials );
+				}
+				else
+				{
+					Log << "No." << endl;
+
+					ErrorCode = LDAP_INVALID_CREDENTIALS;
+				}
+			}
+			else
+			{
+				Log << "No." << endl;
+				Log << INFORMATION << "Attempting anonymous bind..." << endl;
+
+				ErrorCode = Bind( nullptr, LDAP_SASL_SIMPLE, &Credentials );
+			}
+		}
+
+	// On bind error, close the connection and throw.
+
+		if( ErrorCode != LDAP_SUCCESS )
+		{
+			Disconnect();
+
+			throw runtime_error( string( "ldap_sasl_bind_s(): " ) + ldap_err2string( ErrorCode ) );
+		}
+		else
+		{
+			Log << INFORMATION << "ldap_sasl_bind_s(): Success." << endl;
+
+			Bound = true;
+		}
+}
+
+void KeyLookup::Disconnect()
+{
+	// Unbind and close the connection if one is open.
+
+		if( Interface != nullptr )
+		{
+			LDAPClose( Interface );
+		}
+
+		Bound = false;
+}
+
+void KeyLookup::ConnectAsync()
+{
+
+#				if defined( LDAP_API_FEATURE_X_OPENLDAP ) && defined( LDAP_OPT_CONNECT_ASYNC ) && ( LDAP_VENDOR_VERSION >= 20500 )
+
+	// Create local variables.
+
+		int ErrorCode;
+		int IntegerValue = 0;
+
+	// Start connecting to the server without waiting for the handshake; the first operation waits for it. An 'ldaps' connection's
+	// TLS context is built from this handle's options, in case another handle created one first.
+
+		Log << DEBUG << "Connecting to: '" << URIs[ 0 ] << "' asynchronously... ";
+
+		if( ( ( strncasecmp( URIs[ 0 ].c_str(), "ldaps:", 6 ) == 0 ) &&
+		      ( ( ErrorCode = ldap_set_option( Interface, LDAP_OPT_X_TLS_NEWCTX, &IntegerValue ) ) != LDAP_OPT_SUCCESS ) ) ||
+		    ( ( ErrorCode = ldap_set_option( Interface, LDAP_OPT_CONNECT_ASYNC, LDAP_OPT_ON ) ) != LDAP_OPT_SUCCESS ) ||
+		    ( ( ErrorCode = ldap_connect( Interface ) ) != LDAP_SUCCESS ) )
+		{
+			Log << "Failed." << endl;
+			Log << DEBUG << "ldap_connect(): " << ldap_err2string( ErrorCode ) << ". Connecting on first use." << endl;
+		}
+		else
+		{
+			Log << "Started." << endl;
+		}
+
+#				endif
+
+}
+
+int KeyLookup::Bind( const char* DN, const char* Mechanism, BerValue* Credentials )
+{
+	// Create local variables.
+
+		int ReturnValue;
+		int MessageID;
+		LDAPMessage* Response = nullptr;
+
+	// Send the bind request and wait for its result, watching the caller while the server answers.
+
+		if( ( ReturnValue = ldap_sasl_bind( Interface, DN, Mechanism, Credentials, nullptr, nullptr, &MessageID ) ) != LDAP_SUCCESS )
+			return ReturnValue;
+
+		ReturnValue = Await( MessageID, Response );
+
+		if( Response != nullptr )
+		{
+			LDAPMsgFree( Response );
+		}
+
+	// Return ReturnValue.
+
+		return ReturnValue;
+}
+
+int KeyLookup::Await( const int MessageID, LDAPMessage*& Response )
+{
+	// Create local variables.
+
+		int ReturnValue = LDAP_SUCCESS;
+
+	// Wait for the complete result of an operation and return its result code. An operation that does not complete within the time
+	// limit is abandoned, as the synchronous calls do.
+
+		switch( Caller.Wait( Interface, MessageID, LDAP_MSG_ALL, Response ) )
+		{
+			case -1:
+			{
+				ldap_get_option( Interface, LDAP_OPT_RESULT_CODE, &ReturnValue );
+
+				break;
+			}
+			case 0:
+			{
+				ldap_abandon_ext( Interface, MessageID, nullptr, nullptr );
+
+				ReturnValue = LDAP_TIMEOUT;
+
+				break;
+			}
+			default:
+			{
+				if( ldap_parse_result( Interface, Response, &ReturnValue, nullptr, nullptr, nullptr, nullptr, 0 ) != LDAP_SUCCESS )
+					ldap_get_option( Interface, LDAP_OPT_RESULT_CODE, &ReturnValue );
+
+				break;
+			}
+		}
+
+	// Return ReturnValue.
+
+		return ReturnValue;
+}
+
+int KeyLookup::Search( const string& Base, const int SearchScope, const string& Filter, char** Attributes, const int SizeLimit,
+                       LDAPMessage*& Response )
+{
+	// Create local variables.
+
+		int ReturnValue;
+		int MessageID;
+
+	// Search over the open connection, opening it first if needed. A connection the server has closed since the last lookup is
+	// reopened once and the search repeated.
+
+		for( int Attempt = 0; ; Attempt++ )
+		{
+			Connect();
+
+			Response = nullptr;
+
+			ReturnValue = ldap_search_ext( Interface,
+			                               Base.c_str(),
+			                               SearchScope,
+			                               Filter.c_str(),
+			                               Attributes,
+			                               0,
+			                               ValueRules.GetControls(),
+			                               nullptr,
+			                               nullptr,
+			                               SizeLimit,
+			                               &MessageID );
+
+			if( ReturnValue == LDAP_SUCCESS )
+				ReturnValue = Await( MessageID, Response );
+
+			if( ( ReturnValue != LDAP_SERVER_DOWN ) || ( Attempt != 0 ) )
+				break;
+
+			if( Response != nullptr )
+			{
+				LDAPMsgFree( Response );
+			}
+
+			Log << NOTICE << "ldap_search_ext_s(): " << ldap_err2string( ReturnValue ) << ". Reconnecting." << endl;
+
+			Disconnect();
+		}
+
+	// Return ReturnValue.
+
+		return ReturnValue;
+}
+
+void KeyLookup::ReadCSN()
+{
+	// Create local variables.
+
+		int ErrorCode;
+		int ValueIndex;
+		string StringValue;
+		char* CSNAttributes[] = { ( char* ) "contextCSN", ( char* ) "modifyTimestamp", nullptr };
+		BerValue** Values = nullptr;
+		LDAPMessage* Entry = nullptr;
+		LDAPMessage* Response = nullptr;
+
+	// Read the naming context's CSN with one base-scope search. The 'contextCSN' values are used where available, otherwise
+	// 'modifyTimestamp'. The CSN is read before the user's entry, so a change made in between is seen as a CSN change on the next
+	// lookup rather than missed.
+
+		Connect();
+
+		CurrentCSN.clear();
+		StringValue = ( Cfg.Exists( "cache_csn_base" ) ? Cfg.GetValue( "cache_csn_base" ) : Cfg.GetValue( "base" ) );
+
+		Log << DEBUG << "Reading CSN of: '" << StringValue << "'... ";
+
+		ErrorCode = Search( StringValue, LDAP_SCOPE_BASE, "(objectClass=*)", CSNAttributes, 1, Response );
+
+		Log << "Finished." << endl;
+
+		if( ( ErrorCode == LDAP_SUCCESS ) && ( ( Entry = ldap_first_entry( Interface, Response ) ) != nullptr ) )
+		{
+			if( ( Values = ldap_get_values_len( Interface, Entry, "contextCSN" ) ) == nullptr )
+				Values = ldap_get_values_len( Interface, Entry, "modifyTimestamp" );
+
+			if( Values != nullptr )
+			{
+				vector< string > CSNValues;
+
+				for( ValueIndex = 0; ValueIndex < ldap_count_values_len( Values ); ValueIndex++ )
+					CSNValues.push_back( string( Values[ ValueIndex ]->bv_val, Values[ ValueIndex ]->bv_len ) );
+
+				sort( CSNValues.begin(), CSNValues.end() );
+
+				for( const string& CSNValue : CSNValues )
+					CurrentCSN += ( CurrentCSN.empty() ? "" : " " ) + CSNValue;
+
+				LDAPValueFreeLen( Values );
+			}
+		}
+		else if( ErrorCode != LDAP_SUCCESS )
+		{
+			Log << WARNING << "ldap_search_ext_s( CSN ): " << ldap_err2string( ErrorCode ) << ". Attempting to continue." << endl;
+		}
+
+		if( Response != nullptr )
+		{
+			LDAPMsgFree( Response );
+		}
+
+		if( CurrentCSN.empty() )
+		{
+			Log << WARNING << "Cannot read 'contextCSN' or 'modifyTimestamp' of: '" << StringValue << "'. Cached keys will not be "
+			                  "used." << endl;
+		}
+		else
+		{
+			Log << DEBUG << "The current CSN is: '" << CurrentCSN << "'" << endl;
+
+			try
+			{
+				KeyCache.StoreCSN( CurrentCSN );
+			}
+			catch( ios_base::failure& Exception )
+			{
+				Log << WARNING << "Cannot store CSN. '" << Exception.what() << "' : " << ErrnoToString() << ". Attempting to "
+				                  "continue." << endl;
+			}
+		}
+}
+
+bool KeyLookup::LookupMembers( const string& GroupDN, Result& Keys, unsigned& Findings )
+{
+	// Create local variables.
+
+		int ErrorCode;
+		int MessageID;
+		size_t Next = 0;
+		size_t EntryCount = 0;
+		const char* Denied;
+		string Chunk;
+		string Member;
+		string AnyUser = ExpandFilter( FilterTemplate, "*" );
+		vector< string > Members;
+		vector< string > Filters;
+		vector< string > EntryKeys;
+		set< string > Seen;
+		set< int > InFlight;
+		char* GroupAttributes[] = { const_cast< char* >( MemberAttribute.c_str() ), nullptr };
+		vector< char* > AttributeList( 1, const_cast< char* >( AttributeName.c_str() ) );
+		struct berval EntryName = { 0, nullptr };
+		LDAPMessage* Response = nullptr;
+		LDAPMessage* Message = nullptr;
+
+	// Read the members of the group. Return false if there is no such group.
+
+		Log << DEBUG << "Reading the members of: '" << GroupDN << "'... ";
+
+		ErrorCode = Search( GroupDN, LDAP_SCOPE_BASE, "(objectClass=*)", GroupAttributes, 1, Response );
+
+		Log << "Finished." << endl;
+
+		if( ( ErrorCode == LDAP_NO_SUCH_OBJECT ) || ( ( ErrorCode == LDAP_SUCCESS ) && ( ldap_count_entries( Interface, Response ) == 0 ) ) )
+		{
+			if( Response != nullptr )
+				LDAPMsgFree( Response );
+
+			Log << INFORMATION << "No shared account group: '" << GroupDN << "'." << endl;
+
+			return false;
+		}
+		else if( ErrorCode != LDAP_SUCCESS )
+		{
+			if( Response != nullptr )
+				LDAPMsgFree( Response );
+
+			throw runtime_error( string( "ldap_search_ext_s(): " ) + ldap_err2string( ErrorCode ) );
+		}
+
+		DecodeEntry( Interface, ldap_first_entry( Interface, Response ), EntryName, [ & ]( const struct berval& Name, BerVarray Values )
+		{
+			if( ( Values != nullptr ) && IsAttribute( Name, MemberAttribute ) )
+			{
+				for( ; Values->bv_val != nullptr; Values++ )
+					Members.emplace_back( Values->bv_val, Values->bv_len );
+			}
+		} );
+
+		Keys.DN.assign( EntryName.bv_val, EntryName.bv_len );
+
+		LDAPMsgFree( Response );
+
+	// Build one OR filter for each chunk of 'MemberChunkSize' members. A member given as a DN is matched by 'MemberDNAttribute' and
+	// must also match the filter for any user, so the filter's constraints and this host's scope apply to it as well; any other
+	// member is a username, matched by the filter.
+
+		if( AnyUser[ 0 ] != '(' )
+			AnyUser = "(" + AnyUser + ")";
+
+		for( size_t Index = 0; Index < Members.size(); Index++ )
+		{
+			if( Members[ Index ].find( '=' ) != string::npos )
+			{
+				Chunk += "(&(" + MemberDNAttribute + "=" + EscapeFilterValue( Members[ Index ] ) + ")" + AnyUser + ")";
+			}
+			else if( IsValidUsername( Members[ Index ] ) )
+			{
+				Member = ExpandFilter( FilterTemplate, Members[ Index ] );
+				Chunk += ( Member[ 0 ] == '(' ) ? Member : ( "(" + Member + ")" );
+			}
+			else
+			{
+				Log << WARNING << "Invalid member of: '" << GroupDN << "': '" << Members[ Index ] << "'. Skipping." << endl;
+			}
+
+			if( ( ( ( Index + 1 ) % MemberChunkSize ) == 0 ) || ( ( Index + 1 ) == Members.size() ) )
+			{
+				if( !Chunk.empty() )
+					Filters.push_back( "(|" + Chunk + ")" );
+
+				Chunk.clear();
+			}
+		}
+
+		Log << DEBUG << "Searching for " << Members.size() << " members in " << Filters.size() << " chunks." << endl;
+
+	// Keep up to 'PipelineDepth' chunk searches outstanding on the connection, requesting only the keys and the attributes the account
+	// checks read. The keys of every member the checks allow are merged in the order they arrive, without duplicates. On an error, the
+	// searches still outstanding are abandoned so their results cannot reach later searches on the connection.
+
+		for( string& Attribute : Account.GetAttributes() )
+			AttributeList.push_back( const_cast< char* >( Attribute.c_str() ) );
+
+		AttributeList.push_back( nullptr );
+
+		while( ( Next < Filters.size() ) || ( !InFlight.empty() ) )
+		{
+			while( ( Next < Filters.size() ) && ( InFlight.size() < PipelineDepth ) )
+			{
+				ErrorCode = ldap_search_ext( Interface, Cfg.GetValue( "base" ).c_str(), Scope, Filters[ Next ].c_str(), AttributeList.data(), 0,
+				                             ValueRules.GetControls(), nullptr, nullptr, LDAP_NO_LIMIT, &MessageID );
+
+				if( ErrorCode != LDAP_SUCCESS )
+					break;
+
+				InFlight.insert( MessageID );
+				Next++;
+			}
+
+			if( ( ErrorCode == LDAP_SUCCESS ) && ( Caller.Wait( Interface, LDAP_RES_ANY, LDAP_MSG_ONE, Message ) <= 0 ) )
+			{
+				ldap_get_option( Interface, LDAP_OPT_RESULT_CODE, &ErrorCode );
+				Message = nullptr;
+			}
+
+			if( ( Message != nullptr ) && ( ldap_msgtype( Message ) == LDAP_RES_SEARCH_ENTRY ) )
+			{
+				unsigned EntryFindings = 0;
+
+				EntryKeys.clear();
+
+				DecodeEntry( Interface, Message, EntryName, [ & ]( const struct berval& Name, BerVarray Values )
+				{
+					if( ( Values != nullptr ) && IsAttribute( Name, AttributeName ) )
+					{
+						for( ; Values->bv_val != nullptr; Values++ )
+						{
+							string_view Value( Values->bv_val, Values->bv_len );
+
+							if( ValueRules.Select( Value ) )
+								EntryKeys.emplace_back( Value );
+						}
+					}
+					else
+					{
+						EntryFindings |= Account.Inspect( Name, Values );
+					}
+				} );
+
+				if( ( Denied = Account.Deny( EntryFindings ) ) != nullptr )
+				{
+					Log << DEBUG << "Skipping member: '" << string( EntryName.bv_val, EntryName.bv_len ) << "' (" << Denied << ")." << endl;
+				}
+				else
+				{
+					for( string& Key : EntryKeys )
+					{
+						if( Seen.insert( Key ).second )
+							Keys.Keys.push_back( move( Key ) );
+					}
+				}
+
+				Findings |= EntryFindings;
+				EntryCount++;
+			}
+			else if( ( Message != nullptr ) && ( ldap_msgtype( Message ) == LDAP_RES_SEARCH_RESULT ) )
+			{
+				ldap_parse_result( Interface, Message, &ErrorCode, nullptr, nullptr, nullptr, nullptr, 0 );
+				InFlight.erase( ldap_msgid( Message ) );
+			}
+
+			if( Message != nullptr )
+				LDAPMsgFree( Message );
+
+			if( ErrorCode != LDAP_SUCCESS )
+			{
+				for( const int Outstanding : InFlight )
+					ldap_abandon_ext( Interface, Outstanding, nullptr, nullptr );
+
+				throw runtime_error( string( "Cannot search for members of: '" ) + GroupDN + "' : " + ldap_err2string( ErrorCode ) );
+			}
+		}
+
+		Log << DEBUG << "Found " << Keys.Keys.size() << " keys in " << EntryCount << " member entries." << endl;
+
+	// Return true.
+
+		return true;
+}
+
+uint64_t KeyLookup::GetFingerprint( const string& Username )
+{
+	// Create local variables.
+
+		map< string, string >::iterator SharedAccount = SharedAccounts.find( Username );
+
+	// Return the fingerprint of the settings a user's keys are selected under. A shared account's keys also depend on its group and
+	// on how the group's members are found.
+
+		if( SharedAccount == SharedAccounts.end() )
+			return RulesFingerprint;
+
+		return Hash( to_string( RulesFingerprint ) + "\ngroup " + SharedAccount->second + "\nmember_attribute " + MemberAttribute +
+		             "\nmember_dn_attribute " + MemberDNAttribute + '\n' );
+}
+
+void KeyLookup::Admit( const vector< string >& Usernames, const bool Predicted )
+{
+	// Admit the users to the cache policy and remove the records of the users it evicts in exchange.
+
+		try
+		{
+			Policy.Open( KeyCache.GetDirectory(), CacheSize );
+
+			for( const string& Current : Usernames )
+			{
+				if( Predicted )
+					Policy.Predict( Current );
+
+				Policy.Admit( Current );
+			}
+
+			for( const string& Evicted : Policy.TakeEvictions() )
+			{
+				Log << DEBUG << "Evicting user: " << Evicted << " from the cache." << endl;
+
+				KeyCache.Remove( Evicted );
+			}
+
+			Policy.Close();
+		}
+		catch( ios_base::failure& Exception )
+		{
+			Policy.Close();
+
+			Log << WARNING << "Cannot update cache policy. '" << Exception.what() << "' : " << ErrnoToString() << ". "
+			                  "Attempting to continue." << endl;
+		}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// End of 'KeyLookup.cpp'
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
\ No newline at end of file
@@ -0,0 +1,746 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// KeyServer.cpp
+// Matthew J. Schultz | Created : 31OCT17 | Last Modified : 31OCT17 by Matthew J. Schultz
+// Version : 0.0.1
+// This is the source file for the 'KeyServer' class of 'LSSHKeys', which answers lookups over a Unix socket from a long-running process.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2017 QuantuMatriX Software, a QuantuMatriX Technologies Cooperative Partnership.
+//
+// This file is part of 'LSSHKeys'.
+//
+// 'LSSHKeys' is free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any later version.
+//
+// 'LSSHKeys' is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License along with 'LSSHKeys'.  If not, see <http://www.gnu.org/licenses/>.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Header Files
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "../include/LSSHKeys.hpp"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The 'KeyServer' Class
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Constructor
+
+KeyServer::KeyServer( Config& Configuration, Output& Log ) : Cfg( Configuration ), Log( Log )
+{
+	// Set field values.
+
+		ThreadCount = 4;
+		ReplyTimeout = 10;
+		Listener = -1;
+		Events = -1;
+		Completions = -1;
+		Signals = -1;
+		ServerUser = 0;
+		Stopping = false;
+
+	// Read the path of the server's Unix socket from the 'server_socket' configuration parameter.
+
+		Log << DEBUG << "Checking if 'server_socket' parameter exists... ";
+
+		if( Cfg.Exists( "server_socket" ) )
+		{
+			Log << "Yes." << std::endl;
+			Log << DEBUG << "The value of 'server_socket' is: '" << Cfg.GetValue( "server_socket" ) << "'" << std::endl;
+
+			SocketPath = Cfg.GetValue( "server_socket" );
+		}
+		else
+		{
+			Log << "No." << std::endl;
+		}
+
+	// Read the account the server runs as from the 'server_user' configuration parameter. Clients only trust a server run by this
+	// account, by root or by themselves.
+
+		Log << DEBUG << "Checking if 'server_user' parameter exists... ";
+
+		if( Cfg.Exists( "server_user" ) )
+		{
+			Log << "Yes." << std::endl;
+			Log << DEBUG << "The value of 'server_user' is: '" << Cfg.GetValue( "server_user" ) << "'" << std::endl;
+
+			struct passwd* Account = getpwnam( Cfg.GetValue( "server_user" ).c_str() );
+
+			if( Account != nullptr )
+				ServerUser = Account->pw_uid;
+			else
+				Log << WARNING << "Value of 'server_user' parameter invalid. No such user: '" << Cfg.GetValue( "server_user" )
+				               << "'. Trusting only servers run by root or the current user." << std::endl;
+		}
+		else
+		{
+			Log << "No." << std::endl;
+		}
+
+	// Read the number of worker threads running lookups from the 'server_threads' configuration parameter.
+
+		Log << DEBUG << "Checking if 'server_threads' parameter exists... ";
+
+		if( Cfg.Exists( "server_threads" ) )
+		{
+			Log << "Yes." << std::endl;
+			Log << DEBUG << "The value of 'server_threads' is: '" << Cfg.GetValue( "server_threads" ) << "'" << std::endl;
+
+			try
+			{
+				ThreadCount = std::max( std::stoul( Cfg.GetValue( "server_threads" ) ), 1ul );
+			}
+			catch( std::exception& Exception )
+			{
+				Log << WARNING << "Value of 'server_threads' parameter cannot be parsed. '" << Exception.what() << "' : "
+				               << Utility::ErrnoToString( EINVAL ) << ". Defaulting to 'server_threads' = '4'." << std::endl;
+
+				ThreadCount = 4;
+			}
+		}
+		else
+		{
+			Log << "No." << std::endl;
+			Log << DEBUG << "Defaulting to 'server_threads' = '4'." << std::endl;
+		}
+
+	// Read how many seconds a lookup of a single user waits for the server from the 'server_timeout' configuration parameter.
+
+		Log << DEBUG << "Checking if 'server_timeout' parameter exists... ";
+
+		if( Cfg.Exists( "server_timeout" ) )
+		{
+			Log << "Yes." << std::endl;
+			Log << DEBUG << "The value of 'server_timeout' is: '" << Cfg.GetValue( "server_timeout" ) << "'" << std::endl;
+
+			try
+			{
+				ReplyTimeout = std::max( std::stoi( Cfg.GetValue( "server_timeout" ) ), 1 );
+			}
+			catch( std::exception& Exception )
+			{
+				Log << WARNING << "Value of 'server_timeout' parameter cannot be parsed. '" << Exception.what() << "' : "
+				               << Utility::ErrnoToString( EINVAL ) << ". Defaulting to 'server_timeout' = '10'." << std::endl;
+
+				ReplyTimeout = 10;
+			}
+		}
+		else
+		{
+			Log << "No." << std::endl;
+			Log << DEBUG << "Defaulting to 'server_timeout' = '10'." << std::endl;
+		}
+}
+
+// Destructor
+
+KeyServer::~KeyServer()
+{
+	// Stop the workers if Run() left them running because it failed, then close the descriptors still open.
+
+#				if defined( __linux__ )
+
+		Stop();
+
+#				endif
+
+		for( std::pair< const int, Client >& Current : Clients )
+			close( Current.first );
+
+		for( int Descriptor : { Listener, Events, Completions, Signals } )
+		{
+			if( Descriptor != -1 )
+				close( Descriptor );
+		}
+}
+
+// Public Methods
+
+bool KeyServer::IsConfigured()
+{
+	// Return true if a server socket is configured.
+
+		return ( !SocketPath.empty() );
+}
+
+bool KeyServer::Ask( const std::string& Username, std::string& Reply )
+{
+	// Create local variables.
+
+		int Descriptor;
+		int Remaining;
+		ssize_t Size = 0;
+		uid_t PeerUser = -1;
+		char Buffer[ 4096 ];
+		std::string Request = Username + "\n";
+		std::string Directory = SocketPath;
+		struct stat Status;
+		struct sockaddr_un Address = {};
+		struct timeval SendLimit = { ReplyTimeout, 0 };
+		struct pollfd Poll;
+		std::chrono::steady_clock::time_point Deadline = std::chrono::steady_clock::now() + std::chrono::seconds( ReplyTimeout );
+
+	// Send the username to a running server and read its reply until the server closes the connection. Return false if no server
+	// answers within 'server_timeout' seconds, so the caller looks the user up itself.
+
+		if( SocketPath.empty() || ( SocketPath.size() >= sizeof( Address.sun_path ) ) )
+			return false;
+
+		if( lstat( SocketPath.c_str(), &Status ) != 0 )
+		{
+			Log << DEBUG << "Cannot reach server at: '" << SocketPath << "' : " << Utility::ErrnoToString() << "." << std::endl;
+
+			return false;
+		}
+
+	// The keys are only taken from a trusted server, one run by root, by 'server_user' or by this user. Its socket must belong to such
+	// a user and not be writable by others, and so must the directory holding it unless the directory is sticky, so no one else can
+	// put their own socket in its place.
+
+		if( ( !S_ISSOCK( Status.st_mode ) ) || ( !IsTrusted( Status.st_uid ) ) || ( Status.st_mode & S_IWOTH ) ||
+		    ( stat( dirname( &Directory[ 0 ] ), &Status ) != 0 ) || ( !IsTrusted( Status.st_uid ) ) ||
+		    ( ( Status.st_mode & ( S_IWGRP | S_IWOTH ) ) && ( !( Status.st_mode & S_ISVTX ) ) ) )
+		{
+			Log << WARNING << "Not asking server at: '" << SocketPath << "'. The socket or its directory may be replaced by an untrusted user."
+			               << std::endl;
+
+			return false;
+		}
+
+		Address.sun_family = AF_UNIX;
+		SocketPath.copy( Address.sun_path, SocketPath.size() );
+
+		if( ( Descriptor = socket( AF_UNIX, ( SOCK_STREAM | SOCK_CLOEXEC ), 0 ) ) == -1 )
+			return false;
+
+	// A server whose backlog is full would hold connect() and the request indefinitely, so both are bounded by a send timeout.
+
+		if( ( setsockopt( Descriptor, SOL_SOCKET, SO_SNDTIMEO, &SendLimit, sizeof( SendLimit ) ) != 0 ) ||
+		    ( connect( Descriptor, ( struct sockaddr* ) &Address, sizeof( Address ) ) != 0 ) ||
+		    ( !Utility::WriteAll( Descriptor, Request ) ) )
+		{
+			Log << DEBUG << "Cannot reach server at: '" << SocketPath << "' : " << Utility::ErrnoToString() << "." << std::endl;
+
+			close( Descriptor );
+
+			return false;
+		}
+
+	// Check who is listening, in case the socket was replaced after it was checked.
+
+#				if defined( __linux__ )
+
+		struct ucred Peer;
+		socklen_t PeerSize = sizeof( Peer );
+
+		if( getsockopt( Descriptor, SOL_SOCKET, SO_PEERCRED, &Peer, &PeerSize ) == 0 )
+			PeerUser = Peer.uid;
+
+#				else
+
+		gid_t PeerGroup;
+
+		if( getpeereid( Descriptor, &PeerUser, &PeerGroup ) != 0 )
+			PeerUser = -1;
+
+#				endif
+
+		if( !IsTrusted( PeerUser ) )
+		{
+			Log << WARNING << "Not asking server at: '" << SocketPath << "'. It is run by untrusted user: " << PeerUser << "." << std::endl;
+
+			close( Descriptor );
+
+			return false;
+		}
+
+	// Read the reply until the server closes the connection, giving up once the deadline passes.
+
+		Reply.clear();
+
+		Poll = { Descriptor, POLLIN, 0 };
+
+		for( ; ; )
+		{
+			Remaining = std::chrono::duration_cast< std::chrono::milliseconds >( Deadline - std::chrono::steady_clock::now() ).count();
+
+			if( ( Remaining <= 0 ) || ( ( Size = poll( &Poll, 1, Remaining ) ) == 0 ) )
+			{
+				Log << WARNING << "Server at: '" << SocketPath << "' did not answer within " << ReplyTimeout << " seconds. Looking the user "
+				                  "up directly." << std::endl;
+
+				close( Descriptor );
+
+				return false;
+			}
+
+			if( ( Size != -1 ) && ( ( Size = read( Descriptor, Buffer, sizeof( Buffer ) ) ) > 0 ) )
+				Reply.append( Buffer, Size );
+			else if( ( Size == 0 ) || ( errno != EINTR ) )
+				break;
+		}
+
+		close( Descriptor );
+
+		if( Size == -1 )
+		{
+			Log << WARNING << "Cannot read reply from server at: '" << SocketPath << "' : " << Utility::ErrnoToString() << "." << std::endl;
+
+			return false;
+		}
+
+	// The reply starts with a status byte: '+' when the server looked the user up, followed by the user's block of keys, which is
+	// empty for a user without keys, or '!' when the lookup failed.
+
+		if( Reply.empty() || ( Reply[ 0 ] != '+' ) )
+		{
+			Log << WARNING << "Server at: '" << SocketPath << "' cannot look up user: " << Username << ". Looking the user up directly."
+			               << std::endl;
+
+			return false;
+		}
+
+		Reply.erase( 0, 1 );
+
+	// Return true.
+
+		return true;
+}
+
+void KeyServer::Run()
+{
+
+#				if defined( __linux__ )
+
+	// Create local variables.
+
+		int EventCount;
+		sigset_t StopSignals;
+		struct signalfd_siginfo Signal;
+		struct epoll_event Event = {};
+		std::vector< struct epoll_event > Ready( 256 );
+
+	// Server mode needs a socket to listen on.
+
+		if( SocketPath.empty() )
+			throw std::invalid_argument( "Server mode requires the 'server_socket' parameter" );
+
+	// Take SIGINT and SIGTERM through a descriptor in the event loop instead of as signals, in every thread, and have the completions
+	// of the workers announced through an eventfd, so the loop sleeps in epoll_wait() alone.
+
+		sigemptyset( &StopSignals );
+		sigaddset( &StopSignals, SIGINT );
+		sigaddset( &StopSignals, SIGTERM );
+		pthread_sigmask( SIG_BLOCK, &StopSignals, nullptr );
+
+		if( ( ( Events = epoll_create1( EPOLL_CLOEXEC ) ) == -1 ) ||
+		    ( ( Completions = eventfd( 0, ( EFD_NONBLOCK | EFD_CLOEXEC ) ) ) == -1 ) ||
+		    ( ( Signals = signalfd( -1, &StopSignals, ( SFD_NONBLOCK | SFD_CLOEXEC ) ) ) == -1 ) )
+		{
+			throw std::runtime_error( "Cannot create event loop : " + Utility::ErrnoToString() );
+		}
+
+		Listen();
+
+		for( int Descriptor : { Listener, Completions, Signals } )
+		{
+			Event.events = ( EPOLLIN | EPOLLET );
+			Event.data.fd = Descriptor;
+
+			if( epoll_ctl( Events, EPOLL_CTL_ADD, Descriptor, &Event ) != 0 )
+				throw std::runtime_error( "Cannot create event loop : " + Utility::ErrnoToString() );
+		}
+
+	// Start the workers, each with its own connections to the directories and its own log buffer. Their lookups refresh cached
+	// addresses on threads, not in forked processes.
+
+		AddressCache::UseThreads();
+
+		for( size_t ThreadIndex = 0; ThreadIndex < ThreadCount; ThreadIndex++ )
+			Workers.emplace_back( &KeyServer::Work, this );
+
+		Log << NOTICE << "Serving lookups at: '" << SocketPath << "' with " << ThreadCount << " workers." << std::endl;
+
+	// Wait for events until a stop signal arrives. The descriptors are edge-triggered, so every one that is ready is read, accepted
+	// or written until it would block.
+
+		while( !Stopping )
+		{
+			if( ( EventCount = epoll_wait( Events, Ready.data(), Ready.size(), -1 ) ) == -1 )
+			{
+				if( errno == EINTR )
+					continue;
+
+				throw std::runtime_error( "epoll_wait(): " + Utility::ErrnoToString() );
+			}
+
+			for( int EventIndex = 0; EventIndex < EventCount; EventIndex++ )
+			{
+				int Descriptor = Ready[ EventIndex ].data.fd;
+				uint32_t Flags = Ready[ EventIndex ].events;
+
+				if( Descriptor == Listener )
+				{
+					Accept();
+				}
+				else if( Descriptor == Completions )
+				{
+					Complete();
+				}
+				else if( Descriptor == Signals )
+				{
+					while( read( Signals, &Signal, sizeof( Signal ) ) == sizeof( Signal ) )
+						Stopping = true;
+				}
+				else if( Clients.count( Descriptor ) != 0 )
+				{
+					if( Flags & EPOLLIN )
+						Receive( Descriptor );
+
+					if( ( Clients.count( Descriptor ) != 0 ) && ( Flags & EPOLLOUT ) )
+						Send( Descriptor );
+
+					if( ( Clients.count( Descriptor ) != 0 ) && ( Flags & ( EPOLLHUP | EPOLLERR ) ) )
+						Hangup( Descriptor );
+				}
+			}
+		}
+
+	// Stop the workers once their current lookups finish and remove the socket.
+
+		Log << NOTICE << "Stopping server." << std::endl;
+
+		Stop();
+
+#				else
+
+		throw std::runtime_error( "Server mode is not supported on this platform" );
+
+#				endif
+
+}
+
+// Private Methods
+
+bool KeyServer::IsTrusted( const uid_t User )
+{
+	// Return true for root, 'server_user' and the current user.
+
+		return ( ( User == 0 ) || ( User == ServerUser ) || ( User == getuid() ) );
+}
+
+#				if defined( __linux__ )
+
+void KeyServer::Listen()
+{
+	// Create local variables.
+
+		int Probe;
+		struct sockaddr_un Address = {};
+
+	// Listen on the socket path, replacing a socket left behind by a server that is no longer running, and let the owner's group
+	// connect as well.
+
+		if( SocketPath.size() >= sizeof( Address.sun_path ) )
+			throw std::invalid_argument( "Value of 'server_socket' parameter invalid. Path too long: '" + SocketPath + "'" );
+
+		Address.sun_family = AF_UNIX;
+		SocketPath.copy( Address.sun_path, SocketPath.size() );
+
+		if( ( Probe = socket( AF_UNIX, ( SOCK_STREAM | SOCK_CLOEXEC ), 0 ) ) != -1 )
+		{
+			if( connect( Probe, ( struct sockaddr* ) &Address, sizeof( Address ) ) == 0 )
+			{
+				close( Probe );
+
+				throw std::runtime_error( "A server is already listening at: '" + SocketPath + "'" );
+			}
+
+			close( Probe );
+		}
+
+		unlink( SocketPath.c_str() );
+
+		if( ( ( Listener = socket( AF_UNIX, ( SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC ), 0 ) ) == -1 ) ||
+		    ( bind( Listener, ( struct sockaddr* ) &Address, sizeof( Address ) ) != 0 ) ||
+		    ( chmod( SocketPath.c_str(), ( S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP ) ) != 0 ) ||
+		    ( listen( Listener, SOMAXCONN ) != 0 ) )
+		{
+			throw std::runtime_error( "Cannot listen at: '" + SocketPath + "' : " + Utility::ErrnoToString() );
+		}
+}
+
+void KeyServer::Stop()
+{
+	// Nothing to do unless the workers were started.
+
+		if( Workers.empty() )
+			return;
+
+	// Tell the workers to stop, under their lock so none misses the wakeup, drop the lookups not yet started and wait for the running
+	// ones. Then remove the socket, which is this server's once the workers run.
+
+		{
+			std::lock_guard< std::mutex > Guard( PendingLock );
+
+			Stopping = true;
+			Pending.clear();
+		}
+
+		PendingReady.notify_all();
+
+		for( std::thread& Worker : Workers )
+			Worker.join();
+
+		Workers.clear();
+
+		unlink( SocketPath.c_str() );
+}
+
+void KeyServer::Accept()
+{
+	// Create local variables.
+
+		int Descriptor;
+		struct epoll_event Event = {};
+
+	// Accept every pending connection and watch each for its request and for room to write the reply.
+
+		while( ( Descriptor = accept4( Listener, nullptr, nullptr, ( SOCK_NONBLOCK | SOCK_CLOEXEC ) ) ) != -1 )
+		{
+			Event.events = ( EPOLLIN | EPOLLOUT | EPOLLET );
+			Event.data.fd = Descriptor;
+
+			if( epoll_ctl( Events, EPOLL_CTL_ADD, Descriptor, &Event ) != 0 )
+			{
+				close( Descriptor );
+
+				continue;
+			}
+
+			Clients[ Descriptor ] = Client();
+		}
+
+		if( ( errno != EAGAIN ) && ( errno != EWOULDBLOCK ) && ( errno != EINTR ) )
+			Log << WARNING << "accept4(): " << Utility::ErrnoToString() << ". Attempting to continue." << std::endl;
+}
+
+void KeyServer::Receive( const int Descriptor )
+{
+	// Create local variables.
+
+		ssize_t Size;
+		size_t LineEnd;
+		char Buffer[ 512 ];
+		Client& Current = Clients[ Descriptor ];
+
+	// Read the request, one username ending in a newline, and hand it to the workers. A client that sends an invalid or overlong
+	// request, or closes its end before sending a whole one, is disconnected without a reply.
+
+		while( ( Size = read( Descriptor, Buffer, sizeof( Buffer ) ) ) > 0 )
+		{
+			if( !Current.Busy && !Current.Ready )
+				Current.Request.append( Buffer, Size );
+		}
+
+		if( Current.Busy || Current.Ready )
+			return;
+
+		if( ( LineEnd = Current.Request.find( '\n' ) ) != std::string::npos )
+		{
+			Current.Request.resize( LineEnd );
+
+			if( ( !Current.Request.empty() ) && ( Current.Request.back() == '\r' ) )
+				Current.Request.pop_back();
+
+			if( !Utility::IsValidUsername( Current.Request ) )
+			{
+				Log << WARNING << "Invalid username from client: '" << Current.Request << "'." << std::endl;
+
+				Close( Descriptor );
+
+				return;
+			}
+
+			Current.Busy = true;
+
+			{
+				std::lock_guard< std::mutex > Guard( PendingLock );
+
+				Pending.push_back( { Descriptor, Current.Request, "" } );
+			}
+
+			PendingReady.notify_one();
+		}
+		else if( ( Size == 0 ) || ( Current.Request.size() > sizeof( Buffer ) ) )
+		{
+			Close( Descriptor );
+		}
+}
+
+void KeyServer::Send( const int Descriptor )
+{
+	// Create local variables.
+
+		ssize_t Size;
+		Client& Current = Clients[ Descriptor ];
+
+	// Write as much of the reply as the socket takes, and close the connection once all of it is written.
+
+		if( !Current.Ready )
+			return;
+
+		while( Current.Written < Current.Reply.size() )
+		{
+			if( ( Size = send( Descriptor, Current.Reply.data() + Current.Written, Current.Reply.size() - Current.Written, MSG_NOSIGNAL ) ) == -1 )
+			{
+				if( errno == EINTR )
+					continue;
+
+				if( ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) )
+					return;
+
+				break;
+			}
+
+			Current.Written += Size;
+		}
+
+		Close( Descriptor );
+}
+
+void KeyServer::Hangup( const int Descriptor )
+{
+	// A client that hangs up while its lookup runs is closed when the lookup finishes, so its descriptor cannot be reused by a new
+	// client before the reply is dropped.
+
+		if( Clients[ Descriptor ].Busy )
+			Clients[ Descriptor ].Gone = true;
+		else
+			Close( Descriptor );
+}
+
+void KeyServer::Complete()
+{
+	// Create local variables.
+
+		uint64_t Count;
+		std::vector< Job > Done;
+
+	// Take the finished lookups from the workers, holding their lock only to swap the list, and start sending the replies.
+
+		while( read( Completions, &Count, sizeof( Count ) ) == sizeof( Count ) )
+			;
+
+		{
+			std::lock_guard< std::mutex > Guard( FinishedLock );
+
+			Done.swap( Finished );
+		}
+
+		for( Job& Current : Done )
+		{
+			Client& Owner = Clients[ Current.Descriptor ];
+
+			Owner.Busy = false;
+
+			if( Owner.Gone )
+			{
+				Close( Current.Descriptor );
+
+				continue;
+			}
+
+			Owner.Reply = std::move( Current.Reply );
+			Owner.Ready = true;
+
+			Send( Current.Descriptor );
+		}
+}
+
+void KeyServer::Close( const int Descriptor )
+{
+	// Close the connection, which also removes it from the event loop.
+
+		close( Descriptor );
+		Clients.erase( Descriptor );
+}
+
+void KeyServer::Work()
+{
+	// Create local variables.
+
+		Output WorkerLog;
+		KeyLookup::Result Keys;
+		Job Current;
+		std::unique_ptr< RouteTable > Routes;
+
+	// Log through the server's facility, and create this worker's lookups from the configuration, whose connections stay open
+	// between lookups. A worker that cannot create them answers every lookup with an error.
+
+		WorkerLog.Init( Log );
+
+		try
+		{
+			Routes.reset( new RouteTable( Cfg, WorkerLog ) );
+		}
+		catch( std::exception& Exception )
+		{
+			WorkerLog << ERROR << "Cannot create lookups : " << Exception.what() << ". Answering lookups with an error." << std::endl;
+		}
+
+	// Run the lookups queued by the event loop until the server stops, and hand each result back to it, marked as looked up or as
+	// failed, so the client can look a user up itself when the lookup failed.
+
+		for( ; ; )
+		{
+			{
+				std::unique_lock< std::mutex > Guard( PendingLock );
+
+				PendingReady.wait( Guard, [ & ]() { return ( Stopping || ( !Pending.empty() ) ); } );
+
+				if( Stopping )
+					return;
+
+				Current = std::move( Pending.front() );
+				Pending.pop_front();
+			}
+
+			Current.Reply = "!";
+
+			try
+			{
+				if( Routes != nullptr )
+				{
+					Current.Reply = "+";
+
+					if( Routes->Select( Current.Username ).Lookup( Current.Username, Keys ) )
+						Current.Reply += Keys.Block;
+				}
+			}
+			catch( std::exception& Exception )
+			{
+				WorkerLog << WARNING << "Cannot look up user: " << Current.Username << " : " << Exception.what() << "." << std::endl;
+
+				Current.Reply = "!";
+			}
+
+			{
+				std::lock_guard< std::mutex > Guard( FinishedLock );
+
+				Finished.push_back( std::move( Current ) );
+			}
+
+			eventfd_write( Completions, 1 );
+		}
+}
+
+#				endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// End of 'KeyServer.cpp'
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
\ No newline at end of file
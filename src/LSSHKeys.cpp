@@ -36,103 +36,35 @@ int main( int ArgumentCount, char* ArgumentValues[] )
 
 		bool ArgumentC = false;
 		bool ArgumentD = false;
-		bool ErrorOccurred = false;
+		bool Batch = false;
+		bool Bulk = false;
+		bool CacheStatistics = false;
+		bool Prefetch = false;
+		bool Server = false;
 		int ArgumentIndex;
-		int AttributeCount;
-		int AttributeListLength;
 		int CfgValuesPreProcessed = 0;
-		int ErrorCode;
-		int IntegerValue;
-		int Scope;
-		int ValueIndex;
 		size_t FindPosition;
+		size_t PrefetchCount = 100;
 		string Argument;
 		string ArgumentLower;
-		string AttributeName;
+		string BatchFormat = "json";
 		string CfgFileName;
-		string ErrorMessage;
 		string ExecutedCommand;
-		string Filter;
+		string ExportDirectory;
 		string LogLevelName;
 		string LogMethodName;
+		string PrefetchListName;
 		string StringValue;
 		string Username;
-		struct timeval Seconds;
 		ifstream CfgFile;
 		ofstream LogFile;
 		queue< string > ArgumentQueue;
+		vector< string > PrefetchUsers;
 		Config Cfg;
+		KeyLookup::Result Keys;
 		Output::Method LogMethod;
 		Output::Level LogLevel;
 		Output Log;
-		char* Attribute = nullptr;
-		char** AttributeList = { nullptr };
-		char* ErrorMessageBuffer = nullptr;
-		char* LogFileName = nullptr;
-		BerElement* AttributeIterator = nullptr;
-		BerValue* Credentials = nullptr;
-		BerValue* ServerCredentials = nullptr;
-		BerValue** Values = nullptr;
-		LDAP* LDAPInterface = nullptr;
-		LDAPMessage* Entry = nullptr;
-		LDAPMessage* Response = nullptr;
-
-	// Create a lambda to free memory.
-
-		auto FreeMemory = [ & ]()
-		{
-			if( ErrorMessageBuffer != nullptr )
-			{
-				LDAPMemFree( ErrorMessageBuffer );
-			}
-
-			if( Attribute != nullptr )
-			{
-				LDAPMemFree( Attribute );
-			}
-
-			if( AttributeList != nullptr )
-			{
-				CStringArrayFree( AttributeList, AttributeListLength );
-			}
-
-			if( LogFileName != nullptr )
-			{
-				CStringFree( LogFileName );
-			}
-
-			if( AttributeIterator != nullptr )
-			{
-				BerFree( AttributeIterator );
-			}
-
-			if( Credentials != nullptr )
-			{
-				BerValueFree( Credentials );
-			}
-
-			if( Values != nullptr )
-			{
-				LDAPValueFreeLen( Values );
-			}
-
-			if( Response != nullptr )
-			{
-				LDAPMsgFree( Response );
-			}
-
-			// Entry exists within Response apparently...
-			/*if( Entry != nullptr )
-			{
-				LDAPMsgFree( Entry );
-			}*/
-
-			if( LDAPInterface != nullptr )
-			{
-				LDAPClose( LDAPInterface );
-			}
-
-		};
 
 	// Handle all exceptions not otherwise caught before Output is initialized.
 
@@ -168,6 +100,11 @@ int main( int ArgumentCount, char* ArgumentValues[] )
 						cout << endl;
 						cout << "  -d, --dbg, --debug		Enable debug mode." << endl;
 						cout << "  -c, --conf, --config		Set user defined configuration file." << endl;
+						cout << "  -p, --prefetch[=FILE]		Fetch the most active users' entries into the cache and exit." << endl;
+						cout << "  -e, --export DIR		Write an authorized_keys file for every user to DIR and exit." << endl;
+						cout << "  --cache-stats			Print the cache policy counters and exit." << endl;
+						cout << "  -b, --batch[=json|nul]		Look up the usernames read from stdin, one per line, and exit." << endl;
+						cout << "  -s, --server			Answer lookups on the 'server_socket' until stopped." << endl;
 						cout << endl;
 						cout << "Configuration options may be set in the file: " << CONFIG << "." << endl;
 						cout << "For details about configuration options, please see " << CONFIG_FILE << "(5)." << endl << endl;
@@ -318,6 +255,69 @@ int main( int ArgumentCount, char* ArgumentValues[] )
 						continue;
 					}
 
+					if( ( ArgumentLower.find( "--prefetch" ) == 0 ) || ( ArgumentLower == "-p" ) )
+					{
+						Prefetch = true;
+						FindPosition = Argument.find( '=' );
+
+						if( FindPosition != string::npos )
+							PrefetchListName = Argument.substr( FindPosition + 1 );
+
+						continue;
+					}
+
+					if( ( ArgumentLower.find( "--batch" ) == 0 ) || ( ArgumentLower == "-b" ) )
+					{
+						Batch = true;
+						FindPosition = ArgumentLower.find( '=' );
+
+						if( FindPosition != string::npos )
+							BatchFormat = ArgumentLower.substr( FindPosition + 1 );
+
+						if( ( BatchFormat != "json" ) && ( BatchFormat != "nul" ) )
+						{
+							PreLogCritical( ErrnoToString( EINVAL ) );
+						}
+
+						continue;
+					}
+
+					if( ( ArgumentLower.find( "--export" ) == 0 ) || ( ArgumentLower == "-e" ) )
+					{
+						FindPosition = Argument.find( '=' );
+
+						if( FindPosition != string::npos )
+						{
+							ExportDirectory = Argument.substr( FindPosition + 1 );
+						}
+						else if( ArgumentQueue.size() > 1 )
+						{
+							ArgumentQueue.pop();
+							ExportDirectory = ArgumentQueue.front();
+						}
+
+						if( ExportDirectory.empty() )
+						{
+							PreLogCritical( ErrnoToString( EINVAL ) );
+						}
+
+						continue;
+					}
+
+					if( ( ArgumentLower == "--server" ) || ( ArgumentLower == "-s" ) )
+					{
+						Server = true;
+
+						continue;
+					}
+
+					if( ArgumentLower == "--cache-stats" )
+					{
+						CacheStatistics = true;
+
+						continue;
+					}
+
 					if( ( ArgumentLower == "--debug" ) || ( ArgumentLower == "--dbg" ) || ( ArgumentLower == "-d" ) )
 					{
 						LogMethod = Output::Method::Stdio;
@@ -333,7 +333,7 @@ int main( int ArgumentCount, char* ArgumentValues[] )
 
 					if( ArgumentQueue.size() == 1 )
 					{
-						if( regex_match( Argument, regex( "^[a-z][-a-z0-9]*" ) ) )
+						if( IsValidUsername( Argument ) )
 						{
 							Username = Argument;
 						}
@@ -348,6 +348,13 @@ int main( int ArgumentCount, char* ArgumentValues[] )
 					}
 				}
 
+				Bulk = ( Prefetch || Batch || Server || ( !ExportDirectory.empty() ) );
+
+				if( Username.empty() && ( !Bulk ) && ( !CacheStatistics ) )
+				{
+					PreLogCritical( ErrnoToString( EINVAL ) );
+				}
+
 				if( !ArgumentC )
 				{
 					CfgFileName = CONFIG_FILE;
@@ -451,29 +458,24 @@ int main( int ArgumentCount, char* ArgumentValues[] )
 						{
 							if( errno == ENOENT )
 							{
-								LogFileName = new char[ Cfg.GetValue( "log" ).length() + 1 ];
-								strcpy( LogFileName, Cfg.GetValue( "log" ).c_str() );
+								string LogFileName = Cfg.GetValue( "log" );
 
-								if( ACCESS_F( dirname( LogFileName ) ) )
+								if( ACCESS_F( dirname( &LogFileName[ 0 ] ) ) )
 								{
-									if( ACCESS_W( dirname( LogFileName ) ) )
+									if( ACCESS_W( LogFileName.c_str() ) )
 									{
-										CStringFree( LogFileName );
-
 										LogMethodName = "file: " + Cfg.GetValue( "log" );
 										LogMethod = Output::Method::File;
 										LogFile.open( Cfg.GetValue( "log" ).c_str(), fstream::out );
 									}
 									else
 									{
-										FreeMemory();
-										PreLogCritical( "Cannot open log file for writing : " + ErrnoToString() );
+																	PreLogCritical( "Cannot open log file for writing : " + ErrnoToString() );
 									}
 								}
 								else
 								{
-									FreeMemory();
-									PreLogCritical( "Cannot open log file for writing : " + ErrnoToString() );
+															PreLogCritical( "Cannot open log file for writing : " + ErrnoToString() );
 								}
 							}
 							else
@@ -506,32 +508,26 @@ int main( int ArgumentCount, char* ArgumentValues[] )
 		}
 		catch( out_of_range& Exception )
 		{
-			FreeMemory();
 			PreLogCritical( string( Exception.what() ) + " : " + ErrnoToString( ERANGE ) );
 		}
 		catch( length_error& Exception )
 		{
-			FreeMemory();
 			PreLogCritical( string( Exception.what() ) + " : " + ErrnoToString( EOVERFLOW ) );
 		}
 		catch( ios_base::failure& Exception )
 		{
-			FreeMemory();
 			PreLogCritical( string( Exception.what() ) + " : " + ErrnoToString( EIO ) );
 		}
 		catch( bad_alloc& Exception )
 		{
-			FreeMemory();
 			PreLogCritical( string( Exception.what() ) + " : " + ErrnoToString( ENOMEM ) );
 		}
 		catch( invalid_argument& Exception )
 		{
-			FreeMemory();
 			PreLogCritical( string( Exception.what() ) + " : " + ErrnoToString( EINVAL ) );
 		}
 		catch( exception& Exception )
 		{
-			FreeMemory();
 			PreLogCritical( string( Exception.what() ) + " : " + ErrnoToString( EBADMSG ) );
 		}
 
@@ -545,7 +541,7 @@ int main( int ArgumentCount, char* ArgumentValues[] )
 				{
 					Log << DEBUG << "Configuration values: " << endl;
 					Log << DEBUG << '{' << endl;
-					for( const pair< string, string > &CfgPair : Cfg.GetConfigurationMap() )
+					for( const auto& CfgPair : Cfg.GetConfigurationMap() )
 					{
 						Log << DEBUG << "    '" << CfgPair.first << "' = '" << CfgPair.second << "'" << endl;
 					}
@@ -559,1319 +555,335 @@ int main( int ArgumentCount, char* ArgumentValues[] )
 					Log << CRITICAL << "Not enough configuration parameters found. Aborting." << endl;
 				}
 
+			// In server mode, answer lookups on the configured socket until stopped. Otherwise, for a single user, ask a running server
+			// first and look the user up here only if none answers.
 
-			// Initialize LDAP using 'uri' configuration parameter.
-
-				Log << DEBUG << "Checking if 'uri' parameter exists... ";
+				KeyServer Service( Cfg, Log );
 
-				if( Cfg.Exists( "uri" ) )
+				if( Server )
 				{
-					Log << "Yes." << endl;
-					Log << DEBUG << "The value of 'uri' is: '" << Cfg.GetValue( "uri" ) << "'" << endl;
+					Service.Run();
 
-					if( ( ErrorCode = ldap_initialize( &LDAPInterface, Cfg.GetValue( "uri" ).c_str() ) ) != LDAP_SUCCESS )
-					{
-						FreeMemory();
-						Log << CRITICAL << "ldap_initialize(): " << ldap_err2string( ErrorCode ) << ". Cannot continue." << endl;
-					}
-					else
-					{
-						Log << INFORMATION << "LDAP interface initialized successfully." << endl;
-					}
-				}
-				else
-				{
-					Log << "No." << endl;
-					Log << CRITICAL << "Value of 'uri' parameter undefined." << endl;
+					return EXIT_SUCCESS;
 				}
 
-			// Set LDAP_OPT_PROTOCOL_VERSION using 'ldap_version' configuration parameter.
-
-				Log << DEBUG << "Checking if 'ldap_version' parameter exists... ";
-
-				if( Cfg.Exists( "ldap_version" ) )
+				if( ( !Bulk ) && ( !CacheStatistics ) && Service.IsConfigured() )
 				{
-					Log << "Yes." << endl;
-					Log << DEBUG << "The value of 'ldap_version' is: '" << Cfg.GetValue( "ldap_version" ) << "'" << endl;
-
-					try
-					{
-						IntegerValue = stoi( Cfg.GetValue( "ldap_version" ) );
-					}
-					catch( invalid_argument& Exception )
-					{
-						Log << WARNING << "Value of 'ldap_version' parameter cannot be parsed. '" << Exception.what() << "' : "
-						               << ErrnoToString( EINVAL ) << ". Defaulting to LDAPv3." << endl;
+					string Reply;
 
-						IntegerValue = LDAP_VERSION3;
-					}
-					catch( out_of_range& Exception )
+					if( Service.Ask( Username, Reply ) )
 					{
-						Log << WARNING << "Value of 'ldap_version' parameter cannot be parsed. '" << Exception.what() << "' : "
-						               << ErrnoToString( ERANGE ) << ". Defaulting to LDAPv3." << endl;
+						if( !WriteAll( STDOUT_FILENO, Reply ) )
+							throw ios_base::failure( "Cannot write keys" );
 
-						IntegerValue = LDAP_VERSION3;
+						return EXIT_SUCCESS;
 					}
-					catch( exception& Exception )
-					{
-						Log << WARNING << "Value of 'ldap_version' parameter cannot be parsed. '" << Exception.what() << "' threw an "
-						                  "unhandled exception. Defaulting to LDAPv3." << endl;
+				}
 
-						IntegerValue = LDAP_VERSION3;
-					}
+			// Create the lookups from the configuration, one for the main configuration and one for each profile of the routing table.
+			// The connection to each directory is opened by its first search.
 
-					if( IntegerValue == 2 )
-					{
-						Log << NOTICE << "You are using LDAPv2. Please ensure you intend to use this version and/or consider upgrading"
-						                 " to LDAPv3." << endl;
-						
-						IntegerValue = LDAP_VERSION2;
-					}
-					else if( ( IntegerValue > 3 ) || ( IntegerValue < 2 ) )
-					{
-						Log << WARNING << "Value of 'ldap_version' parameter invalid. Defaulting to LDAPv3." << endl;
+				RouteTable Routes( Cfg, Log );
+				KeyLookup& Directory = Routes.GetDefault();
 
-						IntegerValue = LDAP_VERSION3;
-					}
+			// In cache statistics mode, print the policy counters and exit.
 
-					if( ( ErrorCode = ldap_set_option( LDAPInterface, LDAP_OPT_PROTOCOL_VERSION, &IntegerValue ) ) != LDAP_SUCCESS )
-					{
-						FreeMemory();
-						Log << CRITICAL << "ldap_set_option( LDAP_VERSION ): " << ldap_err2string( ErrorCode ) << ". Cannot continue."
-						                << endl;
-					}
-					else
-					{
-						Log << INFORMATION << "ldap_set_option( LDAP_VERSION ): Success." << endl;
-					}
-				} 
-				else 
+				if( CacheStatistics )
 				{
-					Log << "No. Defaulting to LDAPv3." << endl;
+					unsigned long long Hits = 0;
+					unsigned long long Misses = 0;
 
-					IntegerValue = LDAP_VERSION3;
-
-					if( ( ErrorCode = ldap_set_option( LDAPInterface, LDAP_OPT_PROTOCOL_VERSION, &IntegerValue ) ) != LDAP_SUCCESS ) 
-					{
-						FreeMemory();
-						Log << CRITICAL << "ldap_set_option( LDAP_VERSION ): " << ldap_err2string( ErrorCode ) << ". Cannot continue."
-						                << endl;
-					}
-					else
+					for( const pair< string, unsigned long long >& Statistic : Directory.GetCacheStatistics() )
 					{
-						Log << INFORMATION << "ldap_set_option( LDAP_VERSION ): Success." << endl;
-					}
-				}
+						cout << Statistic.first << ' ' << Statistic.second << endl;
 
-			// OpenLDAP specific configuration parameters. If these are set on any other system, they are ignored.
-
-#				ifdef LDAP_API_FEATURE_X_OPENLDAP
+						if( Statistic.first.find( "_hits" ) != string::npos )
+							Hits += Statistic.second;
+						else if( Statistic.first == "misses" )
+							Misses += Statistic.second;
+					}
 
-				Log << DEBUG << "OpenLDAP detected." << endl;
+					cout << "hit_ratio " << fixed << setprecision( 4 )
+					     << ( ( Hits + Misses ) ? ( ( double ) Hits / ( Hits + Misses ) ) : 0.0 ) << endl;
 
-			// Set LDAP_OPT_X_KEEPALIVE_INTERVAL using 'tcp_keepalive_interval' configuration parameter.
+					return EXIT_SUCCESS;
+				}
 
-				Log << DEBUG << "Checking if 'tcp_keepalive_interval' parameter exists... ";
+			// In prefetch mode, rank users by how often and how recently they log in (from wtmp and lastlog, or from a supplied list of
+			// usernames), fetch the ranked users' entries into the cache and exit.
 
-				if( Cfg.Exists( "tcp_keepalive_interval" ) )
+				if( Prefetch )
 				{
-					Log << "Yes." << endl;
-					Log << DEBUG << "The value of 'tcp_keepalive_interval' is: '" << Cfg.GetValue( "tcp_keepalive_interval" ) << "'"
-					             << endl;
+					LoginHistory History;
 
-					try
-					{
-						IntegerValue = stoi( Cfg.GetValue( "tcp_keepalive_interval" ) );
-					}
-					catch( invalid_argument& Exception )
-					{
-						ErrorOccurred = true;
-						Log << WARNING << "Value of 'tcp_keepalive_interval' parameter cannot be parsed. '" << Exception.what() << "' : "
-						               << ErrnoToString( EINVAL ) << ". Attempting to continue." << endl;
-					}
-					catch( out_of_range& Exception )
-					{
-						ErrorOccurred = true;
-						Log << WARNING << "Value of 'tcp_keepalive_interval' parameter cannot be parsed. '" << Exception.what() << "' : "
-						               << ErrnoToString( ERANGE ) << ". Attempting to continue." << endl;
-					}
-					catch( exception& Exception )
-					{
-						ErrorOccurred = true;
-						Log << WARNING << "Value of 'tcp_keepalive_interval' parameter cannot be parsed. '" << Exception.what() << "' "
-						                  "threw an unhandled exception. Attempting to continue." << endl;
-					}
+					Log << DEBUG << "Checking if 'prefetch_count' parameter exists... ";
 
-					if( !ErrorOccurred )
+					if( Cfg.Exists( "prefetch_count" ) )
 					{
-						if( ( ErrorCode = ldap_set_option( LDAPInterface,
-						                                   LDAP_OPT_X_KEEPALIVE_INTERVAL,
-						                                   &IntegerValue ) ) != LDAP_SUCCESS )
+						Log << "Yes." << endl;
+						Log << DEBUG << "The value of 'prefetch_count' is: '" << Cfg.GetValue( "prefetch_count" ) << "'" << endl;
+
+						try
 						{
-							Log << WARNING << "ldap_set_option( TCP_KEEPALIVE_INTERVAL ): " << ldap_err2string( ErrorCode ) << ". "
-							                  "Attempting to continue." << endl;
+							PrefetchCount = stoul( Cfg.GetValue( "prefetch_count" ) );
 						}
-						else
+						catch( exception& Exception )
 						{
-							Log << INFORMATION << "ldap_set_option( TCP_KEEPALIVE_INTERVAL ): Success." << endl;
+							Log << WARNING << "Value of 'prefetch_count' parameter cannot be parsed. '" << Exception.what() << "' : "
+							               << ErrnoToString( EINVAL ) << ". Defaulting to 100." << endl;
+
+							PrefetchCount = 100;
 						}
 					}
 					else
 					{
-						ErrorOccurred = false;
+						Log << "No." << endl;
+						Log << DEBUG << "Defaulting to 'prefetch_count' = '100'." << endl;
 					}
-				}
-				else
-				{
-					Log << "No." << endl;
-				}
 
-			// Set LDAP_OPT_X_KEEPALIVE_IDLE using 'tcp_keepalive_idle' configuration parameter.
-
-				Log << DEBUG << "Checking if 'tcp_keepalive_idle' parameter exists... ";
-
-				if( Cfg.Exists( "tcp_keepalive_idle" ) )
-				{
-					Log << "Yes." << endl;
-					Log << DEBUG << "The value of 'tcp_keepalive_idle' is: '" << Cfg.GetValue( "tcp_keepalive_idle" ) << "'" << endl;
-
-					try
+					if( PrefetchListName.empty() )
 					{
-						IntegerValue = stoi( Cfg.GetValue( "tcp_keepalive_idle" ));
-					}
-					catch( invalid_argument& Exception )
-					{
-						ErrorOccurred = true;
-						Log << WARNING << "Value of 'tcp_keepalive_idle' parameter cannot be parsed. '" << Exception.what() << "' : "
-						               << ErrnoToString( EINVAL ) << ". Attempting to continue." << endl;
+						Log << DEBUG << "Reading login history from: '" << _PATH_WTMP << "' and '" << _PATH_LASTLOG << "'" << endl;
+
+						History.ReadWtmp();
+						History.ReadLastlog();
 					}
-					catch( out_of_range& Exception )
+					else if( PrefetchListName == "-" )
 					{
-						ErrorOccurred = true;
-						Log << WARNING << "Value of 'tcp_keepalive_idle' parameter cannot be parsed. '" << Exception.what() << "' : "
-						               << ErrnoToString( ERANGE ) << ". Attempting to continue." << endl;
+						Log << DEBUG << "Reading usernames from stdin." << endl;
+
+						History.ReadList( cin );
 					}
-					catch( exception& Exception )
+					else
 					{
-						ErrorOccurred = true;
-						Log << WARNING << "Value of 'tcp_keepalive_idle' parameter cannot be parsed. '" << Exception.what() << "' "
-						                  "threw an unhandled exception. Attempting to continue." << endl;
-					}
+						ifstream PrefetchList( PrefetchListName );
 
-					if( !ErrorOccurred )
-					{
-						if( ( ErrorCode = ldap_set_option( LDAPInterface,
-						                                   LDAP_OPT_X_KEEPALIVE_IDLE,
-						                                   &IntegerValue ) ) != LDAP_SUCCESS ) 
-						{
-							Log << WARNING << "ldap_set_option( TCP_KEEPALIVE_IDLE ): " << ldap_err2string( ErrorCode ) << ". "
-							                  "Attempting to continue." << endl;
-						}
-						else
+						if( !PrefetchList.is_open() )
 						{
-							Log << INFORMATION << "ldap_set_option( TCP_KEEPALIVE_IDLE ): Success." << endl;
+							Log << CRITICAL << "Cannot open username list: '" << PrefetchListName << "' : " << ErrnoToString() << "."
+							                << endl;
 						}
-					}
-					else
-					{
-						ErrorOccurred = false;
-					}
-				}
-				else
-				{
-					Log << "No." << endl;
-				}
 
-			// Set LDAP_OPT_X_KEEPALIVE_PROBES using 'tcp_keepalive_probes' configuration parameter.
+						Log << DEBUG << "Reading usernames from: '" << PrefetchListName << "'" << endl;
 
-				Log << DEBUG << "Checking if 'tcp_keepalive_probes' parameter exists... ";
+						History.ReadList( PrefetchList );
+					}
 
-				if( Cfg.Exists( "tcp_keepalive_probes" ) )
-				{
-					Log << "Yes." << endl;
-					Log << DEBUG << "The value of 'tcp_keepalive_probes' is: '" << Cfg.GetValue( "tcp_keepalive_probes" ) << "'" << endl;
+					PrefetchUsers = History.Rank( PrefetchCount );
 
-					try
+					if( PrefetchUsers.empty() )
 					{
-						IntegerValue = stoi( Cfg.GetValue( "tcp_keepalive_probes" ) );
-					}
-					catch( invalid_argument& Exception )
-					{
-						ErrorOccurred = true;
-						Log << WARNING << "Value of 'tcp_keepalive_probes' parameter cannot be parsed. '" << Exception.what() << "' : "
-						               << ErrnoToString( EINVAL ) << ". Attempting to continue." << endl;
-					}
-					catch( out_of_range& Exception )
-					{
-						ErrorOccurred = true;
-						Log << WARNING << "Value of 'tcp_keepalive_probes' parameter cannot be parsed. '" << Exception.what() << "' : "
-						               << ErrnoToString( ERANGE ) << ". Attempting to continue." << endl;
-					}
-					catch( exception& Exception )
-					{
-						ErrorOccurred = true;
-						Log << WARNING << "Value of 'tcp_keepalive_probes' parameter cannot be parsed. '" << Exception.what() << "' "
-						                  "threw an unhandled exception. Attempting to continue." << endl;
+						Log << NOTICE << "No users to prefetch." << endl;
+
+						return EXIT_SUCCESS;
 					}
 
-					if( !ErrorOccurred )
+					Log << INFORMATION << "Prefetching " << PrefetchUsers.size() << " users." << endl;
+
+					if( Routes.Size() == 0 )
 					{
-						if( ( ErrorCode = ldap_set_option( LDAPInterface,
-						                                   LDAP_OPT_X_KEEPALIVE_PROBES,
-						                                   &IntegerValue ) ) != LDAP_SUCCESS )
-						{
-							Log << WARNING << "ldap_set_option( TCP_KEEPALIVE_PROBES ): " << ldap_err2string( ErrorCode ) << ". "
-							                  "Attempting to continue." << endl;
-						}
-						else
-						{
-							Log << INFORMATION << "ldap_set_option( TCP_KEEPALIVE_PROBES ): Success." << endl;
-						}
+						Directory.Prefetch( PrefetchUsers );
 					}
 					else
 					{
-						ErrorOccurred = false;
+						map< KeyLookup*, vector< string > > RoutedUsers;
+
+						for( const string& Current : PrefetchUsers )
+							RoutedUsers[ &Routes.Select( Current ) ].push_back( Current );
+
+						for( pair< KeyLookup* const, vector< string > >& Routed : RoutedUsers )
+							Routed.first->Prefetch( Routed.second );
 					}
-				}
-				else
-				{
-					Log << "No." << endl;
+
+					return EXIT_SUCCESS;
 				}
 
-			// Set LDAP_OPT_TIMEOUT using 'bind_timelimit' configuration parameter.
+			// In batch mode, look up the usernames read from stdin, one per line, over one connection with pipelined searches. One
+			// result per user is written in completion order, either as a JSON object per line or as a NUL-terminated block of the
+			// username followed by its keys, one per line. With a routing table, every username is read first and each profile's users
+			// are looked up over that profile's connection in turn.
 
-				Log << DEBUG << "Checking if 'bind_timelimit' parameter exists... ";
-				
-				if( Cfg.Exists( "bind_timelimit" ) )
+				if( Batch )
 				{
-					Log << "Yes." << endl;
-					Log << DEBUG << "The value of 'bind_timelimit' is: '" << Cfg.GetValue( "bind_timelimit" ) << "'" << endl;
-
-					try
-					{
-						Seconds.tv_sec = stoi( Cfg.GetValue( "bind_timelimit" ) );
-					}
-					catch( invalid_argument& Exception )
-					{
-						ErrorOccurred = true;
-						Log << WARNING << "Value of 'bind_timelimit' parameter cannot be parsed. '" << Exception.what() << "' : "
-						               << ErrnoToString( EINVAL ) << ". Attempting to continue." << endl;
-					}
-					catch( out_of_range& Exception )
-					{
-						ErrorOccurred = true;
-						Log << WARNING << "Value of 'bind_timelimit' parameter cannot be parsed. '" << Exception.what() << "' : "
-						               << ErrnoToString( ERANGE ) << ". Attempting to continue." << endl;
-					}
-					catch( exception& Exception )
-					{
-						ErrorOccurred = true;
-						Log << WARNING << "Value of 'bind_timelimit' parameter cannot be parsed. '" << Exception.what() << "' threw "
-						                  "an unhandled exception. Attempting to continue." << endl;
-					}
+					size_t BatchCount = 0;
+					size_t BatchFound = 0;
 
-					if( !ErrorOccurred )
+					auto WriteBatchResult = [ & ]( const string_view Current, const string_view Status, const string_view Message,
+					                               const string_view DN, const pmr::vector< pmr::string >& Keys )
 					{
-						if( ( ErrorCode = ldap_set_option( LDAPInterface, LDAP_OPT_TIMEOUT, &Seconds ) ) != LDAP_SUCCESS )
+						if( BatchFormat == "json" )
 						{
-							Log << WARNING << "ldap_set_option( BIND_TIMELIMIT ): " << ldap_err2string( ErrorCode ) << ". "
-							                  "Attempting to continue." << endl;
-						}
-						else
-						{
-							Log << INFORMATION << "ldap_set_option( BIND_TIMELIMIT ): Success." << endl;
-						}
-					}
-					else
-					{
-						ErrorOccurred = false;
-					}
-				}
-				else
-				{
-					Log << "No." << endl;
-				}
+							cout << "{\"user\":" << JSONEscape( Current ) << ",\"status\":" << JSONEscape( Status );
 
-			// Set LDAP_OPT_NETWORK_TIMEOUT using 'idle_timelimit' configuration parameter.
+							if( !Message.empty() )
+								cout << ",\"error\":" << JSONEscape( Message );
 
-				Log << DEBUG << "Checking if 'idle_timelimit' parameter exists... ";
-				
-				if( Cfg.Exists( "idle_timelimit" ) )
-				{
-					Log << "Yes." << endl;
-					Log << DEBUG << "The value of 'idle_timelimit' is: '" << Cfg.GetValue( "idle_timelimit" ) << "'" << endl;
+							cout << ",\"dn\":" << JSONEscape( DN ) << ",\"keys\":[";
 
-					try
-					{
-						Seconds.tv_sec = stoi( Cfg.GetValue( "idle_timelimit" ) );
-					}
-					catch( invalid_argument& Exception )
-					{
-						ErrorOccurred = true;
-						Log << WARNING << "Value of 'idle_timelimit' parameter cannot be parsed. '" << Exception.what() << "' : "
-						               << ErrnoToString( EINVAL ) << ". Attempting to continue." << endl;
-					}
-					catch( out_of_range& Exception )
-					{
-						ErrorOccurred = true;
-						Log << WARNING << "Value of 'idle_timelimit' parameter cannot be parsed. '" << Exception.what() << "' : "
-						               << ErrnoToString( ERANGE ) << ". Attempting to continue." << endl;
-					}
-					catch( exception& Exception )
-					{
-						ErrorOccurred = true;
-						Log << WARNING << "Value of 'idle_timelimit' parameter cannot be parsed. '" << Exception.what() << "' threw "
-						                  "an unhandled exception. Attempting to continue." << endl;
-					}
+							for( size_t KeyIndex = 0; KeyIndex < Keys.size(); KeyIndex++ )
+								cout << ( KeyIndex ? "," : "" ) << JSONEscape( Keys[ KeyIndex ] );
 
-					if( !ErrorOccurred )
-					{
-						if( ( ErrorCode = ldap_set_option( LDAPInterface, LDAP_OPT_NETWORK_TIMEOUT, &Seconds ) ) != LDAP_SUCCESS )
-						{
-							Log << WARNING << "ldap_set_option( IDLE_TIMELIMIT ): " << ldap_err2string( ErrorCode ) << ". "
-							                  "Attempting to continue." << endl;
+							cout << "]}\n";
 						}
 						else
 						{
-							Log << INFORMATION << "ldap_set_option( IDLE_TIMELIMIT ): Success." << endl;
+							cout << Current << '\n';
+
+							for( const pmr::string& Key : Keys )
+								cout << Key << '\n';
+
+							cout << '\0';
 						}
-					}
-					else
-					{
-						ErrorOccurred = false;
-					}
-				}
-				else
-				{
-					Log << "No." << endl;
-				}
+					};
 
-			// End of OpenLDAP specific configuration parameters.
+					auto ReadBatchUsername = [ & ]( string& NextUsername )
+					                         {
+					                             string Line;
 
-#				endif
+					                             while( getline( cin, Line ) )
+					                             {
+					                                 Line.erase( Line.find_last_not_of( " \t\r" ) + 1 );
 
-			// Set LDAP_OPT_TIMELIMIT using 'timelimit' configuration parameter.
+					                                 if( Line.empty() )
+					                                     continue;
 
-				Log << DEBUG << "Checking if 'timelimit' parameter exists... ";
-				
-				if( Cfg.Exists( "timelimit" ) )
-				{
-					Log << "Yes." << endl;
-					Log << DEBUG << "The value of 'timelimit' is: '" << Cfg.GetValue( "timelimit" ) << "'" << endl;
+					                                 BatchCount++;
 
-					try
-					{
-						IntegerValue = stoi( Cfg.GetValue( "timelimit" ) );
-					}
-					catch( invalid_argument& Exception )
-					{
-						ErrorOccurred = true;
-						Log << WARNING << "Value of 'timelimit' parameter cannot be parsed. '" << Exception.what() << "' : "
-						               << ErrnoToString( EINVAL ) << ". Attempting to continue." << endl;
-					}
-					catch( out_of_range& Exception )
-					{
-						ErrorOccurred = true;
-						Log << WARNING << "Value of 'timelimit' parameter cannot be parsed. '" << Exception.what() << "' : "
-								<< ErrnoToString( ERANGE ) << ". Attempting to continue." << endl;
-					}
-					catch( exception& Exception )
-					{
-						ErrorOccurred = true;
-						Log << WARNING << "Value of 'timelimit' parameter cannot be parsed. '" << Exception.what() << "' threw "
-									"an unhandled exception. Attempting to continue." << endl;
-					}
+					                                 if( IsValidUsername( Line ) )
+					                                 {
+					                                     NextUsername = Line;
 
-					if( !ErrorOccurred )
-					{
-						if( ( ErrorCode = ldap_set_option( LDAPInterface, LDAP_OPT_TIMELIMIT, &IntegerValue ) ) != LDAP_SUCCESS )
-						{
-							Log << WARNING << "ldap_set_option( TIMELIMIT ): " << ldap_err2string( ErrorCode ) << ". "
-										"Attempting to continue." << endl;
-						}
-						else
-						{
-							Log << INFORMATION << "ldap_set_option( TIMELIMIT ): Success." << endl;
-						}
-					}
-					else
-					{
-						ErrorOccurred = false;
-					}
-				}
-				else
-				{
-					Log << "No." << endl;
-				}
+					                                     return true;
+					                                 }
 
-			// Set LDAP_OPT_X_TLS_CACERTDIR using 'tls_cacertdir' configuration parameter.
+					                                 Log << WARNING << "Invalid username in batch: '" << Line << "'." << endl;
 
-				Log << DEBUG << "Checking if 'tls_cacertdir' parameter exists... ";
+					                                 WriteBatchResult( Line, "invalid", "", "", {} );
+					                             }
 
-				if( Cfg.Exists( "tls_cacertdir" ) )
-				{
-					Log << "Yes." << endl;
-					Log << DEBUG << "The value of 'tls_cacertdir' is: '" << Cfg.GetValue( "tls_cacertdir" ) << "'" << endl;
-					Log << DEBUG << "Checking if '" << Cfg.GetValue( "tls_cacertdir" ) << "' exists...";
+					                             return false;
+					                         };
 
-					if( ACCESS_F( Cfg.GetValue( "tls_cacertfile" ).c_str() ) )
-					{
-						Log << "Yes." << endl;
-						Log << DEBUG << "Checking if '" << Cfg.GetValue( "tls_cacertdir" ) << "' is searchable...";
+					auto WriteBatchLookup = [ & ]( SearchPipeline::Result& Current )
+					                        {
+					                            if( Current.EntryCount > 1 )
+					                            {
+					                                WriteBatchResult( Current.Username, "multiple", "", "", {} );
+					                            }
+					                            else if( Current.ErrorCode != LDAP_SUCCESS )
+					                            {
+					                                Log << WARNING << "Cannot look up user: " << Current.Username << " : "
+					                                               << ldap_err2string( Current.ErrorCode ) << "." << endl;
 
-						if( ACCESS_X( Cfg.GetValue( "tls_cacertfile" ).c_str() ) )
-						{
-							Log << "Yes." << endl;
+					                                WriteBatchResult( Current.Username, "error", ldap_err2string( Current.ErrorCode ), "", {} );
+					                            }
+					                            else if( Current.EntryCount == 0 )
+					                            {
+					                                WriteBatchResult( Current.Username, "not_found", "", "", {} );
+					                            }
+					                            else if( Current.Denied != nullptr )
+					                            {
+					                                WriteBatchResult( Current.Username, "denied", Current.Denied, Current.DN, {} );
+					                            }
+					                            else
+					                            {
+					                                WriteBatchResult( Current.Username, "ok", "", Current.DN, Current.Values );
+					                                BatchFound++;
+					                            }
+					                        };
 
-							if( ( ErrorCode = ldap_set_option( LDAPInterface,
-							                                   LDAP_OPT_X_TLS_CACERTDIR,
-							                                   Cfg.GetValue( "tls_cacertdir" ).c_str() ) ) != LDAP_SUCCESS )
-							{
-								Log << WARNING << "ldap_set_option( TLS_CACERTDIR ): " << ldap_err2string( ErrorCode ) << ". "
-								                  "Attempting to continue." << endl;
-							}
-							else
-							{
-								Log << INFORMATION << "ldap_set_option( TLS_CACERTDIR ): Success." << endl;
-							}
-						}
-						else
-						{
-							Log << "No." << endl;
-							Log << WARNING << "ldap_set_option( TLS_CACERTDIR ): " << ErrnoToString() << ". Attempting to "
-							                  "continue." << endl;
-						}
+					if( Routes.Size() == 0 )
+					{
+						Directory.LookupMany( ReadBatchUsername, WriteBatchLookup );
 					}
 					else
 					{
-						Log << "No." << endl;
-						Log << WARNING << "ldap_set_option( TLS_CACERTDIR ): " << ErrnoToString() << ". Attempting to continue."
-						               << endl;
-					}
-				}
-				else
-				{
-					Log << "No." << endl;
-				}
+						map< KeyLookup*, vector< string > > RoutedUsers;
+						string NextUsername;
 
-			// Set LDAP_OPT_X_TLS_CACERTFILE using 'tls_cacertfile' configuration parameter.
+						while( ReadBatchUsername( NextUsername ) )
+							RoutedUsers[ &Routes.Select( NextUsername ) ].push_back( NextUsername );
 
-				Log << DEBUG << "Checking if 'tls_cacertfile' parameter exists... ";
-
-				if( Cfg.Exists( "tls_cacertfile" ) )
-				{
-					Log << "Yes." << endl;
-					Log << DEBUG << "The value of 'tls_cacertfile' is: '" << Cfg.GetValue( "tls_cacertfile" ) << "'" << endl;
-					Log << DEBUG << "Checking if '" << Cfg.GetValue( "tls_cacertfile" ) << "' exists...";
+						for( pair< KeyLookup* const, vector< string > >& Routed : RoutedUsers )
+						{
+							size_t RoutedIndex = 0;
 
-					if( ACCESS_F( Cfg.GetValue( "tls_cacertfile" ).c_str() ) )
-					{
-						Log << "Yes." << endl;
-						Log << DEBUG << "Checking if '" << Cfg.GetValue( "tls_cacertfile" ) << "' is readable...";
+							Routed.first->LookupMany( [ & ]( string& RoutedUsername )
+							                          {
+							                              if( RoutedIndex >= Routed.second.size() )
+							                                  return false;
 
-						if( ACCESS_R( Cfg.GetValue( "tls_cacertfile" ).c_str() ) )
-						{
-							Log << "Yes." << endl;
+							                              RoutedUsername = Routed.second[ RoutedIndex++ ];
 
-							if( ( ErrorCode = ldap_set_option( LDAPInterface,
-							                                   LDAP_OPT_X_TLS_CACERTFILE,
-							                                   Cfg.GetValue( "tls_cacertfile" ).c_str() ) ) != LDAP_SUCCESS )
-							{
-								Log << WARNING << "ldap_set_option( TLS_CACERTFILE ): " << ldap_err2string( ErrorCode ) << ". "
-								                  "Attempting to continue." << endl;
-							}
-							else
-							{
-								Log << INFORMATION << "ldap_set_option( TLS_CACERTFILE ): Success." << endl;
-							}
-						}
-						else
-						{
-							Log << "No." << endl;
-							Log << WARNING << "ldap_set_option( TLS_CACERTFILE ): " << ErrnoToString() << ". Attempting to "
-							                  "continue." << endl;
+							                              return true;
+							                          },
+							                          WriteBatchLookup );
 						}
 					}
-					else
-					{
-						Log << "No." << endl;
-						Log << WARNING << "ldap_set_option( TLS_CACERTFILE ): " << ErrnoToString() << ". Attempting to continue."
-						               << endl;
-					}
-				}
-				else
-				{
-					Log << "No." << endl;
-				}
 
-			// Set LDAP_OPT_X_TLS_CERTFILE using 'tls_cert' configuration parameter.
+					cout.flush();
 
-				Log << DEBUG << "Checking if 'tls_cert' parameter exists... ";
+					Log << INFORMATION << "Looked up " << BatchCount << " users in batch, found " << BatchFound << "." << endl;
 
-				if( Cfg.Exists( "tls_cert" ) )
-				{
-					Log << "Yes." << endl;
-					Log << DEBUG << "The value of 'tls_cert' is: '" << Cfg.GetValue( "tls_cert" ) << "'" << endl;
-					Log << DEBUG << "Checking if '" << Cfg.GetValue( "tls_cert" ) << "' exists... "; 
+					return EXIT_SUCCESS;
+				}
 
-					if( ACCESS_F( Cfg.GetValue( "tls_cert" ).c_str() ) )
-					{
-						Log << "Yes." << endl;
-						Log << DEBUG << "Checking if '" << Cfg.GetValue( "tls_cert" ) << "' is readable...";
-
-						if( ACCESS_R( Cfg.GetValue( "tls_cert" ).c_str() ) )
-						{
-							Log << "Yes." << endl;
-
-							if( ( ErrorCode = ldap_set_option( LDAPInterface,
-							                                   LDAP_OPT_X_TLS_CERTFILE,
-							                                   Cfg.GetValue( "tls_cert" ).c_str() ) ) != LDAP_SUCCESS )
-							{
-								Log << WARNING << "ldap_set_option( TLS_CERT ): " << ldap_err2string( ErrorCode ) << ". "
-								                  "Attempting to continue." << endl;
-							}
-							else
-							{
-								Log << INFORMATION << "ldap_set_option( TLS_CERT ): Success." << endl;
-							}
-						}
-						else
-						{
-							Log << "No." << endl;
-							Log << WARNING << "ldap_set_option( TLS_CERT ): " << ErrnoToString() << ". Attempting to continue."
-							               << endl;
-						}
-					}
-					else
-					{
-						Log << "No." << endl;
-						Log << WARNING << "ldap_set_option( TLS_CERT ): " << ErrnoToString() << ". Attempting to continue." << endl;
-					}
-				}
-				else
-				{
-					Log << "No." << endl;
-				}
-
-			// Set LDAP_OPT_X_TLS_KEYFILE using 'tls_key' configuration parameter.
-
-				Log << DEBUG << "Checking if 'tls_key' parameter exists... ";
-
-				if( Cfg.Exists( "tls_key" ) )
-				{
-					Log << "Yes." << endl;
-					Log << DEBUG << "The value of 'tls_key' is: '" << Cfg.GetValue( "tls_key" ) << "'" << endl;
-					Log << DEBUG << "Checking if '" << Cfg.GetValue( "tls_key" ) << "' exists... "; 
-
-					if( ACCESS_F( Cfg.GetValue( "tls_key" ).c_str() ) )
-					{
-						Log << "Yes." << endl;
-						Log << DEBUG << "Checking if '" << Cfg.GetValue( "tls_key" ) << "' is readable...";
-
-						if( ACCESS_R( Cfg.GetValue( "tls_key" ).c_str() ) )
-						{
-							Log << "Yes." << endl;
-
-							if( ( ErrorCode = ldap_set_option( LDAPInterface,
-							                                   LDAP_OPT_X_TLS_KEYFILE,
-							                                   Cfg.GetValue( "tls_key" ).c_str() ) ) != LDAP_SUCCESS )
-							{
-								Log << WARNING << "ldap_set_option( TLS_KEY ): " << ldap_err2string( ErrorCode ) << ". "
-								                  "Attempting to continue." << endl;
-							}
-							else
-							{
-								Log << INFORMATION << "ldap_set_option( TLS_KEY ): Success." << endl;
-							}
-						}
-						else
-						{
-							Log << "No." << endl;
-							Log << WARNING << "ldap_set_option( TLS_KEY ): " << ErrnoToString() << ". Attempting to continue."
-							               << endl;
-						}
-					}
-					else
-					{
-						Log << "No." << endl;
-						Log << WARNING << "ldap_set_option( TLS_KEY ): " << ErrnoToString() << ". Attempting to continue." << endl;
-					}
-				}
-				else
-				{
-					Log << "No." << endl;
-				}
-
-			// Set LDAP_OPT_X_TLS_CIPHER_SUITE using 'tls_ciphers' configuration parameter.
-
-				Log << DEBUG << "Checking if 'tls_ciphers' parameter exists... ";
-
-				if( Cfg.Exists( "tls_ciphers" ) )
-				{
-					Log << "Yes." << endl;
-					Log << DEBUG << "The value of 'tls_ciphers' is: '" << Cfg.GetValue( "tls_ciphers" ) << "'" << endl;
-
-					if( ( ErrorCode = ldap_set_option( LDAPInterface,
-					                                   LDAP_OPT_X_TLS_CIPHER_SUITE,
-					                                   Cfg.GetValue( "tls_ciphers" ).c_str() ) ) != LDAP_SUCCESS )
-					{
-						Log << WARNING << "ldap_set_option( TLS_CIPHERS ): " << ldap_err2string( ErrorCode ) << ". Attempting to "
-						                  "continue." << endl;
-					}
-					else
-					{
-						Log << INFORMATION << "ldap_set_option( TLS_CIPHERS ): Success." << endl;
-					}
-				}
-				else
-				{
-					Log << "No." << endl;
-				}
-
-			// Set LDAP_OPT_X_TLS_DHFILE using 'tls_dhfile' configuration parameter.
-
-				Log << DEBUG << "Checking if 'tls_dhfile' parameter exists... ";
-
-				if( Cfg.Exists( "tls_dhfile" ) )
-				{
-					Log << "Yes." << endl;
-					Log << DEBUG << "The value of 'tls_dhfile' is: '" << Cfg.GetValue( "tls_dhfile" ) << "'" << endl;
-					Log << DEBUG << "Checking if '" << Cfg.GetValue( "tls_dhfile" ) << "' exists... "; 
-
-					if( ACCESS_F( Cfg.GetValue( "tls_dhfile" ).c_str() ) )
-					{
-						Log << "Yes." << endl;
-						Log << DEBUG << "Checking if '" << Cfg.GetValue( "tls_dhfile" ) << "' is readable...";
-
-						if( ACCESS_R( Cfg.GetValue( "tls_dhfile" ).c_str() ) )
-						{
-							Log << "Yes." << endl;
-
-							if( ( ErrorCode = ldap_set_option( LDAPInterface,
-							                                   LDAP_OPT_X_TLS_DHFILE,
-							                                   Cfg.GetValue( "tls_dhfile" ).c_str() ) ) != LDAP_SUCCESS )
-							{
-								Log << WARNING << "ldap_set_option( TLS_DHFILE ): " << ldap_err2string( ErrorCode ) << ". "
-								                  "Attempting to continue." << endl;
-							}
-							else
-							{
-								Log << INFORMATION << "ldap_set_option( TLS_DHFILE ): Success." << endl;
-							}
-						}
-						else
-						{
-							Log << "No." << endl;
-							Log << WARNING << "ldap_set_option( TLS_DHFILE ): " << ErrnoToString() << ". Attempting to continue."
-							               << endl;
-						}
-					}
-					else
-					{
-						Log << "No." << endl;
-						Log << WARNING << "ldap_set_option( TLS_DHFILE ): " << ErrnoToString() << ". Attempting to continue."
-						               << endl;
-					}
-				}
-				else
-				{
-					Log << "No." << endl;
-				}
-
-			// Set LDAP_OPT_X_TLS_RANDOM_FILE using 'tls_randfile' configuration parameter.
-
-				Log << DEBUG << "Checking if 'tls_randfile' parameter exists... ";
-
-				if( Cfg.Exists( "tls_randfile" ) )
-				{
-					Log << "Yes." << endl;
-					Log << DEBUG << "The value of 'tls_randfile' is: '" << Cfg.GetValue( "tls_randfile" ) << "'" << endl;
-					Log << DEBUG << "Checking if '" << Cfg.GetValue( "tls_randfile" ) << "' exists... ";
-
-					if( ACCESS_F( Cfg.GetValue( "tls_randfile" ).c_str() ) )
-					{
-						Log << "Yes." << endl;
-						Log << DEBUG << "Checking if '" << Cfg.GetValue( "tls_randfile" ) << "' is readable... ";
-
-						if( ACCESS_R( Cfg.GetValue( "tls_randfile" ).c_str() ) )
-						{
-							Log << "Yes." << endl;
-
-							if( ( ErrorCode = ldap_set_option( LDAPInterface,
-							                                   LDAP_OPT_X_TLS_RANDOM_FILE,
-							                                   Cfg.GetValue( "tls_randfile" ).c_str() ) ) != LDAP_SUCCESS )
-							{
-								Log << WARNING << "ldap_set_option( TLS_RANDFILE ): " << ldap_err2string( ErrorCode ) << ". "
-								                  "Attempting to continue." << endl;
-							}
-							else
-							{
-								Log << INFORMATION << "ldap_set_option( TLS_RANDFILE ): Success." << endl;
-							}
-						}
-						else
-						{
-							Log << "No." << endl;
-							Log << WARNING << "ldap_set_option( TLS_RANDFILE ): " << ErrnoToString() << ". Attempting to "
-							                  "continue." << endl;
-						}
-					}
-					else
-					{
-						Log << "No." << endl;
-						Log << WARNING << "ldap_set_option( TLS_RANDFILE ): " << ErrnoToString() << ". Attempting to continue."
-						               << endl;
-					}
-				}
-				else
-				{
-					Log << "No." << endl;
-				}
-
-			// Set LDAP_OPT_X_TLS_REQUIRE_CERT using 'tls_reqcert' configuration parameter.
-
-				Log << DEBUG << "Checking if 'tls_reqcert' parameter exists... ";
-
-				if( Cfg.Exists( "tls_reqcert" ) )
-				{
-					Log << "Yes." << endl;
-					Log << DEBUG << "The value of 'tls_reqcert' is: '" << Cfg.GetValue( "tls_reqcert" ) << "'" << endl;
-
-					StringValue = Cfg.GetValue( "tls_reqcert" );
-
-					try
-					{
-						transform( StringValue.begin(), StringValue.end(), StringValue.begin(), ::tolower );
-					}
-					catch( bad_alloc& Exception )
-					{
-						ErrorOccurred = true;
-						Log << WARNING << "Value of 'tls_reqcert' parameter cannot be parsed. '" << Exception.what() << "' : " 
-						               << ErrnoToString( ENOMEM ) << ". Attempting to continue." << endl;
-					}
-					catch( exception& Exception )
-					{
-						ErrorOccurred = true;
-						Log << WARNING << "Value of 'tls_reqcert' parameter cannot be parsed. '" << Exception.what() << "' threw an"
-						                  "unhandled exception. Attempting to continue." << endl;
-					}
-
-					if( !ErrorOccurred )
-					{
-						if( StringValue == "never" )
-						{
-							IntegerValue = LDAP_OPT_X_TLS_NEVER;
-						}
-						else if( StringValue == "allow" )
-						{
-							IntegerValue = LDAP_OPT_X_TLS_ALLOW;
-						}
-						else if( StringValue == "try" )
-						{
-							IntegerValue = LDAP_OPT_X_TLS_TRY;
-						}
-						else if( StringValue == "demand" )
-						{
-							IntegerValue = LDAP_OPT_X_TLS_DEMAND;
-						}
-						else if( StringValue == "hard" )
-						{
-							IntegerValue = LDAP_OPT_X_TLS_HARD;
-						}
-						else
-						{
-							ErrorOccurred = true;
-							Log << WARNING << "Value of 'tls_reqcert' parameter is invalid. Attempting to continue." << endl;
-						}
-
-						if( !ErrorOccurred )
-						{
-							if( ( ErrorCode = ldap_set_option( LDAPInterface,
-							                                   LDAP_OPT_X_TLS_REQUIRE_CERT,
-							                                   &IntegerValue ) ) != LDAP_SUCCESS )
-							{
-								Log << WARNING << "ldap_set_option( TLS_REQCERT ): " << ldap_err2string( ErrorCode ) << ". "
-								                  "Attempting to continue." << endl;
-							}
-							else
-							{
-								Log << INFORMATION << "ldap_set_option( TLS_REQCERT ): Success." << endl;
-							}
-						}
-						else
-						{
-							ErrorOccurred = false;
-						}
-					}
-					else
-					{
-						ErrorOccurred = false;
-					}
-				}
-				else
-				{
-					Log << "No." << endl;
-				}
-
-			// Set LDAP_OPT_X_TLS_CRLCHECK using 'tls_crlcheck' configuration parameter.
-
-				Log << DEBUG << "Checking if 'tls_crlcheck' parameter exists... ";
-
-				if( Cfg.Exists( "tls_crlcheck" ) )
-				{
-					Log << "Yes." << endl;
-					Log << DEBUG << "The value of 'tls_crlcheck' is: '" << Cfg.GetValue( "tls_crlcheck" ) << "'" << endl;
-
-					StringValue = Cfg.GetValue( "tls_crlcheck" );
-
-					try
-					{
-						transform( StringValue.begin(), StringValue.end(), StringValue.begin(), ::tolower );
-					}
-					catch( bad_alloc& Exception )
-					{
-						ErrorOccurred = true;
-						Log << WARNING << "Value of 'tls_crlcheck' parameter cannot be parsed. '" << Exception.what() << "' : "
-						               << ErrnoToString( ENOMEM ) << ". Attempting to continue." << endl;
-					}
-					catch( exception& Exception )
-					{
-						ErrorOccurred = true;
-						Log << WARNING << "Value of 'tls_crlcheck' parameter cannot be parsed. '" << Exception.what() << "' threw an"
-						                  "unhandled exception. Attempting to continue." << endl;
-					}
-
-					if( !ErrorOccurred )
-					{
-						if( StringValue == "none" )
-						{
-							IntegerValue = LDAP_OPT_X_TLS_CRL_NONE;
-						}
-						else if( StringValue == "peer" )
-						{
-							IntegerValue = LDAP_OPT_X_TLS_CRL_PEER;
-						}
-						else if( StringValue == "all" )
-						{
-							IntegerValue = LDAP_OPT_X_TLS_CRL_ALL;
-						}
-						else
-						{
-							ErrorOccurred = true;
-							Log << WARNING << "Value of 'tls_crlcheck' parameter is invalid. Attempting to continue." << endl;
-						}
-
-						if( !ErrorOccurred )
-						{
-							if( ( ErrorCode = ldap_set_option( LDAPInterface,
-							                                   LDAP_OPT_X_TLS_CRLCHECK,
-							                                   &IntegerValue ) ) != LDAP_SUCCESS )
-							{
-								Log << WARNING << "ldap_set_option( TLS_CRLCHECK ): " << ldap_err2string( ErrorCode ) << ". "
-								                  "Attempting to continue." << endl;
-							}
-							else
-							{
-								Log << INFORMATION << "ldap_set_option( TLS_REQCERT ): Success." << endl;
-							}
-						}
-						else
-						{
-							ErrorOccurred = false;
-						}
-					}
-					else
-					{
-						ErrorOccurred = false;
-					}
-				}
-				else
-				{
-					Log << "No." << endl;
-				}
-
-			// Upgrade to TLS connection if 'start_tls' configuration parameter is set to a variation of 'true'.
-
-				Log << DEBUG << "Checking if 'start_tls' parameter exists... ";
-
-				if( Cfg.Exists( "start_tls" ) )
-				{
-					Log << "Yes." << endl;
-					Log << DEBUG << "The value of 'start_tls' is: '" << Cfg.GetValue( "start_tls" ) << "'" << endl;
-					Log << DEBUG << "Checking if 'start_tls' parameter is a variation of 'true'... ";
-
-					StringValue = Cfg.GetValue( "start_tls" );
-
-					try
-					{
-						transform( StringValue.begin(), StringValue.end(), StringValue.begin(), ::tolower );
-					}
-					catch( bad_alloc& Exception )
-					{
-						ErrorOccurred = true;
-						Log << endl << WARNING << "Value of 'start_tls' parameter cannot be parsed. '" << Exception.what() << "' : "
-						                       << ErrnoToString( ENOMEM ) << ". Attempting to continue." << endl;
-					}
-					catch( exception& Exception )
-					{
-						ErrorOccurred = true;
-						Log << endl << WARNING << "Value of 'start_tls' parameter cannot be parsed. '" << Exception.what() << "' threw"
-						                          " an unhandled exception. Attempting to continue." << endl;
-					}
-
-					if( !ErrorOccurred )
-					{
-						if( ( StringValue == "true" ) ||
-						    ( StringValue == "t" ) ||
-						    ( StringValue == "yes" ) ||
-						    ( StringValue == "y" ) ||
-						    ( StringValue == "enable" ) ||
-						    ( StringValue == "enabled ") ||
-						    ( StringValue == "on" ) )
-						{
-							Log << "Yes." << endl;
-
-							ErrorCode = ldap_start_tls_s( LDAPInterface, nullptr, nullptr );
-
-							if( ErrorCode != LDAP_SUCCESS )
-							{
-								ldap_get_option( LDAPInterface, LDAP_OPT_DIAGNOSTIC_MESSAGE, &ErrorMessageBuffer );
-								ErrorMessage = string( ErrorMessageBuffer );
-
-								FreeMemory();
-
-								Log << CRITICAL << "ldap_start_tls_s(): " << ldap_err2string( ErrorCode ) << " : "
-								                << ErrorMessage << ". Cannot continue." << endl;
-							}
-							else
-							{
-								Log << INFORMATION << "ldap_start_tls_s(): Success." << endl;
-							}
-						}
-						else
-						{
-							Log << "No." << endl;
-						}
-					}
-					else
-					{
-						ErrorOccurred = false;
-					}
-				}
-				else
-				{
-					Log << "No." << endl;
-				}
-
-			// Bind using credentials supplied via 'binddn' and 'bindpw' configuration parameters, or anonymous bind.
-
-				Log << DEBUG << "Checking if 'binddn' parameter exists... ";
-
-				// TODO: Add options for other SASL mechanisms. Also Kerberos.
-				if( Cfg.Exists( "binddn" ) )
-				{
-					Log << "Yes." << endl;
-					Log << DEBUG << "The value of 'binddn' is: '" << Cfg.GetValue( "binddn" ) << "'" << endl;
-					Log << DEBUG << "Checking if 'bindpw' parameter exists... ";
-
-					if( Cfg.Exists( "bindpw" ) )
-					{
-						Log << "Yes." << endl;
-						Log << DEBUG << "The value of 'bindpw' is: " << Cfg.GetValue( "bindpw" ) << endl;
-						Log << DEBUG << "Note: Please redact the 'bindpw' value when submitting logs (it also appears in the "
-						                "configuration dump above)." << endl;
-						Log << INFORMATION << "Attempting authenticated bind..." << endl;
-
-						Credentials = ber_bvstrdup( Cfg.GetValue( "bindpw" ).c_str() );
-
-						ErrorCode = ldap_sasl_bind_s( LDAPInterface,
-									Cfg.GetValue( "binddn" ).c_str(),
-									LDAP_SASL_SIMPLE,
-									Credentials,
-									nullptr,
-									nullptr,
-									&ServerCredentials );
-
-						BerValueFree( Credentials );
-					}
-					else
-					{
-						Log << "No." << endl;
-
-						ErrorCode = LDAP_INVALID_CREDENTIALS;
-					}
-				}
-				else
-				{
-					Log << "No." << endl;
-					Log << INFORMATION << "Attempting anonymous bind..." << endl;
-
-					Credentials = ber_bvstrdup( "" );
-
-					ErrorCode = ldap_sasl_bind_s( LDAPInterface,
-					                              nullptr,
-					                              LDAP_SASL_SIMPLE,
-					                              Credentials,
-					                              nullptr,
-					                              nullptr,
-					                              &ServerCredentials );
-
-					BerValueFree( Credentials );
-				}
-
-			// On bind error, log error to syslog and exit on failure.
-
-				if( ErrorCode != LDAP_SUCCESS )
-				{
-					FreeMemory();
-
-					Log << CRITICAL << "ldap_sasl_bind_s(): " << ldap_err2string( ErrorCode ) << ". Cannot continue." << endl;
-				}
-				else
-				{
-					Log << INFORMATION << "ldap_sasl_bind_s(): Success." << endl;
-				}
+			// In export mode, write one authorized_keys file per user found by the filter (with '%1' replaced by '*') to the export
+			// directory and exit.
 
-			// Set scope from configuration value (only accepts "one" or "sub"; "base" is ignored) or default to LDAP_SCOPE_ONELEVEL.
-
-				Log << DEBUG << "Checking if 'scope' parameter exists... ";
-
-				if( Cfg.Exists( "scope" ) )
+				if( !ExportDirectory.empty() )
 				{
-					Log << "Yes." << endl;
-					Log << DEBUG << "The value of 'scope' is: '" << Cfg.GetValue( "scope" ) << "'" << endl;
+					KeyLookup::ExportResult Summary = Directory.Export( ExportDirectory );
 
-					if( ( Cfg.GetValue( "scope" ) == "one" ) || ( Cfg.GetValue( "scope" ) == "onelevel" ) )
-					{
-						Scope = LDAP_SCOPE_ONELEVEL;
-					}
-					else if( ( Cfg.GetValue( "scope" ) == "sub" ) || ( Cfg.GetValue( "scope" ) == "subtree" ) )
-					{
-						Scope = LDAP_SCOPE_SUBTREE;
-					}
-					else
+					if( Summary.Failed != 0 )
 					{
-						Log << WARNING << "Value of 'scope' parameter invalid. Defaulting to 'scope' = 'onelevel'." << endl;
+						Log << ERROR << "Cannot write " << Summary.Failed << " files in: '" << ExportDirectory << "'." << endl;
 
-						Scope = LDAP_SCOPE_ONELEVEL;
+						return EXIT_FAILURE;
 					}
-				}
-				else
-				{
-					Log << "No." << endl;
-					Log << DEBUG << "Defaulting to 'scope' = 'onelevel'." << endl;
-
-					Scope = LDAP_SCOPE_ONELEVEL;
-				}
-
-			// Set filter from configuration value and argv[1] (%1 denotes username and is replaced by argv[1]).
-
-				Log << DEBUG << "Checking if 'filter' parameter exists... ";
-
-				if( Cfg.Exists( "filter" ) )
-				{
-					Log << "Yes." << endl;
-					Log << DEBUG << "The value of 'filter' is: '" << Cfg.GetValue( "filter" ) << "'" << endl;
-
-					Filter = Cfg.GetValue( "filter" );
-					FindPosition = Filter.find( "%1" );
-
-					if( FindPosition == string::npos )
-					{
-						FreeMemory();
-
-						Log << CRITICAL << " Value of 'filter' parameter invalid. '%1' must denote username in filter." << endl;
-					}
-
-					Filter.replace( FindPosition, 2, Username );
-				}
-				else
-				{
-					Log << "No." << endl;
-					Log << DEBUG << "Defaulting to 'filter' = 'cn=%1'" << endl;
-
-					Filter = "cn=" + Username;
-				}
-
-			// Copy attribute name from configuration value or default to the default attribute name, "sshPublicKey".
-
-				Log << DEBUG << "Checking if 'attribute' parameter exists... ";
-
-				if( Cfg.Exists( "attribute" ) && ( !Cfg.GetValue( "attribute" ).empty() ) )
-				{
-					Log << "Yes." << endl;
-					Log << DEBUG << "The value of 'attribute' is: '" << Cfg.GetValue( "attribute" ) << "'" << endl;
-
-					AttributeName = Cfg.GetValue( "attribute" );
-				}
-				else
-				{
-					Log << "No." << endl;
-					Log << DEBUG << "Defaulting to 'attribute' = 'sshPublicKey'" << endl;
 
-					AttributeName = "sshPublicKey";
+					return EXIT_SUCCESS;
 				}
 
-			// Check if 'base' parameter exists in configuration file.
+			// Look up the user in the directory its route selects and send the rendered block of keys to stdout with a single write. The
+			// lookup is abandoned if sshd closes stdout or exits while it waits for the server.
 
-				Log << DEBUG << "Checking if 'base' parameter exists...";
+				KeyLookup& Selected = Routes.Select( Username );
 
-				if( Cfg.Exists( "base" ) )
-				{
-					Log << "Yes." << endl;
-					Log << DEBUG << "The value of 'base' is: '" << Cfg.GetValue( "base" ) << "'" << endl;
-
-					if( ! regex_match( Cfg.GetValue( "base" ), regex("(\\w+[=]{1}[a-zA-Z0-9\\_\\-\\!\\%\\*\\+\\/\\:\\;\\<\\>\\?\\$\\&\\#"
-					                                                 "\\(\\)\\[\\]\\{\\}\\.\\s]+)([,{1}]\\w+[=]{1}[a-zA-Z0-9\\_\\-\\!\\%"
-					                                                 "\\*\\+\\/\\:\\;\\<\\>\\?\\$\\&\\#\\(\\)\\[\\]\\{\\}\\.\\s]+)*") ) )
-					{
-						FreeMemory();
-
-						Log << CRITICAL << "Value of 'bind' parameter invalid." << endl;
-					}
-				}
-				else
-				{
-					Log << "No." << endl;
-
-					FreeMemory();
-
-					Log << CRITICAL << "Value of 'bind' parameter undefined." << endl;
-				}
-
-			// Convert attribute name to a NULL-terminated c-string array for ldap_search_ext_s().
-
-				AttributeListLength = 2;
-				AttributeList = new char*[ AttributeListLength ];
-				AttributeList[ 0 ] = new char[ AttributeName.length() + 1 ];
-				strcpy( AttributeList[ 0 ], AttributeName.c_str() );
-				AttributeList[ 1 ] = nullptr;
-
-			// Commit search. Note: Fetch a maximum 2 entries to ensure the entry is singular.
-
-				Log << DEBUG << "Performing search... ";
-
-				ErrorCode = ldap_search_ext_s( LDAPInterface,
-				                               Cfg.GetValue( "base" ).c_str(),
-				                               Scope,
-				                               Filter.c_str(),
-				                               AttributeList,
-				                               0,
-				                               nullptr,
-				                               nullptr,
-				                               nullptr,
-				                               2, 
-				                               &Response );
-
-				Log << "Finished." << endl;
-
-			// Free attribute name c-string array.
-
-				CStringArrayFree( AttributeList, AttributeListLength );
-
-			// If an error occurred, log error and exit on failure.
-
-				if( ErrorCode != LDAP_SUCCESS )
-				{
-					FreeMemory();
-
-					Log << CRITICAL << "ldap_search_ext_s(): " << ldap_err2string( ErrorCode ) << ". Cannot continue." << endl;
-				}
-
-			// Ensure the entry is singular or log error and exit on failure; also exit on zero entries.
-
-				Log << DEBUG << "Number of entries in result: " << ldap_count_entries( LDAPInterface, Response ) << "." << endl;
-
-				if( ldap_count_entries( LDAPInterface, Response ) > 1 )
-				{
-					FreeMemory();
-
-					Log << CRITICAL << "Filter returned more than one result for user: " << Username << endl;
-				}
-				else if( ldap_count_entries( LDAPInterface, Response ) == 0 )
-				{
-					FreeMemory();
-
-					Log << INFORMATION << "No results returned for user: " << Username << "." << endl;
-
-					return 0; // << remove this later...
-				}
-
-			// Set a pointer to the entry.
-
-				Entry = ldap_first_entry( LDAPInterface, Response );
-
-			// Loop through attributes. Send the returned value matching attribute name (above) to stdout.
-
-				AttributeCount = 0;
-
-				for( Attribute = ldap_first_attribute( LDAPInterface, Entry, &AttributeIterator );
-				;
-				Attribute = ldap_next_attribute( LDAPInterface, Entry, AttributeIterator ) )
-				{
-					if( Attribute == NULL )
-					{
-						break;
-					}
-					else if( string( Attribute ) == AttributeName )
-					{
-						Values = ldap_get_values_len( LDAPInterface, Entry, Attribute );
-
-						Log << DEBUG << "Number of attribute values in result: " << ldap_count_values_len( Values ) << "." << endl;
-
-						for( ValueIndex = 0; ValueIndex < ldap_count_values_len( Values ); ValueIndex++ )
-							cout << Values[ ValueIndex ]->bv_val << endl;
-						
-						LDAPValueFreeLen( Values );
-						LDAPMemFree( Attribute );
-					}
-					else
-					{ 
-						LDAPMemFree( Attribute );
-					}
-
-					AttributeCount++;
-				}
-
-				Log << DEBUG << "Number of attributes in result: " << AttributeCount << "." << endl;
-				Log << INFORMATION << "Success for user: " << Username << "." << endl;
+				Selected.WatchCaller();
 
+				if( Selected.Lookup( Username, Keys ) && ( !WriteAll( STDOUT_FILENO, Keys.Block ) ) )
+					throw ios_base::failure( "Cannot write keys" );
 		}
 		catch( out_of_range& Exception )
 		{
-			FreeMemory();
 			Log << endl << CRITICAL << Exception.what() << " : " << ErrnoToString( ERANGE ) << "." << endl;
 		}
 		catch( length_error& Exception )
 		{
-			FreeMemory();
 			Log << endl << CRITICAL << Exception.what() << " : " << ErrnoToString( EOVERFLOW ) << "." << endl;
 		}
 		catch( ios_base::failure& Exception )
 		{
-			FreeMemory();
 			Log << endl << CRITICAL << Exception.what() << " : " << ErrnoToString( EIO ) << "." << endl;
 		}
 		catch( bad_alloc& Exception )
 		{
-			FreeMemory();
 			Log << endl << CRITICAL << Exception.what() << " : " << ErrnoToString( ENOMEM ) << "." << endl;
 		}
 		catch( invalid_argument& Exception )
 		{
-			FreeMemory();
 			Log << endl << CRITICAL << Exception.what() << " : " << ErrnoToString( EINVAL ) << "." << endl;
 		}
+		catch( runtime_error& Exception )
+		{
+			Log << endl << CRITICAL << Exception.what() << ". Cannot continue." << endl;
+		}
 		catch( exception& Exception )
 		{
-			FreeMemory();
 			Log << endl << CRITICAL << Exception.what() <<" : " << ErrnoToString( EBADMSG ) << "." << endl;
 		}
 
-	// Free memory and close LDAP.
-
-		FreeMemory();
-
 	// Return on success.
 
 		return EXIT_SUCCESS;
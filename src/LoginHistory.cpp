@@ -0,0 +1,146 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// LoginHistory.cpp
+// Matthew J. Schultz | Created : 31OCT17 | Last Modified : 31OCT17 by Matthew J. Schultz
+// Version : 0.0.1
+// This is the source file for the 'LoginHistory' class of 'LSSHKeys', which ranks users by recent logins for prefetching.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2017 QuantuMatriX Software, a QuantuMatriX Technologies Cooperative Partnership.
+//
+// This file is part of 'LSSHKeys'.
+//
+// 'LSSHKeys' is free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any later version.
+//
+// 'LSSHKeys' is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License along with 'LSSHKeys'.  If not, see <http://www.gnu.org/licenses/>.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Header Files
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "../include/LSSHKeys.hpp"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The 'LoginHistory' Class
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Public Methods
+
+void LoginHistory::ReadWtmp( const std::string& Path )
+{
+	// Create local variables.
+
+		time_t Now = time( nullptr );
+		struct utmp Record;
+		std::string Username;
+		std::ifstream File( Path, std::ios::binary );
+
+	// Score every user process login; a missing or unreadable file simply contributes nothing.
+
+		while( File.read( reinterpret_cast< char* >( &Record ), sizeof( Record ) ) )
+		{
+			if( Record.ut_type == USER_PROCESS )
+			{
+				Username.assign( Record.ut_user, strnlen( Record.ut_user, sizeof( Record.ut_user ) ) );
+				Seen[ Username ] = true;
+
+				Add( Username, Now, Record.ut_tv.tv_sec );
+			}
+		}
+}
+
+void LoginHistory::ReadLastlog( const std::string& Path )
+{
+	// Create local variables.
+
+		int Descriptor;
+		off_t Offset = 0;
+		off_t End;
+		time_t Now = time( nullptr );
+		struct lastlog Record;
+		struct passwd* Account;
+
+	// The lastlog file is a sparse array indexed by UID, so only walk the regions that hold data. It only adds users wtmp
+	// does not know about (wtmp may have been rotated); for everyone else it would count the latest login twice. A short read means
+	// the file ends in a partial record or changed while it was read, so the walk stops there.
+
+		if( ( Descriptor = open( Path.c_str(), ( O_RDONLY | O_CLOEXEC ) ) ) == -1 )
+			return;
+
+		while( ( Offset = lseek( Descriptor, Offset, SEEK_DATA ) ) != -1 )
+		{
+			if( ( End = lseek( Descriptor, Offset, SEEK_HOLE ) ) == -1 )
+				break;
+
+			for( Offset -= ( Offset % sizeof( Record ) ); Offset < End; Offset += sizeof( Record ) )
+			{
+				if( pread( Descriptor, &Record, sizeof( Record ), Offset ) != sizeof( Record ) )
+					break;
+
+				if( ( Record.ll_time != 0 ) && ( ( Account = getpwuid( Offset / sizeof( Record ) ) ) != nullptr ) &&
+				    ( Seen.find( Account->pw_name ) == Seen.end() ) )
+				{
+					Add( Account->pw_name, Now, Record.ll_time );
+				}
+			}
+
+			if( Offset < End )
+				break;
+
+			Offset = std::max( Offset, End );
+		}
+
+		close( Descriptor );
+}
+
+void LoginHistory::ReadList( std::istream& Stream )
+{
+	// Create local variables.
+
+		std::string Line;
+
+	// Every occurrence of a username in the list counts as one login.
+
+		while( std::getline( Stream, Line ) )
+			Add( Line, 0, 0 );
+}
+
+std::vector< std::string > LoginHistory::Rank( const size_t Count )
+{
+	// Create local variables.
+
+		std::vector< std::pair< double, std::string > > Ranking;
+		std::vector< std::string > ReturnValue;
+
+	// Sort users by descending score, then by name so the order is stable.
+
+		for( const std::pair< const std::string, double >& Score : Scores )
+			Ranking.push_back( std::make_pair( -Score.second, Score.first ) );
+
+		std::sort( Ranking.begin(), Ranking.end() );
+
+		for( size_t Index = 0; ( Index < Ranking.size() ) && ( Index < Count ); Index++ )
+			ReturnValue.push_back( Ranking[ Index ].second );
+
+	// Return ReturnValue.
+
+		return ReturnValue;
+}
+
+// Private Methods
+
+void LoginHistory::Add( const std::string& Username, const time_t Now, const time_t LoginTime )
+{
+	// Each login adds a weight that halves every week, so the score reflects both how often and how recently a user logs in.
+	// Names that are not valid usernames (e.g. 'LOGIN' or reboot pseudo-users) are ignored.
+
+		if( Utility::IsValidUsername( Username ) )
+			Scores[ Username ] += std::exp2( -( double ) std::max< time_t >( Now - LoginTime, 0 ) / ( 7 * 24 * 60 * 60 ) );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// End of 'LoginHistory.cpp'
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
\ No newline at end of file
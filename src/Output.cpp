@@ -0,0 +1,387 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Output.cpp
+// Matthew J. Schultz | Created : 31OCT17 | Last Modified : 31OCT17 by Matthew J. Schultz
+// Version : 0.0.1
+// This is the source file for the 'Output' class of 'LSSHKeys', which writes log messages to syslog, stdio or a file.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2017 QuantuMatriX Software, a QuantuMatriX Technologies Cooperative Partnership.
+//
+// This file is part of 'LSSHKeys'.
+//
+// 'LSSHKeys' is free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any later version.
+//
+// 'LSSHKeys' is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License along with 'LSSHKeys'.  If not, see <http://www.gnu.org/licenses/>.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Header Files
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "../include/LSSHKeys.hpp"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The 'Output' Class
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Destructor
+
+Output::~Output()
+{
+	// Perform necessary cleanup.
+
+		if( Active )
+		{
+			if( Facility == Method::Syslog )
+			{
+				closelog();
+			} 
+			else if( Facility == Method::File )
+			{
+				if( LogFile->is_open() )
+					LogFile->close();
+			}
+			Active = false;
+		}
+}
+
+// Public Methods
+
+void Output::Init( const Method LogMethod, const Level OutputLevel )
+{
+	// Set field values.
+
+		CurrentLevel = Level::Notice;
+		MinimumLevel = OutputLevel;
+
+	// Select Facility; error to syslog and cerr then exit if invalid.
+
+		switch( LogMethod )
+		{
+			case Method::Syslog:
+			{
+				Facility = Method::Syslog;
+				openlog( NAME, LOG_ODELAY, LOG_AUTH );
+				break;
+			}
+			case Method::Stdio:
+			{
+				Facility = Method::Stdio;
+				break;
+			}
+			default:
+			{
+				throw std::out_of_range( "Invalid log type." );
+			}
+		}
+
+	// Set the Active field value to true.
+
+		Active = true;
+}
+
+void Output::Init( std::ofstream& File, const Level OutputLevel )
+{
+	// Set field values.
+
+		CurrentLevel = Level::Notice;
+		MinimumLevel = OutputLevel;
+		Facility = Method::File;
+
+	// Ensure log filestream is open; error to syslog and cerr then exit if it is not.
+
+		if( !File.is_open() )
+		{
+			throw std::ios_base::failure( "Cannot open log file for writing" );
+		}
+
+	// Initialize the pointer to the filestream and set the active field value to true.
+
+		LogFile = &File;
+		Active = true;
+}
+
+void Output::Init( Output& Parent )
+{
+	// Log through the facility and at the level of 'Parent', from another thread. Each thread builds its messages in its own buffer,
+	// and the messages are written one at a time. The facility stays open until 'Parent' closes it.
+
+		CurrentLevel = Level::Notice;
+		MinimumLevel = Parent.MinimumLevel;
+		Facility = Parent.Facility;
+		LogFile = Parent.LogFile;
+		Active = false;
+}
+
+// Public Overloaded Operators
+
+Output& Output::operator<<( const Level LogLevel )
+{
+	// Set CurrentLevel to incoming LogLevel.
+
+		CurrentLevel = LogLevel;
+
+	// Return pointer to this object.
+
+		return *this;
+}
+
+Output& Output::operator<<( const std::string& s )
+{
+	// Append incoming string to Buffer.
+
+		if( !IsSuppressed() )
+			Buffer.append(s);
+
+	// Return pointer to this object.
+
+		return *this;
+}
+
+Output& Output::operator<<( const std::string_view s )
+{
+	// Append incoming string view to Buffer.
+
+		if( !IsSuppressed() )
+			Buffer.append(s);
+
+	// Return pointer to this object.
+
+		return *this;
+}
+
+Output& Output::operator<<( const std::pmr::string& s )
+{
+	// Append incoming arena string to Buffer.
+
+		return ( *this << std::string_view( s ) );
+}
+
+Output& Output::operator<<( const char* s )
+{
+	// Append incoming cstring to Buffer.
+
+		if( !IsSuppressed() )
+			Buffer.append(s);
+
+	// Return pointer to this object.
+
+		return *this;
+}
+
+Output& Output::operator<<( const char& c )
+{
+	// Push incoming char onto Buffer.
+
+		if( !IsSuppressed() )
+			Buffer.push_back(c);
+
+	// Return pointer to this object.
+
+		return *this;
+}
+
+Output& Output::operator<<( OStreamManipulator Object )
+{
+	// End a message that will not be logged without formatting it.
+
+		if( IsSuppressed() )
+		{
+			Buffer.clear();
+			CurrentLevel = Level::Notice;
+
+			return *this;
+		}
+
+	// Push newline character onto buffer.
+
+		Buffer.push_back( '\n' );
+
+	// Call sync().
+
+		sync();
+
+	// Set current level back to its default value.
+
+		CurrentLevel = Level::Notice;
+
+	// Return pointer to this object.
+
+		return *this;
+}
+
+// Private Methods
+
+bool Output::IsSuppressed()
+{
+	// Messages below the minimum level are dropped before they are built. Critical messages are never dropped, since logging them
+	// also exits.
+
+		return ( ( CurrentLevel > MinimumLevel ) && ( CurrentLevel > Level::Critical ) );
+}
+
+int Output::sync()
+{
+	// Create local variables
+
+		std::string LogLevelLabel;
+		time_t CurrentTime = std::chrono::system_clock::to_time_t( std::chrono::system_clock::now() );
+		tm CurrentTimeLocal;
+		static std::mutex WriteLock;
+
+		localtime_r( &CurrentTime, &CurrentTimeLocal );
+
+	// Perform output logic. Add level token to output for stdout and time + level token for filestream.
+	// On a critical level or above, exit. Also error and exit if level or facility are invalid.
+
+		if( ( !Buffer.empty() ) && ( !( Buffer == "\n" ) ) )
+		{
+			switch( CurrentLevel )
+			{
+				case Level::Emergency:
+				{
+					LogLevelLabel = "[ Emergency ] : ";
+					break;
+				}
+
+				case Level::Alert:
+				{
+					LogLevelLabel = "[ Alert ] : ";
+					break;
+				}
+
+				case Level::Critical:
+				{
+					LogLevelLabel = "[ Critical ] : ";
+					break;
+				}
+
+				case Level::Error:
+				{
+					LogLevelLabel = "[ Error ] : ";
+					break;
+				}
+
+				case Level::Warning:
+				{
+					LogLevelLabel = "[ Warning ] : ";
+					break;
+				}
+
+				case Level::Notice:
+				{
+					LogLevelLabel = "[ Notice ] : ";
+					break;
+				}
+
+				case Level::Information:
+				{
+					LogLevelLabel = "[ Information ] : ";
+					break;
+				}
+
+				case Level::Debug:
+				{
+					LogLevelLabel = "[ Debug ] : ";
+					break;
+				}
+
+				default:
+				{
+					throw std::out_of_range( "Internal error: Previously qualified log level value is invalid at line 607"
+					                         " of 'LSSHKeys.hpp'. Please file a bug report");
+				}
+				
+			}
+
+			if( CurrentLevel <= MinimumLevel )
+			{
+				std::lock_guard< std::mutex > Guard( WriteLock );
+
+				switch( Facility )
+				{
+					case Method::Syslog:
+					{
+						if ( CurrentLevel <= Level::Warning )
+							std::cerr << LogLevelLabel << Buffer;
+
+						syslog( CurrentLevel, "%s", Buffer.c_str() );
+
+						break;
+					}
+
+					case Method::Stdio:
+					{
+						std::cerr << LogLevelLabel << Buffer;
+
+						break;
+					}
+
+					case Method::File:
+					{
+						if ( CurrentLevel <= Level::Warning )
+							std::cerr << LogLevelLabel << Buffer;
+
+						*LogFile << "[ " 
+						         << std::put_time( &CurrentTimeLocal, "%Y-%m-%d %H:%M:%S %z" ) 
+						         << " ] " 
+						         << LogLevelLabel 
+						         << Buffer
+						         << std::flush;
+
+						break;
+					}
+
+					default:
+					{
+						throw std::out_of_range( "Internal error: Previously qualified log type value is invalid at "
+						                         "line 650 of 'LSSHKeys.hpp'. Please file a bug report.");
+					}
+				}
+			}
+
+			Buffer.clear();
+
+			if( CurrentLevel <= Level::Critical )
+				SafeExit( EXIT_FAILURE );
+		}
+		else
+		{
+			if ( Buffer == "\n" )
+				Buffer.clear();
+		}
+	
+	// Return on success.
+
+		return 0;
+}
+
+void Output::SafeExit( int ExitCode )
+{
+	// Perform necessary cleanup.
+
+		if( Active )
+		{
+			if( Facility == Method::Syslog )
+			{
+				closelog();
+			} 
+			else if( Facility == Method::File )
+			{
+				if( LogFile->is_open() )
+					LogFile->close();
+			}
+			Active = false;
+		}
+
+	// Call exit() with given exit code.
+
+		exit( ExitCode );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// End of 'Output.cpp'
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
\ No newline at end of file
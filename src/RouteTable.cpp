@@ -0,0 +1,207 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// RouteTable.cpp
+// Matthew J. Schultz | Created : 31OCT17 | Last Modified : 31OCT17 by Matthew J. Schultz
+// Version : 0.0.1
+// This is the source file for the 'RouteTable' class of 'LSSHKeys', which selects the directory to look up each user in.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2017 QuantuMatriX Software, a QuantuMatriX Technologies Cooperative Partnership.
+//
+// This file is part of 'LSSHKeys'.
+//
+// 'LSSHKeys' is free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any later version.
+//
+// 'LSSHKeys' is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License along with 'LSSHKeys'.  If not, see <http://www.gnu.org/licenses/>.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Header Files
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "../include/LSSHKeys.hpp"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The 'RouteTable' Class
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Constructor
+
+RouteTable::RouteTable( Config& Configuration, Output& Log ) : Log( Log )
+{
+	// Create local variables.
+
+		size_t Separator;
+		std::string Entry;
+		std::string ProfileName;
+		std::map< std::string, size_t > ProfileIndexes;
+
+	// The main configuration is the default profile, used for users no route matches.
+
+		ProfileNames.push_back( "default" );
+		Profiles.emplace_back( new KeyLookup( Configuration, Log ) );
+
+	// Compile the routes listed in the 'route_table' configuration parameter, separated by '|'. Each route is 'PATTERN=FILE', and the
+	// first route whose pattern matches the username selects the profile read from FILE: a configuration file whose values override
+	// those of the main configuration. Each profile is read and given its own KeyLookup, and so its own connection, once however many
+	// routes name it. Patterns without wildcards are found by hash, and patterns with only a leading or trailing '*' are compared as a
+	// suffix or prefix.
+
+		Log << DEBUG << "Checking if 'route_table' parameter exists... ";
+
+		if( !Configuration.Exists( "route_table" ) )
+		{
+			Log << "No." << std::endl;
+
+			return;
+		}
+
+		Log << "Yes." << std::endl;
+		Log << DEBUG << "The value of 'route_table' is: '" << Configuration.GetValue( "route_table" ) << "'" << std::endl;
+
+		std::istringstream RouteStream( Configuration.GetValue( "route_table" ) );
+
+		while( std::getline( RouteStream, Entry, '|' ) )
+		{
+			Route Current;
+
+			if( Entry.empty() )
+				continue;
+
+			Separator = Entry.find( '=' );
+
+			if( ( Separator == std::string::npos ) || ( Separator == 0 ) || ( ( Separator + 1 ) == Entry.length() ) )
+				throw std::invalid_argument( "Value of 'route_table' parameter invalid: '" + Entry + "'" );
+
+			Current.Pattern = Entry.substr( 0, Separator );
+			ProfileName = Entry.substr( Separator + 1 );
+
+			if( Current.Pattern.find_first_of( "*?" ) == std::string::npos )
+			{
+				Current.Type = Match::Exact;
+			}
+			else if( ( Current.Pattern.find_first_of( "*?" ) == ( Current.Pattern.length() - 1 ) ) && ( Current.Pattern.back() == '*' ) )
+			{
+				Current.Type = Match::Prefix;
+				Current.Pattern.pop_back();
+			}
+			else if( ( Current.Pattern.find_last_of( "*?" ) == 0 ) && ( Current.Pattern.front() == '*' ) )
+			{
+				Current.Type = Match::Suffix;
+				Current.Pattern.erase( 0, 1 );
+			}
+			else
+			{
+				Current.Type = Match::Glob;
+			}
+
+			if( ProfileIndexes.find( ProfileName ) == ProfileIndexes.end() )
+			{
+				Config Profile;
+				std::ifstream ProfileFile( ProfileName );
+
+				if( !ProfileFile.is_open() )
+					throw std::runtime_error( "Cannot open route profile: '" + ProfileName + "' : " + Utility::ErrnoToString() );
+
+				Log << DEBUG << "Reading route profile: '" << ProfileName << "'" << std::endl;
+
+				Profile.Init( ProfileFile );
+				Profile.Merge( Configuration );
+
+				ProfileIndexes[ ProfileName ] = Profiles.size();
+				ProfileNames.push_back( ProfileName );
+				Profiles.emplace_back( new KeyLookup( Profile, Log, ProfileName ) );
+			}
+
+			Current.Profile = ProfileIndexes[ ProfileName ];
+
+			if( Current.Type == Match::Exact )
+				ExactRoutes.emplace( Current.Pattern, Routes.size() );
+
+			Routes.push_back( Current );
+		}
+
+		Log << DEBUG << "Compiled " << Routes.size() << " routes to " << ( Profiles.size() - 1 ) << " profiles." << std::endl;
+}
+
+// Public Methods
+
+KeyLookup& RouteTable::Select( const std::string& Username )
+{
+	// Create local variables.
+
+		bool Matched = false;
+		size_t Index;
+		size_t Limit = Routes.size();
+		size_t Profile = 0;
+		std::unordered_map< std::string, size_t >::iterator Exact;
+
+	// Find the first exact route for the username by hash. Only the wildcard routes before it can take precedence, so only those are
+	// tried, in order.
+
+		if( ( Exact = ExactRoutes.find( Username ) ) != ExactRoutes.end() )
+			Limit = Exact->second;
+
+		for( Index = 0; ( Index < Limit ) && ( !Matched ); Index++ )
+		{
+			const Route& Current = Routes[ Index ];
+
+			switch( Current.Type )
+			{
+				case Match::Exact:
+				{
+					break;
+				}
+				case Match::Prefix:
+				{
+					Matched = ( Username.compare( 0, Current.Pattern.length(), Current.Pattern ) == 0 );
+					break;
+				}
+				case Match::Suffix:
+				{
+					Matched = ( ( Username.length() >= Current.Pattern.length() ) &&
+					            ( Username.compare( Username.length() - Current.Pattern.length(), Current.Pattern.length(),
+					                                Current.Pattern ) == 0 ) );
+					break;
+				}
+				default:
+				{
+					Matched = Utility::WildcardMatch( Current.Pattern, Username );
+					break;
+				}
+			}
+
+			if( Matched )
+				Profile = Current.Profile;
+		}
+
+		if( ( !Matched ) && ( Exact != ExactRoutes.end() ) )
+			Profile = Routes[ Limit ].Profile;
+
+		if( !Routes.empty() )
+			Log << DEBUG << "Routing user: " << Username << " to profile: '" << ProfileNames[ Profile ] << "'" << std::endl;
+
+	// Return the profile's KeyLookup.
+
+		return *Profiles[ Profile ];
+}
+
+KeyLookup& RouteTable::GetDefault()
+{
+	// Return the KeyLookup of the main configuration.
+
+		return *Profiles[ 0 ];
+}
+
+size_t RouteTable::Size()
+{
+	// Return the number of routes.
+
+		return Routes.size();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// End of 'RouteTable.cpp'
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
\ No newline at end of file
@@ -0,0 +1,244 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// SearchPipeline.cpp
+// Matthew J. Schultz | Created : 31OCT17 | Last Modified : 31OCT17 by Matthew J. Schultz
+// Version : 0.0.1
+// This is the source file for the 'SearchPipeline' class of 'LSSHKeys', which pipelines many user searches on one connection.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2017 QuantuMatriX Software, a QuantuMatriX Technologies Cooperative Partnership.
+//
+// This file is part of 'LSSHKeys'.
+//
+// 'LSSHKeys' is free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any later version.
+//
+// 'LSSHKeys' is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License along with 'LSSHKeys'.  If not, see <http://www.gnu.org/licenses/>.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Header Files
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "../include/LSSHKeys.hpp"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The 'SearchPipeline' Class
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Constructor
+
+SearchPipeline::SearchPipeline( LDAP* Interface,
+                                const std::string& Base,
+                                const int Scope,
+                                const std::string& FilterTemplate,
+                                const std::string& AttributeName,
+                                AccountPolicy& Account,
+                                ValueFilter& ValueRules,
+                                const size_t Depth )
+{
+	// Set field values.
+
+		this->Interface = Interface;
+		this->Base = Base;
+		this->Scope = Scope;
+		this->FilterTemplate = FilterTemplate;
+		this->AttributeName = AttributeName;
+		this->Account = &Account;
+		this->ValueRules = &ValueRules;
+		this->Depth = std::max< size_t >( Depth, 1 );
+		Allocations = 0;
+		HeapAllocations = 0;
+}
+
+// Public Methods
+
+void SearchPipeline::Run( Source NextUsername, Sink OnResult )
+{
+	// Create local variables.
+
+		bool Exhausted = false;
+		int ErrorCode;
+		int MessageID;
+		int ResultType;
+		std::string Username;
+		std::vector< char* > AttributeList( 1, const_cast< char* >( AttributeName.c_str() ) );
+		std::vector< std::unique_ptr< Slot > > Slots;
+		std::vector< Slot* > Idle;
+		std::map< int, Slot* > InFlight;
+		std::map< int, Slot* >::iterator Position;
+		LDAPMessage* Message = nullptr;
+		Slot* Current;
+
+	// Request the attributes the account checks read along with the keys.
+
+		for( std::string& Attribute : Account->GetAttributes() )
+			AttributeList.push_back( const_cast< char* >( Attribute.c_str() ) );
+
+		AttributeList.push_back( nullptr );
+
+	// Give every outstanding search a slot with its own arena. A result is built in its slot's arena and the arena is released
+	// once the result has been handed to 'OnResult', so steady-state lookups need no heap allocations.
+
+		for( size_t Index = 0; Index < Depth; Index++ )
+		{
+			Slots.emplace_back( new Slot );
+			Idle.push_back( Slots.back().get() );
+		}
+
+	// Keep up to 'Depth' searches outstanding on the one connection. Messages are read one at a time and matched to their user by
+	// message ID; each is decoded and freed at once, so memory does not grow with the number of users or entries.
+
+		while( true )
+		{
+			while( ( !Exhausted ) && ( !Idle.empty() ) )
+			{
+				if( !NextUsername( Username ) )
+				{
+					Exhausted = true;
+					break;
+				}
+
+				Current = Idle.back();
+				Idle.pop_back();
+				Current->Pending.emplace( &Current->Memory );
+				Current->Pending->Username.assign( Username );
+
+				ErrorCode = ldap_search_ext( Interface,
+				                             Base.c_str(),
+				                             Scope,
+				                             Utility::ExpandFilter( FilterTemplate, Username ).c_str(),
+				                             AttributeList.data(),
+				                             0,
+				                             ValueRules->GetControls(),
+				                             nullptr,
+				                             nullptr,
+				                             2,
+				                             &MessageID );
+
+				if( ErrorCode != LDAP_SUCCESS )
+				{
+					Current->Pending->ErrorCode = ErrorCode;
+					OnResult( *Current->Pending );
+					Recycle( Current, Idle );
+				}
+				else
+				{
+					InFlight[ MessageID ] = Current;
+				}
+			}
+
+			if( InFlight.empty() )
+				break;
+
+			if( ( ResultType = ldap_result( Interface, LDAP_RES_ANY, LDAP_MSG_ONE, nullptr, &Message ) ) <= 0 )
+			{
+				if( ResultType == 0 )
+					ErrorCode = LDAP_TIMEOUT;
+				else
+					ldap_get_option( Interface, LDAP_OPT_RESULT_CODE, &ErrorCode );
+
+				for( const std::pair< const int, Slot* >& Outstanding : InFlight )
+					ldap_abandon_ext( Interface, Outstanding.first, nullptr, nullptr );
+
+				throw std::runtime_error( std::string( "ldap_result(): " ) + ldap_err2string( ErrorCode ) );
+			}
+
+			if( ( Position = InFlight.find( ldap_msgid( Message ) ) ) != InFlight.end() )
+			{
+				if( Decode( Message, *Position->second->Pending ) )
+				{
+					OnResult( *Position->second->Pending );
+					Recycle( Position->second, Idle );
+					InFlight.erase( Position );
+				}
+			}
+
+			ldap_msgfree( Message );
+		}
+
+	// Record the arena counters.
+
+		for( const std::unique_ptr< Slot >& Item : Slots )
+		{
+			Allocations += Item->Memory.GetAllocations();
+			HeapAllocations += Item->Memory.GetHeapAllocations();
+		}
+}
+
+size_t SearchPipeline::GetAllocations()
+{
+	// Return the number of allocations made for results.
+
+		return Allocations;
+}
+
+size_t SearchPipeline::GetHeapAllocations()
+{
+	// Return the number of allocations for results that needed memory from the heap.
+
+		return HeapAllocations;
+}
+
+// Private Methods
+
+void SearchPipeline::Recycle( Slot* Current, std::vector< Slot* >& Idle )
+{
+	// Destroy the result before releasing the arena it lives in, then make the slot available again.
+
+		Current->Pending.reset();
+		Current->Memory.Release();
+		Idle.push_back( Current );
+}
+
+bool SearchPipeline::Decode( LDAPMessage* Message, Result& Current )
+{
+	// Create local variables.
+
+		struct berval DN;
+
+	// Collect the DN and the selected values of the first entry and count the entries, dropping the values when the account checks
+	// deny the entry. Return true once the final result code arrives.
+
+		if( ldap_msgtype( Message ) == LDAP_RES_SEARCH_ENTRY )
+		{
+			if( Current.EntryCount++ == 0 )
+			{
+				Utility::DecodeEntry( Interface, Message, DN, [ & ]( const struct berval& Name, BerVarray Values )
+				                      {
+				                          if( ( Values != nullptr ) && Utility::IsAttribute( Name, AttributeName ) )
+				                          {
+				                              for( ; Values->bv_val != nullptr; Values++ )
+				                              {
+				                                  std::string_view Value( Values->bv_val, Values->bv_len );
+
+				                                  if( ValueRules->Select( Value ) )
+				                                      Current.Values.emplace_back( Value.data(), Value.length() );
+				                              }
+				                          }
+				                          else
+				                          {
+				                              Current.Findings |= Account->Inspect( Name, Values );
+				                          }
+				                      } );
+
+				Current.DN.assign( DN.bv_val, DN.bv_len );
+
+				if( ( Current.Denied = Account->Deny( Current.Findings ) ) != nullptr )
+					Current.Values.clear();
+			}
+		}
+		else if( ldap_msgtype( Message ) == LDAP_RES_SEARCH_RESULT )
+		{
+			ldap_parse_result( Interface, Message, &Current.ErrorCode, nullptr, nullptr, nullptr, nullptr, 0 );
+
+			return true;
+		}
+
+		return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// End of 'SearchPipeline.cpp'
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
\ No newline at end of file
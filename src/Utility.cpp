@@ -0,0 +1,420 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Utility.cpp
+// Matthew J. Schultz | Created : 31OCT17 | Last Modified : 31OCT17 by Matthew J. Schultz
+// Version : 0.0.1
+// This is the source file for the 'Utility' namespace of 'LSSHKeys', which holds helpers shared by the library and the program.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2017 QuantuMatriX Software, a QuantuMatriX Technologies Cooperative Partnership.
+//
+// This file is part of 'LSSHKeys'.
+//
+// 'LSSHKeys' is free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any later version.
+//
+// 'LSSHKeys' is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License along with 'LSSHKeys'.  If not, see <http://www.gnu.org/licenses/>.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Header Files
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "../include/LSSHKeys.hpp"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The 'Utility' Namespace
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::string Utility::ErrnoToString()
+{
+	// Return ReturnValue.
+
+		return std::string( strerror( errno ) );
+}
+
+std::string Utility::ErrnoToString( int ErrorNumber )
+{
+	// return ReturnValue.
+
+		return std::string( strerror( ErrorNumber ) );
+}
+
+bool Utility::IsValidUsername( const std::string_view Username )
+{
+	// Create local variables.
+
+		static const std::regex Pattern( "^[a-z][-a-z0-9]*" );
+
+	// Return true if 'Username' is safe to substitute into a filter and to use as a cache record name.
+
+		return std::regex_match( Username.begin(), Username.end(), Pattern );
+}
+
+std::string Utility::ExpandFilter( const std::string& Template, const std::string& Username )
+{
+	// Create local variables.
+
+		size_t FindPosition = 0;
+		std::string ReturnValue = Template;
+
+	// Replace every occurrence of '%1' with the username.
+
+		while( ( FindPosition = ReturnValue.find( "%1", FindPosition ) ) != std::string::npos )
+		{
+			ReturnValue.replace( FindPosition, 2, Username );
+			FindPosition += Username.length();
+		}
+
+	// Return ReturnValue.
+
+		return ReturnValue;
+}
+
+std::string Utility::JSONEscape( const std::string_view Value )
+{
+	// Create local variables.
+
+		char Buffer[ 8 ];
+		std::string ReturnValue = "\"";
+
+	// Quote 'Value' as a JSON string, escaping quotes, backslashes and control characters.
+
+		for( const char Symbol : Value )
+		{
+			if( ( Symbol == '"' ) || ( Symbol == '\\' ) )
+			{
+				ReturnValue.push_back( '\\' );
+				ReturnValue.push_back( Symbol );
+			}
+			else if( ( unsigned char ) Symbol < 0x20 )
+			{
+				snprintf( Buffer, sizeof( Buffer ), "\\u%04x", ( unsigned char ) Symbol );
+				ReturnValue += Buffer;
+			}
+			else
+			{
+				ReturnValue.push_back( Symbol );
+			}
+		}
+
+		ReturnValue.push_back( '"' );
+
+	// Return ReturnValue.
+
+		return ReturnValue;
+}
+
+std::string Utility::EscapeFilterValue( const std::string_view Value )
+{
+	// Create local variables.
+
+		char Buffer[ 4 ];
+		std::string ReturnValue;
+
+	// Escape the characters that are special in a filter assertion value as '\XX' (RFC 4515).
+
+		for( const char Symbol : Value )
+		{
+			if( ( Symbol == '*' ) || ( Symbol == '(' ) || ( Symbol == ')' ) || ( Symbol == '\\' ) || ( Symbol == '\0' ) )
+			{
+				snprintf( Buffer, sizeof( Buffer ), "\\%02x", ( unsigned char ) Symbol );
+				ReturnValue += Buffer;
+			}
+			else
+			{
+				ReturnValue.push_back( Symbol );
+			}
+		}
+
+	// Return ReturnValue.
+
+		return ReturnValue;
+}
+
+uint64_t Utility::Hash( const std::string& Value )
+{
+	// Create local variables.
+
+		uint64_t ReturnValue = 14695981039346656037ull;
+
+	// Hash 'Value' with 64-bit FNV-1a, which is stable across builds and platforms.
+
+		for( const char Symbol : Value )
+			ReturnValue = ( ReturnValue ^ ( uint8_t ) Symbol ) * 1099511628211ull;
+
+	// Return ReturnValue.
+
+		return ReturnValue;
+}
+
+void Utility::WriteFileAtomically( const std::string& Directory, const std::string& Name, const std::string& Contents, const mode_t Mode )
+{
+	// Create local variables.
+
+		int Descriptor;
+		ssize_t Written;
+		std::string TemporaryName = Directory + "/." + Name + ".XXXXXX";
+		std::vector< char > TemporaryNameBuffer( TemporaryName.begin(), TemporaryName.end() );
+
+	// Write the contents to a temporary file in the same directory, then rename it over the old file so concurrent readers never
+	// see a partial file.
+
+		TemporaryNameBuffer.push_back( '\0' );
+
+		if( ( Descriptor = mkstemp( TemporaryNameBuffer.data() ) ) == -1 )
+		{
+			throw std::ios_base::failure( "Cannot create file" );
+		}
+
+		Written = write( Descriptor, Contents.data(), Contents.size() );
+
+		if( ( Written != ( ssize_t ) Contents.size() ) || ( fchmod( Descriptor, Mode ) != 0 ) )
+		{
+			close( Descriptor );
+			unlink( TemporaryNameBuffer.data() );
+
+			throw std::ios_base::failure( "Cannot write file" );
+		}
+
+		close( Descriptor );
+
+		if( rename( TemporaryNameBuffer.data(), ( Directory + "/" + Name ).c_str() ) != 0 )
+		{
+			unlink( TemporaryNameBuffer.data() );
+
+			throw std::ios_base::failure( "Cannot rename file" );
+		}
+}
+
+bool Utility::WriteAll( const int Descriptor, const std::string_view Contents )
+{
+	// Create local variables.
+
+		size_t Offset = 0;
+		ssize_t Written;
+
+	// Write the contents with as few calls as the descriptor accepts, normally one, continuing after partial writes and signals.
+
+		while( Offset < Contents.size() )
+		{
+			if( ( Written = write( Descriptor, Contents.data() + Offset, Contents.size() - Offset ) ) == -1 )
+			{
+				if( errno == EINTR )
+					continue;
+
+				return false;
+			}
+
+			Offset += Written;
+		}
+
+	// Return true.
+
+		return true;
+}
+
+bool Utility::IsAttribute( const struct berval& Name, const std::string& AttributeName )
+{
+	// Compare an attribute name read in place from a response with 'AttributeName', ignoring case, without allocating.
+
+		return ( ( Name.bv_len == AttributeName.length() ) && ( strncasecmp( Name.bv_val, AttributeName.c_str(), Name.bv_len ) == 0 ) );
+}
+
+bool Utility::WildcardMatch( const std::string_view Pattern, const std::string_view Text )
+{
+	// Create local variables.
+
+		size_t PatternIndex = 0;
+		size_t TextIndex = 0;
+		size_t StarIndex = std::string_view::npos;
+		size_t StarText = 0;
+
+	// Match 'Text' against 'Pattern', where '*' matches any run of characters and '?' any one character. On a mismatch the last '*'
+	// is extended by one character and matching resumes after it, so no recursion or allocation is needed.
+
+		while( TextIndex < Text.length() )
+		{
+			if( ( PatternIndex < Pattern.length() ) && ( ( Pattern[ PatternIndex ] == '?' ) || ( Pattern[ PatternIndex ] == Text[ TextIndex ] ) ) )
+			{
+				PatternIndex++;
+				TextIndex++;
+			}
+			else if( ( PatternIndex < Pattern.length() ) && ( Pattern[ PatternIndex ] == '*' ) )
+			{
+				StarIndex = PatternIndex++;
+				StarText = TextIndex;
+			}
+			else if( StarIndex != std::string_view::npos )
+			{
+				PatternIndex = StarIndex + 1;
+				TextIndex = ++StarText;
+			}
+			else
+			{
+				return false;
+			}
+		}
+
+		while( ( PatternIndex < Pattern.length() ) && ( Pattern[ PatternIndex ] == '*' ) )
+			PatternIndex++;
+
+	// Return true if the whole pattern was used.
+
+		return ( PatternIndex == Pattern.length() );
+}
+
+LDAP* Utility::CloneConnection( LDAP* Template, const std::string& URI, const bool StartTLS, const std::string& Mechanism,
+                                const std::string& BindDN, const std::string& BindPassword )
+{
+	// Create local variables.
+
+		int ErrorCode;
+		int IntegerValue;
+		char* StringValue;
+		struct timeval* TimeValue;
+		struct berval Credentials;
+		LDAP* ReturnValue = nullptr;
+
+		static const int IntegerOptions[] = { LDAP_OPT_PROTOCOL_VERSION, LDAP_OPT_TIMELIMIT, LDAP_OPT_X_KEEPALIVE_IDLE,
+		                                      LDAP_OPT_X_KEEPALIVE_PROBES, LDAP_OPT_X_KEEPALIVE_INTERVAL, LDAP_OPT_X_TLS_REQUIRE_CERT,
+		                                      LDAP_OPT_X_TLS_CRLCHECK };
+		static const int StringOptions[] = { LDAP_OPT_X_TLS_CACERTDIR, LDAP_OPT_X_TLS_CACERTFILE, LDAP_OPT_X_TLS_CERTFILE,
+		                                     LDAP_OPT_X_TLS_KEYFILE, LDAP_OPT_X_TLS_CIPHER_SUITE, LDAP_OPT_X_TLS_DHFILE,
+		                                     LDAP_OPT_X_TLS_RANDOM_FILE };
+		static const int TimeOptions[] = { LDAP_OPT_TIMEOUT, LDAP_OPT_NETWORK_TIMEOUT };
+
+	// Open another connection to 'URI' with the options already applied to 'Template', then repeat StartTLS and the bind.
+
+		if( ( ErrorCode = ldap_initialize( &ReturnValue, URI.c_str() ) ) != LDAP_SUCCESS )
+		{
+			throw std::runtime_error( std::string( "ldap_initialize(): " ) + ldap_err2string( ErrorCode ) );
+		}
+
+		for( const int Option : IntegerOptions )
+		{
+			if( ldap_get_option( Template, Option, &IntegerValue ) == LDAP_OPT_SUCCESS )
+				ldap_set_option( ReturnValue, Option, &IntegerValue );
+		}
+
+		for( const int Option : StringOptions )
+		{
+			if( ( ldap_get_option( Template, Option, &StringValue ) == LDAP_OPT_SUCCESS ) && ( StringValue != nullptr ) )
+			{
+				ldap_set_option( ReturnValue, Option, StringValue );
+				ldap_memfree( StringValue );
+			}
+		}
+
+		for( const int Option : TimeOptions )
+		{
+			if( ( ldap_get_option( Template, Option, &TimeValue ) == LDAP_OPT_SUCCESS ) && ( TimeValue != nullptr ) )
+			{
+				ldap_set_option( ReturnValue, Option, TimeValue );
+				ldap_memfree( TimeValue );
+			}
+		}
+
+		IntegerValue = 0;
+		ldap_set_option( ReturnValue, LDAP_OPT_X_TLS_NEWCTX, &IntegerValue );
+
+		if( StartTLS && ( ( ErrorCode = ldap_start_tls_s( ReturnValue, nullptr, nullptr ) ) != LDAP_SUCCESS ) )
+		{
+			ldap_unbind_ext_s( ReturnValue, nullptr, nullptr );
+
+			throw std::runtime_error( std::string( "ldap_start_tls_s(): " ) + ldap_err2string( ErrorCode ) );
+		}
+
+		Credentials.bv_val = const_cast< char* >( BindPassword.c_str() );
+		Credentials.bv_len = BindPassword.length();
+
+		if( ( ErrorCode = ldap_sasl_bind_s( ReturnValue, ( BindDN.empty() ? nullptr : BindDN.c_str() ),
+		                                    ( Mechanism.empty() ? LDAP_SASL_SIMPLE : Mechanism.c_str() ), &Credentials, nullptr, nullptr,
+		                                    nullptr ) ) != LDAP_SUCCESS )
+		{
+			ldap_unbind_ext_s( ReturnValue, nullptr, nullptr );
+
+			throw std::runtime_error( std::string( "ldap_sasl_bind_s(): " ) + ldap_err2string( ErrorCode ) );
+		}
+
+	// Return ReturnValue.
+
+		return ReturnValue;
+}
+
+void Utility::PreLogCritical( std::string Message )
+{
+	// Open syslog, log critical message, then close syslog.
+
+		openlog( NAME, LOG_ODELAY, LOG_AUTH );
+		syslog( LOG_CRIT, "%s. Aborting.", Message.c_str());
+		closelog();
+
+	// Log critical message to stderr.
+
+		std::cerr << "[ Critical ] : " << Message << ". Aborting." << std::endl;
+
+	// Call exit() with failure status.
+
+		exit( EXIT_FAILURE );
+}
+
+void Utility::LDAPClose( LDAP*& Object )
+{
+	// Unbind LDAP interface and free memory.
+
+		ldap_unbind_ext_s( Object, nullptr, nullptr );
+
+	// Set pointer to null.
+
+		Object = nullptr;
+}
+
+void Utility::LDAPMemFree( char*& Object )
+{
+	// Free memory allocated by LDAP.
+
+		ldap_memfree( Object );
+
+	// Set pointer to null.
+
+		Object = nullptr;
+}
+
+void Utility::LDAPMsgFree( LDAPMessage*& Object )
+{
+	// Free LDAP message.
+
+		ldap_msgfree( Object );
+
+	// Set pointer to null.
+
+		Object = nullptr;
+}
+
+void Utility::LDAPValueFreeLen( BerValue**& Object )
+{
+	// Free memory allocated by LDAP.
+
+		ldap_value_free_len( Object );
+
+	// Set pointer to null.
+
+		Object = nullptr;
+}
+
+void Utility::BerFree( BerElement*& Object )
+{
+	// Free BerElement memory.
+
+		ber_free( Object, 0 );
+
+	// Set pointer to null.
+
+		Object = nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// End of 'Utility.cpp'
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
\ No newline at end of file
@@ -0,0 +1,226 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// ValueFilter.cpp
+// Matthew J. Schultz | Created : 31OCT17 | Last Modified : 31OCT17 by Matthew J. Schultz
+// Version : 0.0.1
+// This is the source file for the 'ValueFilter' class of 'LSSHKeys', which limits the keys returned to the values policy allows.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2017 QuantuMatriX Software, a QuantuMatriX Technologies Cooperative Partnership.
+//
+// This file is part of 'LSSHKeys'.
+//
+// 'LSSHKeys' is free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any later version.
+//
+// 'LSSHKeys' is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License along with 'LSSHKeys'.  If not, see <http://www.gnu.org/licenses/>.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Header Files
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "../include/LSSHKeys.hpp"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The 'ValueFilter' Class
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Constructor
+
+ValueFilter::ValueFilter()
+{
+	// Set field values.
+
+		Control = nullptr;
+		Controls[ 0 ] = nullptr;
+		Controls[ 1 ] = nullptr;
+}
+
+// Destructor
+
+ValueFilter::~ValueFilter()
+{
+	// Free the control.
+
+		if( Control != nullptr )
+			ldap_control_free( Control );
+}
+
+// Public Methods
+
+void ValueFilter::Init( Config& Configuration, const std::string& AttributeName, const std::vector< std::string >& Scopes, Output& Log )
+{
+	// Create local variables.
+
+		bool UseControl = true;
+		std::string Pattern;
+		std::string Filter;
+		std::string StringValue;
+		struct berval Value = { 0, nullptr };
+		BerElement* Element;
+
+	// Set field values. With scopes, every value must start with one of them followed by ':', which is removed from the key.
+
+		this->Scopes = Scopes;
+
+	// Read the patterns of the allowed values of the key attribute from the 'value_filter' configuration parameter, separated by '|',
+	// where '*' matches any run of characters.
+
+		Log << DEBUG << "Checking if 'value_filter' parameter exists... ";
+
+		if( Configuration.Exists( "value_filter" ) )
+		{
+			Log << "Yes." << std::endl;
+			Log << DEBUG << "The value of 'value_filter' is: '" << Configuration.GetValue( "value_filter" ) << "'" << std::endl;
+
+			std::istringstream PatternStream( Configuration.GetValue( "value_filter" ) );
+
+			while( std::getline( PatternStream, Pattern, '|' ) )
+			{
+				if( Pattern.empty() )
+					continue;
+
+				if( Pattern.find( '?' ) != std::string::npos )
+					throw std::invalid_argument( "Value of 'value_filter' parameter invalid: '" + Pattern + "'" );
+
+				Patterns.push_back( Pattern );
+			}
+		}
+		else
+		{
+			Log << "No." << std::endl;
+		}
+
+		if( Patterns.empty() && Scopes.empty() )
+			return;
+
+	// Send the scopes and patterns as a matched values control (RFC 3876) unless the 'value_filter_control' configuration parameter
+	// is set to 'off', so the server returns only the allowed values. The control is not critical, and every value is checked against the
+	// patterns again as it is decoded, so a server without the control returns the same keys.
+
+		Log << DEBUG << "Checking if 'value_filter_control' parameter exists... ";
+
+		if( Configuration.Exists( "value_filter_control" ) )
+		{
+			Log << "Yes." << std::endl;
+			Log << DEBUG << "The value of 'value_filter_control' is: '" << Configuration.GetValue( "value_filter_control" ) << "'"
+			             << std::endl;
+
+			StringValue = Configuration.GetValue( "value_filter_control" );
+			transform( StringValue.begin(), StringValue.end(), StringValue.begin(), ::tolower );
+
+			UseControl = !( ( StringValue == "off" ) || ( StringValue == "no" ) || ( StringValue == "false" ) || ( StringValue == "disabled" ) );
+		}
+		else
+		{
+			Log << "No." << std::endl;
+			Log << DEBUG << "Defaulting to 'value_filter_control' = 'on'." << std::endl;
+		}
+
+		if( !UseControl )
+			return;
+
+		for( const std::string& Scope : ( Scopes.empty() ? std::vector< std::string >( 1, "" ) : Scopes ) )
+		{
+			for( const std::string& Current : ( Patterns.empty() ? std::vector< std::string >( 1, "*" ) : Patterns ) )
+			{
+				Filter += "(" + AttributeName + "=" + ( Scope.empty() ? "" : ( Utility::EscapeFilterValue( Scope ) + ":" ) ) +
+				          std::regex_replace( Utility::EscapeFilterValue( Current ), std::regex( "\\\\2a" ), "*" ) + ")";
+			}
+		}
+
+		Filter = "(" + Filter + ")";
+
+		Log << DEBUG << "The matched values filter is: '" << Filter << "'" << std::endl;
+
+		if( ( Element = ber_alloc_t( LBER_USE_DER ) ) == nullptr )
+			throw std::runtime_error( "Cannot create matched values control : " + Utility::ErrnoToString( ENOMEM ) );
+
+		if( ( ldap_put_vrFilter( Element, Filter.c_str() ) == -1 ) || ( ber_flatten2( Element, &Value, 0 ) == -1 ) ||
+		    ( ldap_control_create( LDAP_CONTROL_VALUESRETURNFILTER, 0, &Value, 1, &Control ) != LDAP_SUCCESS ) )
+		{
+			ber_free( Element, 1 );
+			Control = nullptr;
+
+			throw std::invalid_argument( "Value of 'value_filter' parameter invalid. Cannot create matched values control" );
+		}
+
+		ber_free( Element, 1 );
+
+		Controls[ 0 ] = Control;
+}
+
+LDAPControl** ValueFilter::GetControls()
+{
+	// Return the server controls to send with searches for keys, or nullptr if there are none.
+
+		return ( ( Control != nullptr ) ? Controls : nullptr );
+}
+
+bool ValueFilter::Allows( const std::string_view Value )
+{
+	// Return true if the value matches one of the patterns, or if there are none.
+
+		if( Patterns.empty() )
+			return true;
+
+		for( const std::string& Pattern : Patterns )
+		{
+			if( Utility::WildcardMatch( Pattern, Value ) )
+				return true;
+		}
+
+		return false;
+}
+
+bool ValueFilter::Select( std::string_view& Value )
+{
+	// Create local variables.
+
+		size_t Separator;
+
+	// Reject a value that cannot be a single authorized_keys line: one with a line break would add lines of its own, and one with a
+	// NUL would be cut short.
+
+		if( Value.find_first_of( std::string_view( "\r\n\0", 3 ) ) != std::string_view::npos )
+			return false;
+
+	// With scopes, reject a value whose scope, the text before the first ':', is not one of them, and remove the scope from the key.
+	// Then return true if the key matches one of the patterns.
+
+		if( !Scopes.empty() )
+		{
+			if( ( Separator = Value.find( ':' ) ) == std::string_view::npos )
+				return false;
+
+			if( std::find( Scopes.begin(), Scopes.end(), Value.substr( 0, Separator ) ) == Scopes.end() )
+				return false;
+
+			Value.remove_prefix( Separator + 1 );
+		}
+
+		return Allows( Value );
+}
+
+uint64_t ValueFilter::GetFingerprint()
+{
+	// Create local variables.
+
+		std::string Rules;
+
+	// Return a hash of the scopes and patterns, so keys selected under other rules can be told apart.
+
+		for( const std::string& Scope : Scopes )
+			Rules += "scope " + Scope + '\n';
+
+		for( const std::string& Pattern : Patterns )
+			Rules += "pattern " + Pattern + '\n';
+
+		return Utility::Hash( Rules );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// End of 'ValueFilter.cpp'
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
\ No newline at end of file